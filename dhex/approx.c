@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "approx.h"
+
+// every position where the pattern matches with at most k bytes different.
+// 16 positions are tried at once, each byte of the pattern is compared with
+// 16 bytes of the file and the mismatches are counted per lane. once all 16
+// lanes are over k the rest of the pattern is skipped.
+
+#define APPROX_CHUNK 1048576
+#define APPROX_MAXPAT 255
+
+unsigned int approx_distance(const unsigned char *a,const unsigned char *b,unsigned int len)
+{
+	unsigned int i;
+	unsigned int d=0;
+	for (i=0;i<len;i++) d+=(a[i]!=b[i]);
+	return d;
+}
+
+// positions [0,npos) of buf, returns nonzero when hitfn wants to stop
+static int approx_block(const unsigned char *buf,unsigned int npos,const unsigned char *pat,unsigned int len,unsigned int k,file_position_t base,approx_hitfn hitfn)
+{
+	unsigned int i=0;
+	unsigned int j;
+	unsigned int d;
+#ifdef __SSE2__
+	__m128i pv[APPROX_MAXPAT];
+	__m128i one=_mm_set1_epi8(1);
+	__m128i kv=_mm_set1_epi8((char)k);
+	__m128i mism;
+	__m128i eq;
+	unsigned char lane[16];
+	int ok;
+	for (j=0;j<len;j++) pv[j]=_mm_set1_epi8(pat[j]);
+	for (i=0;i+16<=npos;i+=16)
+	{
+		mism=_mm_setzero_si128();
+		ok=0xffff;
+		for (j=0;j<len && ok;j++)
+		{
+			eq=_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf+i+j)),pv[j]);
+			mism=_mm_adds_epu8(mism,_mm_andnot_si128(eq,one));
+			ok=_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(mism,kv),mism));
+		}
+		if (ok)
+		{
+			_mm_storeu_si128((__m128i *)lane,mism);
+			for (j=0;j<16;j++) if (((ok>>j)&1) && hitfn(base+i+j,lane[j])) return 1;
+		}
+	}
+#endif
+	for (;i<npos;i++)
+	{
+		d=0;
+		for (j=0;j<len && d<=k;j++) d+=(buf[i+j]!=pat[j]);
+		if (d<=k && hitfn(base+i,d)) return 1;
+	}
+	return 0;
+}
+
+// calls hitfn for every match in [pos,end) in order, returns 1 if it stopped
+int approx_search(approx_readfn readfn,const unsigned char *pat,unsigned int len,unsigned int k,file_position_t pos,file_position_t end,approx_hitfn hitfn)
+{
+	unsigned char *buf;
+	unsigned int n;
+	unsigned int npos;
+	int r=0;
+	if (len==0 || len>APPROX_MAXPAT || k>=len) return 0;
+	buf=malloc(APPROX_CHUNK+len);
+	while (r==0 && pos+len<=end)
+	{
+		n=readfn(pos,buf,(end-pos<APPROX_CHUNK+len-1)?end-pos:APPROX_CHUNK+len-1);
+		if (n<len) break;
+		npos=n-len+1;
+		if (npos>APPROX_CHUNK) npos=APPROX_CHUNK;
+		r=approx_block(buf,npos,pat,len,k,pos,hitfn);
+		pos+=npos;
+	}
+	free(buf);
+	return r;
+}
@@ -0,0 +1,11 @@
+#ifndef APPROX_H
+#define APPROX_H
+#include "data.h"
+
+typedef unsigned int (*approx_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+typedef int (*approx_hitfn)(file_position_t pos,unsigned int dist);	// nonzero stops
+
+unsigned int approx_distance(const unsigned char *a,const unsigned char *b,unsigned int len);
+int approx_search(approx_readfn readfn,const unsigned char *pat,unsigned int len,unsigned int k,file_position_t pos,file_position_t end,approx_hitfn hitfn);
+
+#endif
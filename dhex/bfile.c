@@ -0,0 +1,514 @@
+#define _GNU_SOURCE		// SEEK_DATA, SEEK_HOLE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>		// process_vm_readv
+#include "bfile.h"
+#include "zfile.h"
+#include "scanio.h"
+#include "stats.h"
+
+// all reads of the input files go through here. small reads (the screen,
+// single bytes) are served from a cache of BFILE_BLOCKSIZE blocks, bulk
+// reads (searching, diffing) bypass it so they don't flush the screen out.
+// a running process looks like a sparse file: its mappings are the data
+// extents, everything between them is a hole.
+
+#define BFILE_MAXIOV 1024		// pages per process_vm_readv()
+#define BFILE_MAXADDR ((file_position_t)1<<48)	// [vsyscall] and friends
+
+struct bfile *bfile_open(const char *filename)
+{
+	struct bfile *bf;
+	unsigned char magic[4];
+	ssize_t n;
+	off_t end;
+	bf=calloc(1,sizeof(struct bfile));
+	bf->fd=open(filename,O_RDONLY);
+	if (bf->fd<0)
+	{
+		free(bf);
+		return NULL;
+	}
+	bf->filename=malloc(strlen(filename)+1);
+	strncpy(bf->filename,filename,strlen(filename)+1);
+	bf->extents=-1;
+	n=pread(bf->fd,magic,sizeof(magic),0);
+	bf->type=zfile_detect(magic,n);
+	if (bf->type!=BFILE_PLAIN)
+	{
+		bf->zf=zfile_open(bf->fd,filename,bf->type,&bf->size);
+		if (bf->zf==NULL) bf->type=BFILE_PLAIN;	// not what it looked like, show it raw
+	}
+	if (bf->type==BFILE_PLAIN)
+	{
+		end=lseek(bf->fd,0,SEEK_END);	// st_size is 0 for block devices
+		bf->size=(end>0)?end:0;
+	}
+	return bf;
+}
+
+static void bfile_freemaps(struct bfile *bf)
+{
+	int i;
+	if (bf->extname!=NULL) for (i=0;i<bf->extents;i++) free(bf->extname[i]);
+	free(bf->extname);
+	free(bf->extent);
+	bf->extname=NULL;
+	bf->extent=NULL;
+	bf->extents=0;
+}
+
+// the readable mappings of the process, in address order
+static int bfile_readmaps(struct bfile *bf)
+{
+	FILE *f;
+	char line[4096];
+	char perms[8];
+	unsigned long long start;
+	unsigned long long end;
+	unsigned int max=0;
+	int n;
+	sprintf(line,"/proc/%d/maps",bf->pid);
+	f=fopen(line,"rb");
+	if (f==NULL) return 0;
+	bfile_freemaps(bf);
+	while (fgets(line,sizeof(line),f)!=NULL)
+	{
+		n=0;
+		if (sscanf(line,"%llx-%llx %7s %*s %*s %*s %n",&start,&end,perms,&n)<3) continue;
+		if (perms[0]!='r' || end>BFILE_MAXADDR || start>=end) continue;
+		if (bf->size && end>bf->size) continue;	// mapped after we opened it
+		if (strchr(line,'\n')) *strchr(line,'\n')=0;
+		if (bf->extents==max)
+		{
+			max=max?max*2:64;
+			bf->extent=realloc(bf->extent,2*max*sizeof(file_position_t));
+			bf->extname=realloc(bf->extname,max*sizeof(char*));
+		}
+		bf->extent[2*bf->extents]=start;
+		bf->extent[2*bf->extents+1]=end;
+		bf->extname[bf->extents]=malloc(strlen(perms)+strlen(line+n)+2);
+		sprintf(bf->extname[bf->extents],"%s %s",perms,n?line+n:"");
+		bf->extents++;
+	}
+	fclose(f);
+	return 1;
+}
+
+struct bfile *bfile_openpid(int pid)
+{
+	struct bfile *bf;
+	bf=calloc(1,sizeof(struct bfile));
+	bf->type=BFILE_PROCESS;
+	bf->fd=-1;
+	bf->pid=pid;
+	if (!bfile_readmaps(bf) || bf->extents==0)
+	{
+		bfile_freemaps(bf);
+		free(bf);
+		return NULL;
+	}
+	bf->size=bf->extent[2*bf->extents-1];
+	bf->filename=malloc(32);
+	sprintf(bf->filename,"pid %d",pid);
+	return bf;
+}
+
+struct bfile *bfile_dup(struct bfile *bf)
+{
+	struct bfile *dup;
+	if (bf->type==BFILE_PROCESS)
+	{
+		dup=calloc(1,sizeof(struct bfile));
+		dup->type=BFILE_PROCESS;
+		dup->fd=-1;
+		dup->pid=bf->pid;
+		dup->size=bf->size;
+		if (!bfile_readmaps(dup))
+		{
+			free(dup);
+			return NULL;
+		}
+		dup->filename=malloc(strlen(bf->filename)+1);
+		strncpy(dup->filename,bf->filename,strlen(bf->filename)+1);
+		return dup;
+	}
+	dup=calloc(1,sizeof(struct bfile));
+	dup->fd=open(bf->filename,O_RDONLY);
+	if (dup->fd<0)
+	{
+		free(dup);
+		return NULL;
+	}
+	dup->filename=malloc(strlen(bf->filename)+1);
+	strncpy(dup->filename,bf->filename,strlen(bf->filename)+1);
+	dup->type=bf->type;
+	dup->size=bf->size;
+	dup->extents=-1;
+	if (bf->zf) dup->zf=zfile_dup(bf->zf,dup->fd);
+	return dup;
+}
+
+void bfile_close(struct bfile *bf)
+{
+	unsigned int i;
+	if (bf==NULL) return;
+	if (bf->zf) zfile_close(bf->zf);
+	scanio_close(bf->scan);
+	for (i=0;i<BFILE_CACHEBLOCKS;i++) free(bf->cache[i].data);
+	bfile_freemaps(bf);
+	if (bf->fd>=0) close(bf->fd);
+	free(bf->filename);
+	free(bf);
+}
+
+file_position_t bfile_size(struct bfile *bf)
+{
+	return bf->size;
+}
+
+// one page per iovec: the kernel stops at the first page it cannot read,
+// that one stays zero and the rest is tried again.
+static void bfile_procvec(struct bfile *bf,struct iovec *local,struct iovec *remote,unsigned int n)
+{
+	unsigned int i=0;
+	ssize_t got;
+	while (i<n)
+	{
+		got=process_vm_readv(bf->pid,local+i,n-i,remote+i,n-i,0);
+		STATS_ADD(syscalls,1);
+		if (got<0) got=0;
+		while (i<n && (size_t)got>=remote[i].iov_len)
+		{
+			got-=remote[i].iov_len;
+			i++;
+		}
+		i++;
+	}
+}
+
+static unsigned int bfile_procread(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	struct iovec local[BFILE_MAXIOV];
+	struct iovec remote[BFILE_MAXIOV];
+	file_position_t page;
+	file_position_t s;
+	file_position_t e;
+	unsigned int n=0;
+	int lo=0;
+	int hi;
+	int mid;
+	page=sysconf(_SC_PAGESIZE);
+	memset(buf,0,len);
+	hi=bf->extents;
+	while (lo<hi)
+	{
+		mid=(lo+hi)/2;
+		if (bf->extent[2*mid+1]<=pos) lo=mid+1; else hi=mid;
+	}
+	for (;lo<bf->extents && bf->extent[2*lo]<pos+len;lo++)
+	{
+		s=(bf->extent[2*lo]>pos)?bf->extent[2*lo]:pos;
+		e=(bf->extent[2*lo+1]<pos+len)?bf->extent[2*lo+1]:pos+len;
+		while (s<e)
+		{
+			local[n].iov_base=buf+(s-pos);
+			remote[n].iov_base=(void*)(uintptr_t)s;
+			local[n].iov_len=remote[n].iov_len=((s|(page-1))+1<e)?(s|(page-1))+1-s:e-s;
+			s+=local[n].iov_len;
+			if (++n==BFILE_MAXIOV)
+			{
+				bfile_procvec(bf,local,remote,n);
+				n=0;
+			}
+		}
+	}
+	bfile_procvec(bf,local,remote,n);
+	return len;
+}
+
+static int scanflags=0;
+
+void bfile_scanmode(int flags)
+{
+	scanflags=flags;
+}
+
+// a bulk read that starts inside the one before and goes on after it is
+// taken for a scan (a search, a checksum): from the second one on, the
+// file is read ahead by a scanio. anything else stops that again
+static unsigned int bfile_scanread(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	unsigned int n=0;
+	int onward=(pos>bf->scanpos && pos<=bf->scanend);
+	if (bf->scan!=NULL) n=scanio_read(bf->scan,pos,buf,len);
+	if (n==0 && bf->scan!=NULL)
+	{
+		scanio_close(bf->scan);
+		bf->scan=NULL;
+	}
+	if (n==0 && onward && bf->size-pos>SCANIO_CHUNK)
+	{
+		bf->scan=scanio_open(bf->fd,bf->filename,bf->size,pos,scanflags);
+		if (bf->scan!=NULL) n=scanio_read(bf->scan,pos,buf,len);
+	}
+	bf->scanpos=pos;
+	bf->scanend=pos+len;
+	return n;
+}
+
+static unsigned int bfile_rawread(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	unsigned int got=0;
+	ssize_t n;
+	if (bf->zf) got=zfile_read(bf->zf,pos,buf,len);
+	else if (bf->type==BFILE_PROCESS) got=bfile_procread(bf,pos,buf,len);
+	else
+	{
+		if (len>=BFILE_BLOCKSIZE) got=bfile_scanread(bf,pos,buf,len);
+		while (got<len)
+		{
+			n=pread(bf->fd,buf+got,len-got,pos+got);
+			STATS_ADD(syscalls,1);
+			if (n<=0) break;
+			got+=n;
+		}
+	}
+	STATS_ADD(bytesread,got);
+	return got;
+}
+
+static struct bblock *bfile_block(struct bfile *bf,file_position_t pos)
+{
+	unsigned int i;
+	struct bblock *victim=&bf->cache[0];
+	bf->tick++;
+	for (i=0;i<BFILE_CACHEBLOCKS;i++)
+	{
+		if (bf->cache[i].data!=NULL && bf->cache[i].pos==pos)
+		{
+			bf->cache[i].used=bf->tick;
+			STATS_ADD(cachehits,1);
+			return &bf->cache[i];
+		}
+		if (bf->cache[i].used<victim->used) victim=&bf->cache[i];
+	}
+	STATS_ADD(cachemisses,1);
+	if (victim->data==NULL) victim->data=malloc(BFILE_BLOCKSIZE);
+	victim->pos=pos;
+	victim->used=bf->tick;
+	victim->len=bfile_rawread(bf,pos,victim->data,BFILE_BLOCKSIZE);
+	return victim;
+}
+
+unsigned int bfile_read(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	struct bblock *blk;
+	unsigned int got=0;
+	unsigned int o;
+	unsigned int c;
+	if (pos>=bf->size) return 0;
+	if (len>bf->size-pos) len=bf->size-pos;
+	if (len>=BFILE_BLOCKSIZE) return bfile_rawread(bf,pos,buf,len);
+	while (got<len)
+	{
+		blk=bfile_block(bf,(pos+got)-((pos+got)%BFILE_BLOCKSIZE));
+		o=(pos+got)%BFILE_BLOCKSIZE;
+		if (blk->len<=o) break;
+		c=blk->len-o;
+		if (c>len-got) c=len-got;
+		memcpy(buf+got,blk->data+o,c);
+		got+=c;
+	}
+	return got;
+}
+
+// the view shows pos and moves dir (1: towards the end). the kernel is
+// asked to read the next BFILE_AHEAD bytes that way in the background, a
+// new window once the view is halfway through the last one. pread()
+// going backwards gets no readahead otherwise
+void bfile_prefetch(struct bfile *bf,file_position_t pos,int dir)
+{
+	file_position_t lo;
+	file_position_t hi;
+	if (bf->type!=BFILE_PLAIN || dir==0 || pos>bf->size) return;
+	if (dir>0)
+	{
+		if (bf->fetchhi>bf->fetchlo && pos>=bf->fetchlo && (pos+BFILE_AHEAD/2<=bf->fetchhi || bf->fetchhi>=bf->size)) return;
+		lo=pos;
+		hi=(bf->size-pos>BFILE_AHEAD)?pos+BFILE_AHEAD:bf->size;
+	} else {
+		if (bf->fetchhi>bf->fetchlo && pos<=bf->fetchhi && (pos>=bf->fetchlo+BFILE_AHEAD/2 || bf->fetchlo==0)) return;
+		hi=pos;
+		lo=(pos>BFILE_AHEAD)?pos-BFILE_AHEAD:0;
+	}
+	if (lo>=hi) return;
+	posix_fadvise(bf->fd,lo,hi-lo,POSIX_FADV_WILLNEED);
+	STATS_ADD(syscalls,1);
+	bf->fetchlo=lo;
+	bf->fetchhi=hi;
+}
+
+void bfile_invalidate(struct bfile *bf)
+{
+	unsigned int i;
+	for (i=0;i<BFILE_CACHEBLOCKS;i++)
+	{
+		bf->cache[i].used=0;
+		bf->cache[i].pos=(file_position_t)-1;
+	}
+}
+
+// a process changes under us: look at its mappings again and forget what
+// was cached. the size stays, so positions on the screen keep their meaning.
+void bfile_refresh(struct bfile *bf)
+{
+	if (bf->type==BFILE_PROCESS) bfile_readmaps(bf);
+	bfile_invalidate(bf);
+}
+
+static void bfile_findextents(struct bfile *bf)
+{
+	off_t data;
+	off_t hole;
+	unsigned int max=0;
+	bf->extents=0;
+	data=0;
+	for (;;)
+	{
+#ifdef SEEK_DATA
+		if (bf->type==BFILE_PLAIN)
+		{
+			data=lseek(bf->fd,data,SEEK_DATA);
+			STATS_ADD(syscalls,1);
+			if (data<0 && errno==ENXIO) break;	// only a hole left
+			if (data<0)
+			{
+				// no hole support in this filesystem
+				bf->extents=0;
+				data=0;
+				hole=bf->size;
+			} else {
+				hole=lseek(bf->fd,data,SEEK_HOLE);
+				STATS_ADD(syscalls,1);
+				if (hole<0) hole=bf->size;
+			}
+		} else
+#endif
+		hole=bf->size;
+		if (bf->extents==max)
+		{
+			max=max?max*2:16;
+			bf->extent=realloc(bf->extent,2*max*sizeof(file_position_t));
+		}
+		bf->extent[2*bf->extents]=data;
+		bf->extent[2*bf->extents+1]=hole;
+		bf->extents++;
+		if ((file_position_t)hole>=bf->size) break;
+		data=hole;
+	}
+}
+
+// is pos inside a hole of a sparse file? holes read as zeros without
+// touching the disk, so scanners can jump over them. [start,end) is the hole.
+int bfile_hole(struct bfile *bf,file_position_t pos,file_position_t *start,file_position_t *end)
+{
+	int lo=0;
+	int hi;
+	int mid;
+	if (bf->extents<0) bfile_findextents(bf);
+	if (pos>=bf->size) return 0;
+	hi=bf->extents;
+	while (lo<hi)
+	{
+		mid=(lo+hi)/2;
+		if (bf->extent[2*mid+1]<=pos) lo=mid+1; else hi=mid;
+	}
+	// lo is the first extent that ends after pos
+	if (lo<bf->extents && bf->extent[2*lo]<=pos) return 0;
+	*start=lo?bf->extent[2*lo-1]:0;
+	*end=(lo<bf->extents)?bf->extent[2*lo]:bf->size;
+	return 1;
+}
+
+// the first mapping of a process that ends after pos, [start,*end). scanners
+// go from one to the next instead of through the holes between them.
+// bf->size if there is none
+file_position_t bfile_nextdata(struct bfile *bf,file_position_t pos,file_position_t *end)
+{
+	int lo=0;
+	int hi;
+	int mid;
+	if (bf->extents<0) bfile_findextents(bf);
+	hi=bf->extents;
+	while (lo<hi)
+	{
+		mid=(lo+hi)/2;
+		if (bf->extent[2*mid+1]<=pos) lo=mid+1; else hi=mid;
+	}
+	*end=bf->size;
+	if (lo==bf->extents) return bf->size;
+	*end=bf->extent[2*lo+1];
+	return bf->extent[2*lo];
+}
+
+// start of the next (dir>0) or previous mapping of a process, or of the
+// data extent of a sparse file
+file_position_t bfile_nextregion(struct bfile *bf,file_position_t pos,int dir,file_position_t notfound)
+{
+	int i;
+	if (bf->extents<0) bfile_findextents(bf);
+	if (dir>0)
+	{
+		for (i=0;i<bf->extents;i++) if (bf->extent[2*i]>pos) return bf->extent[2*i];
+	} else {
+		for (i=bf->extents-1;i>=0;i--) if (bf->extent[2*i]<pos) return bf->extent[2*i];
+	}
+	return notfound;
+}
+
+// "rw-p [heap]" and the like for the mapping around pos
+const char *bfile_regionname(struct bfile *bf,file_position_t pos)
+{
+	int i;
+	if (bf->extname==NULL) return NULL;
+	for (i=0;i<bf->extents;i++) if (bf->extent[2*i]<=pos && pos<bf->extent[2*i+1]) return bf->extname[i];
+	return "unmapped";
+}
+
+// name of a file dhex keeps next to the input file. if that directory is
+// not writable it goes to ~/.dhexcache instead.
+char *bfile_sidecar(const char *filename,const char *ext)
+{
+	struct stat st;
+	char *name;
+	char *dir;
+	const char *base;
+	const char *home;
+	name=malloc(strlen(filename)+strlen(ext)+1);
+	sprintf(name,"%s%s",filename,ext);
+	if (access(name,W_OK)==0) return name;
+	dir=malloc(strlen(filename)+2);
+	strncpy(dir,filename,strlen(filename)+1);
+	if (strrchr(dir,'/')!=NULL) strrchr(dir,'/')[1]=0; else strcpy(dir,".");
+	if (access(dir,W_OK)==0)
+	{
+		free(dir);
+		return name;
+	}
+	free(dir);
+	free(name);
+	home=getenv("HOME");
+	if (home==NULL || stat(filename,&st)!=0) return NULL;
+	base=strrchr(filename,'/')?strrchr(filename,'/')+1:filename;
+	name=malloc(strlen(home)+strlen(base)+strlen(ext)+64);
+	sprintf(name,"%s/.dhexcache",home);
+	mkdir(name,0700);
+	sprintf(name,"%s/.dhexcache/%s_%lx_%lx%s",home,base,(unsigned long)st.st_dev,(unsigned long)st.st_ino,ext);
+	return name;
+}
@@ -0,0 +1,61 @@
+#ifndef BFILE_H
+#define BFILE_H
+#include "data.h"
+
+#define BFILE_PLAIN 0
+#define BFILE_GZIP 1
+#define BFILE_ZSTD 2
+#define BFILE_PROCESS 3
+
+#define BFILE_BLOCKSIZE 65536
+#define BFILE_CACHEBLOCKS 64
+#define BFILE_AHEAD 8388608		// read ahead of a scrolling view
+
+struct zfile;
+struct scanio;
+
+struct bblock
+{
+	file_position_t pos;
+	unsigned int len;
+	unsigned int used;
+	unsigned char *data;
+};
+
+struct bfile
+{
+	char *filename;
+	int type;
+	int fd;
+	file_position_t size;		// what the user sees, i.e. uncompressed
+	struct zfile *zf;
+	int extents;			// -1: not looked for holes yet
+	file_position_t *extent;	// start,end of every data region
+	char **extname;			// BFILE_PROCESS: what /proc/pid/maps says about it
+	int pid;
+	unsigned int tick;
+	file_position_t fetchlo;	// what bfile_prefetch() asked for last
+	file_position_t fetchhi;
+	struct scanio *scan;		// reading ahead of a scan
+	file_position_t scanpos;	// the last bulk read
+	file_position_t scanend;
+	struct bblock cache[BFILE_CACHEBLOCKS];
+};
+
+struct bfile *bfile_open(const char *filename);
+struct bfile *bfile_openpid(int pid);
+struct bfile *bfile_dup(struct bfile *bf);
+void bfile_close(struct bfile *bf);
+file_position_t bfile_size(struct bfile *bf);
+unsigned int bfile_read(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len);
+void bfile_invalidate(struct bfile *bf);
+void bfile_prefetch(struct bfile *bf,file_position_t pos,int dir);
+void bfile_scanmode(int flags);
+int bfile_hole(struct bfile *bf,file_position_t pos,file_position_t *start,file_position_t *end);
+void bfile_refresh(struct bfile *bf);
+file_position_t bfile_nextdata(struct bfile *bf,file_position_t pos,file_position_t *end);
+file_position_t bfile_nextregion(struct bfile *bf,file_position_t pos,int dir,file_position_t notfound);
+const char *bfile_regionname(struct bfile *bf,file_position_t pos);
+char *bfile_sidecar(const char *filename,const char *ext);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bits.h"
+
+// searching for a pattern that does not start at a byte boundary: the
+// pattern is kept shifted by 0..7 bits, so at every byte all 8 shifts are
+// tried. one byte of each shift is compared for 16 positions at once, only
+// where it matches the whole pattern is looked at.
+
+#define BITS_CHUNK 1048576
+
+// 0 and 1 are bits, x and . either, blanks are left out
+int bits_parse(struct bits *b,const char *text)
+{
+	unsigned char v[BITS_MAX];
+	unsigned char c[BITS_MAX];
+	unsigned int n=0;
+	unsigned int cared=0;
+	unsigned int s;
+	unsigned int k;
+	unsigned int j;
+	unsigned int best;
+	unsigned int w;
+	for (;*text;text++)
+	{
+		if (*text==' ') continue;
+		if (n==BITS_MAX) return 0;
+		if (*text=='0' || *text=='1')
+		{
+			v[n]=*text-'0';
+			c[n]=1;
+			cared++;
+		}
+		else if (*text=='x' || *text=='X' || *text=='.')
+		{
+			v[n]=0;
+			c[n]=0;
+		}
+		else return 0;
+		n++;
+	}
+	if (cared==0) return 0;
+	memset(b,0,sizeof(*b));
+	b->nbits=n;
+	for (s=0;s<8;s++)
+	{
+		b->len[s]=(s+n+7)/8;
+		for (k=0;k<n;k++)
+		{
+			if (!c[k]) continue;
+			b->mask[s][(s+k)/8]|=0x80>>((s+k)%8);
+			if (v[k]) b->val[s][(s+k)/8]|=0x80>>((s+k)%8);
+		}
+		// the byte with the most bits that matter lets the fewest through
+		best=0;
+		for (j=0;j<b->len[s];j++)
+		{
+			for (w=0,k=b->mask[s][j];k;k&=k-1) w++;
+			if (w>best)
+			{
+				best=w;
+				b->key[s]=j;
+			}
+		}
+	}
+	return 1;
+}
+
+static int matches(struct bits *b,const unsigned char *buf,unsigned int i,unsigned int s,unsigned int n)
+{
+	unsigned int j;
+	if (i+b->len[s]>n) return 0;
+	for (j=0;j<b->len[s];j++) if ((buf[i+j]&b->mask[s][j])!=b->val[s][j]) return 0;
+	return 1;
+}
+
+// positions [0,npos) of buf, buf has n bytes
+static int block(struct bits *b,const unsigned char *buf,unsigned int npos,unsigned int n,file_position_t base,bits_hitfn hitfn)
+{
+	unsigned int i=0;
+	unsigned int j;
+	unsigned int s;
+#ifdef __SSE2__
+	__m128i val[8];
+	__m128i mask[8];
+	unsigned int hit[8];
+	unsigned int any;
+	for (s=0;s<8;s++)
+	{
+		val[s]=_mm_set1_epi8((char)b->val[s][b->key[s]]);
+		mask[s]=_mm_set1_epi8((char)b->mask[s][b->key[s]]);
+	}
+	// the widest shift reads len[7] bytes on from the last position
+	for (i=0;i+16<=npos && i+15+b->len[7]<=n;i+=16)
+	{
+		any=0;
+		for (s=0;s<8;s++)
+		{
+			hit[s]=_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128((const __m128i *)(buf+i+b->key[s])),mask[s]),val[s]));
+			any|=hit[s];
+		}
+		if (any==0) continue;
+		for (j=0;j<16;j++)
+		{
+			if (((any>>j)&1)==0) continue;
+			for (s=0;s<8;s++)
+				if (((hit[s]>>j)&1) && matches(b,buf,i+j,s,n) && hitfn((base+i+j)*8+s)) return 1;
+		}
+	}
+#endif
+	for (;i<npos;i++)
+		for (s=0;s<8;s++)
+			if (matches(b,buf,i,s,n) && hitfn((base+i)*8+s)) return 1;
+	return 0;
+}
+
+// hits are bit offsets from the start of the file, in order. the pattern
+// starts in [pos,end) and ends before end
+int bits_search(struct bits *b,bits_readfn readfn,file_position_t pos,file_position_t end,bits_hitfn hitfn)
+{
+	unsigned char *buf;
+	unsigned int overlap=b->len[7]-1;
+	unsigned int want;
+	unsigned int npos;
+	unsigned int n;
+	int r=0;
+	buf=malloc(BITS_CHUNK+BITS_BYTES);
+	while (r==0 && pos<end)
+	{
+		want=(end-pos<BITS_CHUNK+overlap)?end-pos:BITS_CHUNK+overlap;
+		n=readfn(pos,buf,want);
+		if (n==0) break;
+		// what starts in the overlap is looked at with the next chunk
+		npos=(n==want && pos+n<end)?n-overlap:n;
+		r=block(b,buf,npos,n,pos,hitfn);
+		if (n<want) break;
+		pos+=npos;
+	}
+	free(buf);
+	return r;
+}
+
+// the bytes as they are when read starting shift bits late, buf has one
+// byte more than len
+void bits_shift(unsigned char *buf,unsigned int len,unsigned int shift)
+{
+	unsigned int i;
+	if (shift==0) return;
+	for (i=0;i<len;i++) buf[i]=(buf[i]<<shift)|(buf[i+1]>>(8-shift));
+}
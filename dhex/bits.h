@@ -0,0 +1,26 @@
+#ifndef BITS_H
+#define BITS_H
+#include "data.h"
+
+#define BITS_MAX 256			// bits in a pattern
+#define BITS_BYTES (BITS_MAX/8+1)	// bytes it covers at the most
+
+// a bit pattern, shifted ahead of time to start at each bit of a byte.
+// bits count from the most significant one, as they read in the hex view
+struct bits
+{
+	unsigned int nbits;
+	unsigned int len[8];			// bytes the pattern covers, starting at bit s
+	unsigned char val[8][BITS_BYTES];
+	unsigned char mask[8][BITS_BYTES];	// the bits that have to match
+	unsigned int key[8];			// the byte compared first
+};
+
+typedef unsigned int (*bits_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+typedef int (*bits_hitfn)(file_position_t bitpos);	// nonzero stops
+
+int bits_parse(struct bits *b,const char *text);
+int bits_search(struct bits *b,bits_readfn readfn,file_position_t pos,file_position_t end,bits_hitfn hitfn);
+void bits_shift(unsigned char *buf,unsigned int len,unsigned int shift);
+
+#endif
@@ -0,0 +1,864 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bregex.h"
+
+// the pattern becomes a thompson NFA, which is run as a DFA that is built
+// lazily, one transition at a time, as the data needs it. searching runs
+// the DFA for .*R over the file until the first match ends, then the DFA
+// of the reversed R backwards from there to find where that match starts.
+
+#define RE_MAXNFA 65536
+#define RE_MAXDFA 2048		// states in the cache, it is flushed when full
+#define RE_MAXREPEAT 4096
+#define RE_CHUNK 1048576
+#define RE_BLOCK 4096
+
+#define RN_CLASS 0
+#define RN_CAT 1
+#define RN_ALT 2
+#define RN_REPEAT 3
+#define RN_EMPTY 4
+
+struct rnode
+{
+	int type;
+	int a;
+	int b;
+	int min;
+	int max;		// -1: no limit
+	unsigned char cls[32];
+};
+
+struct nstate
+{
+	int cls;		// index into nfa.cls, -1: only epsilon moves
+	int next;
+	int *eps;
+	int neps;
+	int maxeps;
+};
+
+struct nfa
+{
+	struct nstate *st;
+	int n;
+	int max;
+	unsigned char (*cls)[32];
+	int ncls;
+	int maxcls;
+	int start;
+	int accept;
+};
+
+// transitions: -1 not computed yet, >=0 the row of the next state,
+// <=-2 -(row+2) of the next state, which is accepting
+struct dfa
+{
+	struct nfa *nfa;
+	const unsigned char *bytemap;
+	const unsigned char *bytes;	// the bytes of every class, see bregex.classbytes
+	const int *classstart;
+	int anchored;
+	int *tab;
+	int nstates;
+	int *setoff;
+	int *setlen;
+	int *pool;
+	int poolused;
+	int poolmax;
+	int *hash;
+	unsigned char *acc;
+	int *work;
+	int *seeds;
+	int *set;
+	unsigned int *mark;
+	unsigned int gen;
+	int start;
+};
+
+struct bregex
+{
+	struct rnode *node;
+	int nnodes;
+	int maxnodes;
+	const char *p;
+	const char *error;
+	struct nfa fwd;
+	struct nfa rev;
+	unsigned char bytemap[256];
+	unsigned char classbytes[256];
+	int classstart[257];
+	struct dfa search;	// .*R forward
+	struct dfa back;	// R reversed, anchored
+	struct dfa anchored;	// R forward, anchored
+	unsigned char *buf;
+	file_position_t bufpos;
+	unsigned int buflen;
+};
+
+static int hexval(char c)
+{
+	if (c>='0' && c<='9') return c-'0';
+	if (c>='a' && c<='f') return c-'a'+10;
+	if (c>='A' && c<='F') return c-'A'+10;
+	if (c=='x' || c=='X') return 16;
+	return -1;
+}
+
+static int rnode(struct bregex *re,int type,int a,int b)
+{
+	struct rnode *n;
+	if (re->nnodes==re->maxnodes)
+	{
+		re->maxnodes=re->maxnodes?re->maxnodes*2:64;
+		re->node=realloc(re->node,re->maxnodes*sizeof(struct rnode));
+	}
+	n=&re->node[re->nnodes];
+	memset(n,0,sizeof(struct rnode));
+	n->type=type;
+	n->a=a;
+	n->b=b;
+	return re->nnodes++;
+}
+
+static void skipblank(struct bregex *re)
+{
+	while (*re->p==' ' || *re->p=='\t' || *re->p==',') re->p++;
+}
+
+// two hex digits, x stands for any nibble
+static int hexbyte(struct bregex *re,unsigned char *cls)
+{
+	int hi=hexval(re->p[0]);
+	int lo;
+	int i;
+	if (hi<0) return 0;
+	lo=hexval(re->p[1]);
+	if (lo<0)
+	{
+		re->error="hex bytes need two digits";
+		return 0;
+	}
+	re->p+=2;
+	for (i=0;i<256;i++) if ((hi==16 || (i>>4)==hi) && (lo==16 || (i&15)==lo)) cls[i>>3]|=1<<(i&7);
+	return 1;
+}
+
+static int parsealt(struct bregex *re);
+
+static int parseclass(struct bregex *re,unsigned char *cls)
+{
+	unsigned char a[32];
+	unsigned char b[32];
+	int negate=0;
+	int i;
+	int lo;
+	int hi;
+	re->p++;
+	if (*re->p=='^')
+	{
+		negate=1;
+		re->p++;
+	}
+	for (;;)
+	{
+		skipblank(re);
+		if (*re->p==']') break;
+		memset(a,0,sizeof(a));
+		if (!hexbyte(re,a))
+		{
+			if (re->error==NULL) re->error="bad class";
+			return 0;
+		}
+		skipblank(re);
+		if (*re->p=='-')
+		{
+			re->p++;
+			skipblank(re);
+			memset(b,0,sizeof(b));
+			if (!hexbyte(re,b))
+			{
+				if (re->error==NULL) re->error="bad range";
+				return 0;
+			}
+			for (lo=0;lo<256 && !(a[lo>>3]&(1<<(lo&7)));lo++);
+			for (hi=255;hi>=0 && !(b[hi>>3]&(1<<(hi&7)));hi--);
+			for (i=lo;i<=hi;i++) a[i>>3]|=1<<(i&7);
+		}
+		for (i=0;i<32;i++) cls[i]|=a[i];
+	}
+	re->p++;
+	if (negate) for (i=0;i<32;i++) cls[i]=~cls[i];
+	return 1;
+}
+
+static int parsestring(struct bregex *re)
+{
+	int n=-1;
+	int c;
+	int lit;
+	re->p++;
+	while (*re->p!='"')
+	{
+		if (*re->p==0)
+		{
+			re->error="missing \"";
+			return -1;
+		}
+		c=(unsigned char)*re->p++;
+		if (c=='\\' && *re->p)
+		{
+			c=(unsigned char)*re->p++;
+			if ((c=='x' || c=='X') && hexval(re->p[0])>=0 && hexval(re->p[0])<16 && hexval(re->p[1])>=0 && hexval(re->p[1])<16)
+			{
+				c=hexval(re->p[0])*16+hexval(re->p[1]);
+				re->p+=2;
+			}
+		}
+		lit=rnode(re,RN_CLASS,0,0);
+		re->node[lit].cls[c>>3]|=1<<(c&7);
+		n=(n<0)?lit:rnode(re,RN_CAT,n,lit);
+	}
+	re->p++;
+	if (n<0) n=rnode(re,RN_EMPTY,0,0);
+	return n;
+}
+
+static int parseatom(struct bregex *re)
+{
+	int n;
+	skipblank(re);
+	if (*re->p=='(')
+	{
+		re->p++;
+		n=parsealt(re);
+		if (n<0) return -1;
+		skipblank(re);
+		if (*re->p!=')')
+		{
+			re->error="missing )";
+			return -1;
+		}
+		re->p++;
+		return n;
+	}
+	if (*re->p=='"') return parsestring(re);
+	n=rnode(re,RN_CLASS,0,0);
+	if (*re->p=='.')
+	{
+		re->p++;
+		memset(re->node[n].cls,0xff,32);
+		return n;
+	}
+	if (*re->p=='[')
+	{
+		if (!parseclass(re,re->node[n].cls)) return -1;
+		return n;
+	}
+	if (!hexbyte(re,re->node[n].cls))
+	{
+		if (re->error==NULL) re->error="unexpected character";
+		return -1;
+	}
+	return n;
+}
+
+static int parsenumber(struct bregex *re)
+{
+	int v=0;
+	if (*re->p<'0' || *re->p>'9') return -1;
+	while (*re->p>='0' && *re->p<='9' && v<=RE_MAXREPEAT) v=v*10+(*re->p++-'0');
+	return v;
+}
+
+static int parserepeat(struct bregex *re)
+{
+	int n;
+	int r;
+	n=parseatom(re);
+	for (;;)
+	{
+		if (n<0) return -1;
+		skipblank(re);
+		if (*re->p!='*' && *re->p!='+' && *re->p!='?' && *re->p!='{') return n;
+		r=rnode(re,RN_REPEAT,n,0);
+		if (*re->p=='*') re->node[r].max=-1;
+		if (*re->p=='+')
+		{
+			re->node[r].min=1;
+			re->node[r].max=-1;
+		}
+		if (*re->p=='?') re->node[r].max=1;
+		if (*re->p=='{')
+		{
+			re->p++;
+			re->node[r].min=parsenumber(re);
+			re->node[r].max=re->node[r].min;
+			if (*re->p==',')
+			{
+				re->p++;
+				re->node[r].max=(*re->p=='}')?-1:parsenumber(re);
+			}
+			if (*re->p!='}' || re->node[r].min<0 || (re->node[r].max>=0 && re->node[r].max<re->node[r].min))
+			{
+				re->error="bad {n,m}";
+				return -1;
+			}
+			if (re->node[r].min>RE_MAXREPEAT || re->node[r].max>RE_MAXREPEAT)
+			{
+				re->error="repeat count too big";
+				return -1;
+			}
+		}
+		re->p++;
+		n=r;
+	}
+}
+
+static int parsecat(struct bregex *re)
+{
+	int n=-1;
+	int r;
+	for (;;)
+	{
+		skipblank(re);
+		if (*re->p==0 || *re->p=='|' || *re->p==')') break;
+		r=parserepeat(re);
+		if (r<0) return -1;
+		n=(n<0)?r:rnode(re,RN_CAT,n,r);
+	}
+	if (n<0) n=rnode(re,RN_EMPTY,0,0);
+	return n;
+}
+
+static int parsealt(struct bregex *re)
+{
+	int n;
+	int r;
+	n=parsecat(re);
+	while (n>=0 && *re->p=='|')
+	{
+		re->p++;
+		r=parsecat(re);
+		if (r<0) return -1;
+		n=rnode(re,RN_ALT,n,r);
+	}
+	return n;
+}
+
+static int nstate(struct bregex *re,struct nfa *nfa)
+{
+	if (nfa->n==RE_MAXNFA)
+	{
+		re->error="pattern too big";
+		return 0;
+	}
+	if (nfa->n==nfa->max)
+	{
+		nfa->max=nfa->max?nfa->max*2:256;
+		nfa->st=realloc(nfa->st,nfa->max*sizeof(struct nstate));
+	}
+	memset(&nfa->st[nfa->n],0,sizeof(struct nstate));
+	nfa->st[nfa->n].cls=-1;
+	return nfa->n++;
+}
+
+static void eps(struct nfa *nfa,int from,int to)
+{
+	struct nstate *s=&nfa->st[from];
+	if (s->neps==s->maxeps)
+	{
+		s->maxeps=s->maxeps?s->maxeps*2:2;
+		s->eps=realloc(s->eps,s->maxeps*sizeof(int));
+	}
+	s->eps[s->neps++]=to;
+}
+
+static int addclass(struct nfa *nfa,const unsigned char *cls)
+{
+	if (nfa->ncls==nfa->maxcls)
+	{
+		nfa->maxcls=nfa->maxcls?nfa->maxcls*2:64;
+		nfa->cls=realloc(nfa->cls,nfa->maxcls*32);
+	}
+	memcpy(nfa->cls[nfa->ncls],cls,32);
+	return nfa->ncls++;
+}
+
+// the fragment for node n goes from *s to *e
+static void gen(struct bregex *re,int n,int *s,int *e)
+{
+	struct nfa *nfa=&re->fwd;
+	struct rnode node;
+	int s1,e1,s2,e2;
+	int i;
+	*s=nstate(re,nfa);
+	*e=*s;
+	if (re->error) return;
+	node=re->node[n];
+	switch (node.type)
+	{
+		case RN_CLASS:
+			*e=nstate(re,nfa);
+			nfa->st[*s].cls=addclass(nfa,node.cls);
+			nfa->st[*s].next=*e;
+			break;
+		case RN_CAT:
+			gen(re,node.a,&s1,&e1);
+			gen(re,node.b,&s2,&e2);
+			if (re->error) return;
+			eps(nfa,*s,s1);
+			eps(nfa,e1,s2);
+			*e=e2;
+			break;
+		case RN_ALT:
+			gen(re,node.a,&s1,&e1);
+			gen(re,node.b,&s2,&e2);
+			*e=nstate(re,nfa);
+			if (re->error) return;
+			eps(nfa,*s,s1);
+			eps(nfa,*s,s2);
+			eps(nfa,e1,*e);
+			eps(nfa,e2,*e);
+			break;
+		case RN_REPEAT:
+			for (i=0;i<node.min && !re->error;i++)
+			{
+				gen(re,node.a,&s1,&e1);
+				if (re->error) return;
+				eps(nfa,*e,s1);
+				*e=e1;
+			}
+			if (node.max<0)
+			{
+				gen(re,node.a,&s1,&e1);
+				e2=nstate(re,nfa);
+				if (re->error) return;
+				eps(nfa,*e,s1);
+				eps(nfa,*e,e2);
+				eps(nfa,e1,s1);
+				eps(nfa,e1,e2);
+				*e=e2;
+			}
+			for (i=node.min;i<node.max && !re->error;i++)
+			{
+				gen(re,node.a,&s1,&e1);
+				e2=nstate(re,nfa);
+				if (re->error) return;
+				eps(nfa,*e,s1);
+				eps(nfa,*e,e2);
+				eps(nfa,e1,e2);
+				*e=e2;
+			}
+			break;
+	}
+}
+
+// every edge turned around. a class edge s->t becomes t->x->s with a new x
+static void reverse(struct bregex *re)
+{
+	struct nfa *f=&re->fwd;
+	struct nfa *r=&re->rev;
+	int i;
+	int j;
+	int x;
+	for (i=0;i<f->n;i++) nstate(re,r);
+	for (i=0;i<f->n;i++)
+	{
+		for (j=0;j<f->st[i].neps;j++) eps(r,f->st[i].eps[j],i);
+		if (f->st[i].cls>=0)
+		{
+			x=nstate(re,r);
+			if (re->error) return;
+			r->st[x].cls=f->st[i].cls;
+			r->st[x].next=i;
+			eps(r,f->st[i].next,x);
+		}
+	}
+	r->cls=f->cls;
+	r->ncls=f->ncls;
+	r->start=f->accept;
+	r->accept=f->start;
+}
+
+// bytes that no class tells apart share one column of the DFA
+static void byteclasses(struct bregex *re)
+{
+	unsigned char map[256];
+	int renum[512];
+	int i;
+	int c;
+	int n=1;
+	int b;
+	memset(re->bytemap,0,256);
+	for (c=0;c<re->fwd.ncls;c++)
+	{
+		for (i=0;i<512;i++) renum[i]=-1;
+		n=0;
+		for (i=0;i<256;i++)
+		{
+			b=re->bytemap[i]*2+((re->fwd.cls[c][i>>3]>>(i&7))&1);
+			if (renum[b]<0) renum[b]=n++;
+			map[i]=renum[b];
+		}
+		memcpy(re->bytemap,map,256);
+	}
+	memset(re->classstart,0,sizeof(re->classstart));
+	for (i=0;i<256;i++) re->classstart[re->bytemap[i]+1]++;
+	for (c=0;c<256;c++) re->classstart[c+1]+=re->classstart[c];
+	memcpy(renum,re->classstart,256*sizeof(int));
+	for (i=0;i<256;i++) re->classbytes[renum[re->bytemap[i]]++]=i;
+}
+
+static void dfa_init(struct bregex *re,struct dfa *d,struct nfa *nfa,int anchored)
+{
+	memset(d,0,sizeof(struct dfa));
+	d->nfa=nfa;
+	d->bytemap=re->bytemap;
+	d->bytes=re->classbytes;
+	d->classstart=re->classstart;
+	d->anchored=anchored;
+	d->tab=malloc(RE_MAXDFA*256*sizeof(int));
+	d->setoff=malloc(RE_MAXDFA*sizeof(int));
+	d->setlen=malloc(RE_MAXDFA*sizeof(int));
+	d->acc=malloc(RE_MAXDFA);
+	d->hash=malloc(2*RE_MAXDFA*sizeof(int));
+	d->work=malloc((nfa->n+1)*sizeof(int));
+	d->seeds=malloc((nfa->n+1)*sizeof(int));
+	d->set=malloc((nfa->n+1)*sizeof(int));
+	d->mark=calloc(nfa->n+1,sizeof(unsigned int));
+	memset(d->hash,0xff,2*RE_MAXDFA*sizeof(int));
+	d->start=-1;
+}
+
+static void dfa_free(struct dfa *d)
+{
+	free(d->tab);
+	free(d->setoff);
+	free(d->setlen);
+	free(d->acc);
+	free(d->pool);
+	free(d->hash);
+	free(d->work);
+	free(d->seeds);
+	free(d->set);
+	free(d->mark);
+}
+
+static int cmpint(const void *a,const void *b)
+{
+	return *(const int *)a-*(const int *)b;
+}
+
+// epsilon closure of the seeds, only the states that matter for the DFA
+// (the ones with a class edge, and accept) are kept. returns the size
+static int closure(struct dfa *d,int nseeds,int *set)
+{
+	struct nfa *nfa=d->nfa;
+	int sp=0;
+	int n=0;
+	int q;
+	int i;
+	int j;
+	d->gen++;
+	for (i=0;i<nseeds;i++)
+	{
+		if (d->mark[d->seeds[i]]==d->gen) continue;
+		d->mark[d->seeds[i]]=d->gen;
+		d->work[sp++]=d->seeds[i];
+	}
+	while (sp>0)
+	{
+		q=d->work[--sp];
+		if (nfa->st[q].cls>=0 || q==nfa->accept) set[n++]=q;
+		for (j=0;j<nfa->st[q].neps;j++)
+		{
+			if (d->mark[nfa->st[q].eps[j]]==d->gen) continue;
+			d->mark[nfa->st[q].eps[j]]=d->gen;
+			d->work[sp++]=nfa->st[q].eps[j];
+		}
+	}
+	qsort(set,n,sizeof(int),cmpint);
+	return n;
+}
+
+static unsigned int sethash(const int *set,int n)
+{
+	unsigned int h=2166136261U;
+	int i;
+	for (i=0;i<n;i++) h=(h^set[i])*16777619U;
+	return h;
+}
+
+static void dfa_flush(struct dfa *d)
+{
+	d->nstates=0;
+	d->poolused=0;
+	d->start=-1;
+	memset(d->hash,0xff,2*RE_MAXDFA*sizeof(int));
+}
+
+// the row of the state for this set of NFA states, -1 if the cache is full
+static int dfa_intern(struct dfa *d,const int *set,int n)
+{
+	unsigned int h;
+	int i;
+	int s;
+	h=sethash(set,n)&(2*RE_MAXDFA-1);
+	while ((s=d->hash[h])>=0)
+	{
+		if (d->setlen[s]==n && memcmp(d->pool+d->setoff[s],set,n*sizeof(int))==0) return s*256;
+		h=(h+1)&(2*RE_MAXDFA-1);
+	}
+	if (d->nstates==RE_MAXDFA) return -1;
+	if (d->poolused+n>d->poolmax)
+	{
+		d->poolmax=d->poolmax?d->poolmax*2:65536;
+		while (d->poolused+n>d->poolmax) d->poolmax*=2;
+		d->pool=realloc(d->pool,d->poolmax*sizeof(int));
+	}
+	s=d->nstates++;
+	memcpy(d->pool+d->poolused,set,n*sizeof(int));
+	d->setoff[s]=d->poolused;
+	d->setlen[s]=n;
+	d->acc[s]=0;
+	for (i=0;i<n;i++) if (set[i]==d->nfa->accept) d->acc[s]=1;
+	d->poolused+=n;
+	d->hash[h]=s;
+	for (i=0;i<256;i++) d->tab[s*256+i]=-1;
+	return s*256;
+}
+
+static int dfa_start(struct dfa *d)
+{
+	int n;
+	if (d->start<0)
+	{
+		d->seeds[0]=d->nfa->start;
+		n=closure(d,1,d->set);
+		d->start=dfa_intern(d,d->set,n);
+		if (d->start<0)
+		{
+			dfa_flush(d);
+			d->start=dfa_intern(d,d->set,n);
+		}
+	}
+	return d->start;
+}
+
+// fills in the transition of state row for byte b (and every byte that
+// behaves the same) and returns it
+static int dfa_step(struct dfa *d,int row,int b)
+{
+	struct nfa *nfa=d->nfa;
+	int s=row/256;
+	int n=0;
+	int i;
+	int q;
+	int c;
+	int next;
+	int t;
+	for (i=0;i<d->setlen[s];i++)
+	{
+		q=d->pool[d->setoff[s]+i];
+		c=nfa->st[q].cls;
+		if (c>=0 && ((nfa->cls[c][b>>3]>>(b&7))&1)) d->seeds[n++]=nfa->st[q].next;
+	}
+	if (!d->anchored) d->seeds[n++]=nfa->start;
+	n=closure(d,n,d->set);
+	next=dfa_intern(d,d->set,n);
+	if (next<0)
+	{
+		// cache full, start over from the state we are going to
+		dfa_flush(d);
+		next=dfa_intern(d,d->set,n);
+		return d->acc[next/256]?-(next+2):next;
+	}
+	t=d->acc[next/256]?-(next+2):next;
+	c=d->bytemap[b];
+	for (i=d->classstart[c];i<d->classstart[c+1];i++) d->tab[row+d->bytes[i]]=t;
+	return t;
+}
+
+static int dfa_dead(struct dfa *d,int row)
+{
+	return d->setlen[row/256]==0;
+}
+
+// makes pos part of the buffer, returns how many bytes there are from pos on
+static unsigned int fill(struct bregex *re,bregex_readfn readfn,file_position_t pos)
+{
+	if (re->buflen==0 || pos<re->bufpos || pos>=re->bufpos+re->buflen)
+	{
+		re->bufpos=pos;
+		re->buflen=readfn(pos,re->buf,RE_CHUNK);
+		if (re->buflen==0) return 0;
+	}
+	return re->bufpos+re->buflen-pos;
+}
+
+// the leftmost start of a match that ends at e, but not before from
+static file_position_t back(struct bregex *re,bregex_readfn readfn,file_position_t from,file_position_t e)
+{
+	struct dfa *d=&re->back;
+	unsigned char blk[RE_BLOCK];
+	const unsigned char *src;
+	file_position_t q=e;
+	file_position_t start=e-1;
+	unsigned int n;
+	unsigned int i;
+	int row;
+	int t;
+	row=dfa_start(d);
+	while (q>from)
+	{
+		n=(q-from<RE_BLOCK)?q-from:RE_BLOCK;
+		if (q-n>=re->bufpos && q<=re->bufpos+re->buflen) src=re->buf+(q-n-re->bufpos);
+		else
+		{
+			if (readfn(q-n,blk,n)<n) return start;
+			src=blk;
+		}
+		for (i=n;i>0;i--)
+		{
+			t=d->tab[row+src[i-1]];
+			if (t==-1) t=dfa_step(d,row,src[i-1]);
+			q--;
+			if (t<0)
+			{
+				row=-(t+2);
+				start=q;
+			} else row=t;
+			if (dfa_dead(d,row)) return start;
+		}
+	}
+	return start;
+}
+
+// the first match in [pos,end) that ends, as [*start,*stop)
+int bregex_search(struct bregex *re,bregex_readfn readfn,file_position_t pos,file_position_t end,file_position_t *start,file_position_t *stop)
+{
+	struct dfa *d=&re->search;
+	const unsigned char *b;
+	file_position_t from=pos;
+	unsigned int n;
+	unsigned int i;
+	int row;
+	int t;
+	row=dfa_start(d);
+	while (pos<end)
+	{
+		n=fill(re,readfn,pos);
+		if (n==0) break;
+		if (n>end-pos) n=end-pos;
+		b=re->buf+(pos-re->bufpos);
+		for (i=0;i<n;i++)
+		{
+			t=d->tab[row+b[i]];
+			if (t>=0)
+			{
+				row=t;
+				continue;
+			}
+			if (t==-1)
+			{
+				t=dfa_step(d,row,b[i]);
+				if (t>=0)
+				{
+					row=t;
+					continue;
+				}
+			}
+			*stop=pos+i+1;
+			*start=back(re,readfn,from,*stop);
+			return 1;
+		}
+		pos+=n;
+	}
+	return 0;
+}
+
+// does a match begin at pos?
+int bregex_matchat(struct bregex *re,bregex_readfn readfn,file_position_t pos,file_position_t end)
+{
+	struct dfa *d=&re->anchored;
+	unsigned char blk[RE_BLOCK];
+	unsigned int n;
+	unsigned int i;
+	int row;
+	int t;
+	row=dfa_start(d);
+	while (pos<end)
+	{
+		n=readfn(pos,blk,(end-pos<RE_BLOCK)?end-pos:RE_BLOCK);
+		if (n==0) break;
+		for (i=0;i<n;i++)
+		{
+			t=d->tab[row+blk[i]];
+			if (t==-1) t=dfa_step(d,row,blk[i]);
+			if (t<0) return 1;
+			row=t;
+			if (dfa_dead(d,row)) return 0;
+		}
+		pos+=n;
+	}
+	return 0;
+}
+
+struct bregex *bregex_compile(const char *pattern,const char **error)
+{
+	struct bregex *re;
+	int root;
+	int s;
+	int e;
+	re=calloc(1,sizeof(struct bregex));
+	re->p=pattern;
+	root=parsealt(re);
+	if (re->error==NULL && *re->p!=0) re->error=(*re->p==')')?"unbalanced )":"unexpected character";
+	if (re->error==NULL)
+	{
+		gen(re,root,&s,&e);
+		re->fwd.start=s;
+		re->fwd.accept=e;
+	}
+	if (re->error==NULL) reverse(re);
+	if (re->error==NULL)
+	{
+		byteclasses(re);
+		dfa_init(re,&re->search,&re->fwd,0);
+		dfa_init(re,&re->back,&re->rev,1);
+		dfa_init(re,&re->anchored,&re->fwd,1);
+		if (re->anchored.acc[dfa_start(&re->anchored)/256]) re->error="matches the empty string";
+	}
+	if (re->error!=NULL)
+	{
+		*error=re->error;
+		bregex_free(re);
+		return NULL;
+	}
+	re->buf=malloc(RE_CHUNK);
+	return re;
+}
+
+void bregex_free(struct bregex *re)
+{
+	int i;
+	if (re==NULL) return;
+	for (i=0;i<re->fwd.n;i++) free(re->fwd.st[i].eps);
+	for (i=0;i<re->rev.n;i++) free(re->rev.st[i].eps);
+	free(re->fwd.st);
+	free(re->rev.st);
+	free(re->fwd.cls);
+	if (re->search.tab) dfa_free(&re->search);
+	if (re->back.tab) dfa_free(&re->back);
+	if (re->anchored.tab) dfa_free(&re->anchored);
+	free(re->node);
+	free(re->buf);
+	free(re);
+}
+
+// the bytes read last are kept between searches, until the data is another
+void bregex_forget(struct bregex *re)
+{
+	re->buflen=0;
+}
@@ -0,0 +1,23 @@
+#ifndef BREGEX_H
+#define BREGEX_H
+#include "data.h"
+
+// byte oriented regular expressions:
+//   E1 2F       bytes in hex, blanks don't matter
+//   1x x1 xx .  nibble wildcards, xx and . are any byte
+//   "text"      ascii, \" \\ and \xHH inside
+//   [00-1F 7F]  a class, [^00] its complement
+//   ( | )       grouping and alternation
+//   * + ? {n} {n,} {n,m}   repeats
+
+typedef unsigned int (*bregex_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+
+struct bregex;
+
+struct bregex *bregex_compile(const char *pattern,const char **error);
+void bregex_free(struct bregex *re);
+void bregex_forget(struct bregex *re);
+int bregex_search(struct bregex *re,bregex_readfn readfn,file_position_t pos,file_position_t end,file_position_t *start,file_position_t *stop);
+int bregex_matchat(struct bregex *re,bregex_readfn readfn,file_position_t pos,file_position_t end);
+
+#endif
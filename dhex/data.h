@@ -1,3 +1,20 @@
 #define MAJOR_VERSION 0
 #define MINOR_VERSION 5
 #define REVISION 5
+#include <sys/types.h>        // uint64_t
+#ifdef FREEBSD
+	#define file_position_t uint64_t
+#endif
+#ifdef LINUX
+	#include <stdint.h>
+	#define file_position_t uint64_t
+#endif
+#ifdef IRIX
+        #define file_position_t fpos_t
+#endif
+#ifdef SOLARIS
+	#define file_position_t fpos64_t
+#endif
+#ifdef HPUX
+	#define file_position_t fpos64_t
+#endif
@@ -0,0 +1,410 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bfile.h"
+#include "edit.h"
+#include "digest.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DIGEST_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// CRC32 (zip), CRC32C, SHA-1 and SHA-256 of a range in one pass. on x86
+// the CRCs use PCLMULQDQ folding and the crc32 instruction, the SHAs the
+// SHA extensions, if the cpu has them. everything else is plain C.
+
+#define DIGEST_CHUNK 1048576
+
+static uint32_t crc32table[256];
+static uint32_t crc32ctable[256];
+static int hascrc=0;		// sse4.2 crc32 instruction
+static int hasclmul=0;		// pclmulqdq and sse4.1
+static int hassha=0;		// sha extensions and ssse3
+static int initialized=0;
+
+static const uint32_t sha256k[64]={
+	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+	0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+	0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+	0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+	0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+	0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+};
+
+static void digest_setup()
+{
+	uint32_t c;
+	unsigned int i;
+	unsigned int j;
+#ifdef DIGEST_X86
+	unsigned int a,b,cx,d;
+#endif
+	if (initialized) return;
+	for (i=0;i<256;i++)
+	{
+		c=i;
+		for (j=0;j<8;j++) c=(c&1)?(c>>1)^0xedb88320:c>>1;
+		crc32table[i]=c;
+		c=i;
+		for (j=0;j<8;j++) c=(c&1)?(c>>1)^0x82f63b78:c>>1;
+		crc32ctable[i]=c;
+	}
+#ifdef DIGEST_X86
+	if (__get_cpuid(1,&a,&b,&cx,&d))
+	{
+		hascrc=(cx>>20)&1;
+		hasclmul=((cx>>1)&1) && ((cx>>19)&1);
+		if (((cx>>9)&1) && __get_cpuid_count(7,0,&a,&b,&cx,&d)) hassha=(b>>29)&1;
+	}
+#endif
+	initialized=1;
+}
+
+static uint32_t crc32_table(uint32_t crc,const unsigned char *buf,unsigned int len,const uint32_t *table)
+{
+	while (len--) crc=table[(crc^*buf++)&0xff]^(crc>>8);
+	return crc;
+}
+
+#ifdef DIGEST_X86
+// folding with carry-less multiplication, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction" (Intel). len>=64, a multiple of 16.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_clmul(uint32_t crc,const unsigned char *buf,unsigned int len)
+{
+	const __m128i k1k2=_mm_set_epi64x(0x01c6e41596LL,0x0154442bd4LL);
+	const __m128i k3k4=_mm_set_epi64x(0x00ccaa009eLL,0x01751997d0LL);
+	const __m128i k5k0=_mm_set_epi64x(0,0x0163cd6124LL);
+	const __m128i poly=_mm_set_epi64x(0x01f7011641LL,0x01db710641LL);
+	const __m128i mask32=_mm_setr_epi32(~0,0,~0,0);
+	__m128i x1,x2,x3,x4,x5,x6,x7,x8;
+	x1=_mm_xor_si128(_mm_loadu_si128((const __m128i *)buf),_mm_cvtsi32_si128(crc));
+	x2=_mm_loadu_si128((const __m128i *)(buf+16));
+	x3=_mm_loadu_si128((const __m128i *)(buf+32));
+	x4=_mm_loadu_si128((const __m128i *)(buf+48));
+	buf+=64;
+	len-=64;
+	// four lanes in parallel
+	while (len>=64)
+	{
+		x5=_mm_clmulepi64_si128(x1,k1k2,0x00);
+		x6=_mm_clmulepi64_si128(x2,k1k2,0x00);
+		x7=_mm_clmulepi64_si128(x3,k1k2,0x00);
+		x8=_mm_clmulepi64_si128(x4,k1k2,0x00);
+		x1=_mm_clmulepi64_si128(x1,k1k2,0x11);
+		x2=_mm_clmulepi64_si128(x2,k1k2,0x11);
+		x3=_mm_clmulepi64_si128(x3,k1k2,0x11);
+		x4=_mm_clmulepi64_si128(x4,k1k2,0x11);
+		x1=_mm_xor_si128(_mm_xor_si128(x1,x5),_mm_loadu_si128((const __m128i *)buf));
+		x2=_mm_xor_si128(_mm_xor_si128(x2,x6),_mm_loadu_si128((const __m128i *)(buf+16)));
+		x3=_mm_xor_si128(_mm_xor_si128(x3,x7),_mm_loadu_si128((const __m128i *)(buf+32)));
+		x4=_mm_xor_si128(_mm_xor_si128(x4,x8),_mm_loadu_si128((const __m128i *)(buf+48)));
+		buf+=64;
+		len-=64;
+	}
+	// down to one lane
+	x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+	x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x2),x5);
+	x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+	x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x3),x5);
+	x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+	x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x4),x5);
+	while (len>=16)
+	{
+		x5=_mm_clmulepi64_si128(x1,k3k4,0x00);
+		x1=_mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),_mm_loadu_si128((const __m128i *)buf)),x5);
+		buf+=16;
+		len-=16;
+	}
+	// 128 -> 64 bits
+	x2=_mm_clmulepi64_si128(x1,k3k4,0x10);
+	x1=_mm_xor_si128(_mm_srli_si128(x1,8),x2);
+	x2=_mm_srli_si128(x1,4);
+	x1=_mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1,mask32),k5k0,0x00),x2);
+	// barrett reduction to 32 bits
+	x2=_mm_clmulepi64_si128(_mm_and_si128(x1,mask32),poly,0x10);
+	x2=_mm_clmulepi64_si128(_mm_and_si128(x2,mask32),poly,0x00);
+	x1=_mm_xor_si128(x1,x2);
+	return _mm_extract_epi32(x1,1);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc,const unsigned char *buf,unsigned int len)
+{
+	uint64_t c=crc;
+	uint64_t v;
+	while (len>=8)
+	{
+		memcpy(&v,buf,8);
+		c=_mm_crc32_u64(c,v);
+		buf+=8;
+		len-=8;
+	}
+	crc=c;
+	while (len--) crc=_mm_crc32_u8(crc,*buf++);
+	return crc;
+}
+
+__attribute__((target("sha,ssse3,sse4.1")))
+static void sha1_hw(uint32_t *state,const unsigned char *buf,unsigned int blocks)
+{
+	const __m128i bswap=_mm_set_epi64x(0x0001020304050607LL,0x08090a0b0c0d0e0fLL);
+	__m128i abcd,abcdsave,e0,esave,e,prev;
+	__m128i m[4];
+	unsigned int g;
+	abcd=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),0x1b);
+	e0=_mm_set_epi32(state[4],0,0,0);
+	while (blocks--)
+	{
+		abcdsave=abcd;
+		esave=e0;
+		prev=abcd;
+		for (g=0;g<20;g++)
+		{
+			// w[4g..4g+3]
+			if (g<4) m[g]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf+16*g)),bswap);
+			else m[g&3]=_mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m[g&3],m[(g+1)&3]),m[(g+2)&3]),m[(g+3)&3]);
+			if (g==0) e=_mm_add_epi32(e0,m[0]); else e=_mm_sha1nexte_epu32(prev,m[g&3]);
+			prev=abcd;
+			switch (g/5)
+			{
+				case 0: abcd=_mm_sha1rnds4_epu32(abcd,e,0); break;
+				case 1: abcd=_mm_sha1rnds4_epu32(abcd,e,1); break;
+				case 2: abcd=_mm_sha1rnds4_epu32(abcd,e,2); break;
+				default: abcd=_mm_sha1rnds4_epu32(abcd,e,3); break;
+			}
+		}
+		e0=_mm_sha1nexte_epu32(prev,esave);
+		abcd=_mm_add_epi32(abcd,abcdsave);
+		buf+=64;
+	}
+	_mm_storeu_si128((__m128i *)state,_mm_shuffle_epi32(abcd,0x1b));
+	state[4]=_mm_extract_epi32(e0,3);
+}
+
+__attribute__((target("sha,ssse3,sse4.1")))
+static void sha256_hw(uint32_t *state,const unsigned char *buf,unsigned int blocks)
+{
+	const __m128i bswap=_mm_set_epi64x(0x0c0d0e0f08090a0bLL,0x0405060700010203LL);
+	__m128i s0,s1,tmp,save0,save1,msg;
+	__m128i m[4];
+	unsigned int g;
+	tmp=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),0xb1);	// cdab
+	s1=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state+4)),0x1b);	// efgh
+	s0=_mm_alignr_epi8(tmp,s1,8);						// abef
+	s1=_mm_blend_epi16(s1,tmp,0xf0);					// cdgh
+	while (blocks--)
+	{
+		save0=s0;
+		save1=s1;
+		for (g=0;g<16;g++)
+		{
+			if (g<4) m[g]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf+16*g)),bswap);
+			else m[g&3]=_mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m[g&3],m[(g+1)&3]),_mm_alignr_epi8(m[(g+3)&3],m[(g+2)&3],4)),m[(g+3)&3]);
+			msg=_mm_add_epi32(m[g&3],_mm_loadu_si128((const __m128i *)(sha256k+4*g)));
+			s1=_mm_sha256rnds2_epu32(s1,s0,msg);
+			s0=_mm_sha256rnds2_epu32(s0,s1,_mm_shuffle_epi32(msg,0x0e));
+		}
+		s0=_mm_add_epi32(s0,save0);
+		s1=_mm_add_epi32(s1,save1);
+		buf+=64;
+	}
+	tmp=_mm_shuffle_epi32(s0,0x1b);						// feba
+	s1=_mm_shuffle_epi32(s1,0xb1);						// dchg
+	_mm_storeu_si128((__m128i *)state,_mm_blend_epi16(tmp,s1,0xf0));	// dcba
+	_mm_storeu_si128((__m128i *)(state+4),_mm_alignr_epi8(s1,tmp,8));	// hgfe
+}
+#endif
+
+#define ROL(x,n) (((x)<<(n))|((x)>>(32-(n))))
+#define ROR(x,n) (((x)>>(n))|((x)<<(32-(n))))
+
+static uint32_t be32(const unsigned char *p)
+{
+	return ((uint32_t)p[0]<<24)|((uint32_t)p[1]<<16)|((uint32_t)p[2]<<8)|p[3];
+}
+
+static void sha1_c(uint32_t *state,const unsigned char *buf,unsigned int blocks)
+{
+	uint32_t w[80];
+	uint32_t a,b,c,d,e,f,t;
+	unsigned int i;
+	while (blocks--)
+	{
+		for (i=0;i<16;i++) w[i]=be32(buf+4*i);
+		for (i=16;i<80;i++) w[i]=ROL(w[i-3]^w[i-8]^w[i-14]^w[i-16],1);
+		a=state[0]; b=state[1]; c=state[2]; d=state[3]; e=state[4];
+		for (i=0;i<80;i++)
+		{
+			if (i<20) f=((b&c)|(~b&d))+0x5a827999;
+			else if (i<40) f=(b^c^d)+0x6ed9eba1;
+			else if (i<60) f=((b&c)|(b&d)|(c&d))+0x8f1bbcdc;
+			else f=(b^c^d)+0xca62c1d6;
+			t=ROL(a,5)+f+e+w[i];
+			e=d; d=c; c=ROL(b,30); b=a; a=t;
+		}
+		state[0]+=a; state[1]+=b; state[2]+=c; state[3]+=d; state[4]+=e;
+		buf+=64;
+	}
+}
+
+static void sha256_c(uint32_t *state,const unsigned char *buf,unsigned int blocks)
+{
+	uint32_t w[64];
+	uint32_t v[8];
+	uint32_t t1,t2;
+	unsigned int i;
+	while (blocks--)
+	{
+		for (i=0;i<16;i++) w[i]=be32(buf+4*i);
+		for (i=16;i<64;i++) w[i]=(ROR(w[i-2],17)^ROR(w[i-2],19)^(w[i-2]>>10))+w[i-7]+(ROR(w[i-15],7)^ROR(w[i-15],18)^(w[i-15]>>3))+w[i-16];
+		for (i=0;i<8;i++) v[i]=state[i];
+		for (i=0;i<64;i++)
+		{
+			t1=v[7]+(ROR(v[4],6)^ROR(v[4],11)^ROR(v[4],25))+((v[4]&v[5])^(~v[4]&v[6]))+sha256k[i]+w[i];
+			t2=(ROR(v[0],2)^ROR(v[0],13)^ROR(v[0],22))+((v[0]&v[1])^(v[0]&v[2])^(v[1]&v[2]));
+			v[7]=v[6]; v[6]=v[5]; v[5]=v[4]; v[4]=v[3]+t1;
+			v[3]=v[2]; v[2]=v[1]; v[1]=v[0]; v[0]=t1+t2;
+		}
+		for (i=0;i<8;i++) state[i]+=v[i];
+		buf+=64;
+	}
+}
+
+static void digest_blocks(struct digest *d,const unsigned char *buf,unsigned int blocks)
+{
+#ifdef DIGEST_X86
+	if (hassha)
+	{
+		sha1_hw(d->sha1,buf,blocks);
+		sha256_hw(d->sha256,buf,blocks);
+		return;
+	}
+#endif
+	sha1_c(d->sha1,buf,blocks);
+	sha256_c(d->sha256,buf,blocks);
+}
+
+void digest_init(struct digest *d)
+{
+	static const uint32_t sha1init[5]={0x67452301,0xefcdab89,0x98badcfe,0x10325476,0xc3d2e1f0};
+	static const uint32_t sha256init[8]={0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19};
+	digest_setup();
+	memset(d,0,sizeof(struct digest));
+	d->crc32=0xffffffff;
+	d->crc32c=0xffffffff;
+	memcpy(d->sha1,sha1init,sizeof(sha1init));
+	memcpy(d->sha256,sha256init,sizeof(sha256init));
+}
+
+void digest_update(struct digest *d,const unsigned char *buf,unsigned int len)
+{
+	unsigned int n;
+	unsigned int fold=0;
+#ifdef DIGEST_X86
+	if (hasclmul && len>=64)
+	{
+		fold=len&~15;
+		d->crc32=crc32_clmul(d->crc32,buf,fold);
+	}
+	if (hascrc) d->crc32c=crc32c_hw(d->crc32c,buf,len);
+	else
+#endif
+	d->crc32c=crc32_table(d->crc32c,buf,len,crc32ctable);
+	d->crc32=crc32_table(d->crc32,buf+fold,len-fold,crc32table);
+	d->total+=len;
+	if (d->blocklen)
+	{
+		n=64-d->blocklen;
+		if (n>len) n=len;
+		memcpy(d->block+d->blocklen,buf,n);
+		d->blocklen+=n;
+		buf+=n;
+		len-=n;
+		if (d->blocklen<64) return;
+		digest_blocks(d,d->block,1);
+		d->blocklen=0;
+	}
+	if (len>=64) digest_blocks(d,buf,len/64);
+	buf+=len&~63;
+	len&=63;
+	memcpy(d->block,buf,len);
+	d->blocklen=len;
+}
+
+// sha1 and sha256 get the padding, the crcs get their final xor
+void digest_final(struct digest *d,unsigned char *sha1,unsigned char *sha256)
+{
+	uint64_t bits=d->total*8;
+	unsigned int i;
+	d->block[d->blocklen++]=0x80;
+	if (d->blocklen>56)
+	{
+		memset(d->block+d->blocklen,0,64-d->blocklen);
+		digest_blocks(d,d->block,1);
+		d->blocklen=0;
+	}
+	memset(d->block+d->blocklen,0,56-d->blocklen);
+	for (i=0;i<8;i++) d->block[56+i]=bits>>(56-8*i);
+	digest_blocks(d,d->block,1);
+	d->blocklen=0;
+	for (i=0;i<20;i++) sha1[i]=d->sha1[i/4]>>(24-8*(i%4));
+	for (i=0;i<32;i++) sha256[i]=d->sha256[i/4]>>(24-8*(i%4));
+	d->crc32^=0xffffffff;
+	d->crc32c^=0xffffffff;
+}
+
+static void *digest_thread(void *arg)
+{
+	struct digestjob *job=arg;
+	unsigned char *buf;
+	file_position_t pos;
+	unsigned int len;
+	buf=malloc(DIGEST_CHUNK);
+	for (pos=job->start;pos<job->end && !job->cancel;pos+=len)
+	{
+		len=(job->end-pos<DIGEST_CHUNK)?job->end-pos:DIGEST_CHUNK;
+		len=edit_read(job->bf,pos,buf,len);
+		if (len==0) break;
+		digest_update(&job->d,buf,len);
+		job->done=pos+len;
+	}
+	digest_final(&job->d,job->sha1,job->sha256);
+	free(buf);
+	job->running=0;
+	return NULL;
+}
+
+// hashes [start,end) of bf including the unsaved changes, read through
+// edit_read(). no edit_* call that changes them may come until the job is
+// finished or stopped.
+int digest_start(struct digestjob *job,struct bfile *bf,file_position_t start,file_position_t end)
+{
+	memset(job,0,sizeof(struct digestjob));
+	job->bf=bfile_dup(bf);
+	if (job->bf==NULL) return 0;
+	job->start=start;
+	job->end=end;
+	job->done=start;
+	digest_init(&job->d);
+	job->running=1;
+	if (pthread_create(&job->thread,NULL,digest_thread,job)!=0)
+	{
+		bfile_close(job->bf);
+		memset(job,0,sizeof(struct digestjob));
+		return 0;
+	}
+	return 1;
+}
+
+void digest_stop(struct digestjob *job)
+{
+	if (job->bf==NULL) return;
+	job->cancel=1;
+	pthread_join(job->thread,NULL);
+	bfile_close(job->bf);
+	job->bf=NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+#include <pthread.h>
+#include "data.h"
+
+struct bfile;
+
+struct digest
+{
+	uint32_t crc32;
+	uint32_t crc32c;
+	uint32_t sha1[5];
+	uint32_t sha256[8];
+	unsigned char block[64];	// sha input that did not fill a block yet
+	unsigned int blocklen;
+	uint64_t total;
+};
+
+struct digestjob
+{
+	struct bfile *bf;
+	file_position_t start;
+	file_position_t end;
+	pthread_t thread;
+	volatile int running;
+	volatile int cancel;
+	volatile file_position_t done;	// hashed up to here
+	struct digest d;
+	// valid once running is 0 and done==end
+	unsigned char sha1[20];
+	unsigned char sha256[32];
+};
+
+void digest_init(struct digest *d);
+void digest_update(struct digest *d,const unsigned char *buf,unsigned int len);
+void digest_final(struct digest *d,unsigned char *sha1,unsigned char *sha256);
+
+int digest_start(struct digestjob *job,struct bfile *bf,file_position_t start,file_position_t end);
+void digest_stop(struct digestjob *job);
+
+#endif
@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bfile.h"
+#include "dotplot.h"
+
+// the thread goes through A, then through B, one DOTPLOT_CHUNK at a time.
+// boundaries come from a gear hash: it only looks at the last 64 bytes,
+// so the same content gets cut the same way wherever it is.
+
+#define DOTPLOT_CHUNK 1048576
+#define DOTPLOT_AVG 4096
+#define DOTPLOT_FNV 0x100000001b3ULL
+#define DOTPLOT_SEED 0xcbf29ce484222325ULL
+
+static uint64_t gear[256];
+
+static void dotplot_gear(void)
+{
+	uint64_t x=0x9e3779b97f4a7c15ULL;
+	uint64_t z;
+	unsigned int i;
+	for (i=0;i<256;i++)
+	{
+		// splitmix64
+		x+=0x9e3779b97f4a7c15ULL;
+		z=x;
+		z=(z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+		z=(z^(z>>27))*0x94d049bb133111ebULL;
+		gear[i]=z^(z>>31);
+	}
+}
+
+struct dotcut
+{
+	file_position_t start;		// of the chunk being cut
+	unsigned int len;
+	uint64_t g;			// gear hash, for the boundary
+	uint64_t h;			// FNV-1a of the chunk, what is looked up
+	unsigned char first;
+	int uniform;
+};
+
+static void dotplot_insert(struct dotplot *dp,uint64_t h,file_position_t pos)
+{
+	unsigned int i;
+	h|=1;				// 0 is an empty slot
+	for (i=h&(dp->slots-1);dp->key[i]!=0;i=(i+1)&(dp->slots-1)) if (dp->key[i]==h) return;	// the first copy is enough
+	dp->key[i]=h;
+	dp->val[i]=pos;
+	dp->used++;
+}
+
+static int dotplot_lookup(struct dotplot *dp,uint64_t h,file_position_t *pos)
+{
+	unsigned int i;
+	h|=1;
+	for (i=h&(dp->slots-1);dp->key[i]!=0;i=(i+1)&(dp->slots-1))
+	{
+		if (dp->key[i]==h)
+		{
+			*pos=dp->val[i];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void dotplot_match(struct dotplot *dp,file_position_t a,file_position_t b,unsigned int len)
+{
+	struct dotseg *s;
+	pthread_mutex_lock(&dp->lock);
+	s=dp->num?&dp->seg[dp->num-1]:NULL;
+	if (s!=NULL && s->a+s->len==a && s->b+s->len==b) s->len+=len;
+	else if (dp->num==DOTPLOT_MAXSEGS) dp->truncated=1;
+	else
+	{
+		if (dp->num==dp->max)
+		{
+			dp->max=dp->max?dp->max*2:4096;
+			dp->seg=realloc(dp->seg,dp->max*sizeof(struct dotseg));
+		}
+		s=&dp->seg[dp->num++];
+		s->a=a;
+		s->b=b;
+		s->len=len;
+	}
+	pthread_mutex_unlock(&dp->lock);
+}
+
+// a chunk is done. runs of one byte (erased flash, zeros) match everywhere
+// and would only paint the plot full, they are left out.
+static void dotplot_chunk(struct dotplot *dp,struct dotcut *c,int inb)
+{
+	file_position_t a;
+	if (c->len>0 && !c->uniform)
+	{
+		if (!inb)
+		{
+			if (dp->used<dp->slots/2) dotplot_insert(dp,c->h,c->start);
+		}
+		else if (dotplot_lookup(dp,c->h,&a)) dotplot_match(dp,a,c->start,c->len);
+	}
+	c->start+=c->len;
+	c->len=0;
+	c->g=0;
+	c->h=DOTPLOT_SEED;
+	c->uniform=1;
+}
+
+static void dotplot_cut(struct dotplot *dp,struct dotcut *c,const unsigned char *buf,unsigned int n,int inb)
+{
+	unsigned int i;
+	unsigned int min;
+	unsigned int max;
+	unsigned int bits=0;
+	min=dp->avg/4;
+	max=dp->avg*4;
+	while ((1U<<bits)<dp->avg) bits++;
+	for (i=0;i<n;i++)
+	{
+		if (c->len==0) c->first=buf[i];
+		if (buf[i]!=c->first) c->uniform=0;
+		c->g=(c->g<<1)+gear[buf[i]];
+		c->h=(c->h^buf[i])*DOTPLOT_FNV;
+		c->len++;
+		if (dp->blocksize)
+		{
+			if (c->len==dp->blocksize) dotplot_chunk(dp,c,inb);
+		}
+		else if ((c->len>=min && (c->g>>(64-bits))==0) || c->len>=max) dotplot_chunk(dp,c,inb);	// the top bits see the last 64 bytes
+	}
+}
+
+static void dotplot_file(struct dotplot *dp,struct bfile *bf,file_position_t size,file_position_t base,unsigned char *buf,int inb)
+{
+	struct dotcut c;
+	file_position_t pos;
+	unsigned int n;
+	memset(&c,0,sizeof(c));
+	c.h=DOTPLOT_SEED;
+	c.uniform=1;
+	for (pos=0;pos<size && !dp->cancel;pos+=n)
+	{
+		n=bfile_read(bf,pos,buf,(size-pos<DOTPLOT_CHUNK)?size-pos:DOTPLOT_CHUNK);
+		if (n==0) break;
+		dotplot_cut(dp,&c,buf,n,inb);
+		dp->done=base+pos+n;
+	}
+	dotplot_chunk(dp,&c,inb);
+}
+
+static void *dotplot_thread(void *arg)
+{
+	struct dotplot *dp=arg;
+	unsigned char *buf;
+	buf=malloc(DOTPLOT_CHUNK);
+	dotplot_file(dp,dp->bfa,dp->sizea,0,buf,0);
+	dotplot_file(dp,dp->bfb,dp->sizeb,dp->sizea,buf,1);
+	free(buf);
+	free(dp->key);
+	free(dp->val);
+	dp->key=NULL;
+	dp->val=NULL;
+	dp->done=dp->sizea+dp->sizeb;
+	dp->running=0;
+	return NULL;
+}
+
+int dotplot_start(struct dotplot *dp,struct bfile *a,struct bfile *b,unsigned int blocksize)
+{
+	file_position_t chunks;
+	dotplot_stop(dp);
+	memset(dp,0,sizeof(struct dotplot));
+	if (gear[0]==0) dotplot_gear();
+	dp->sizea=bfile_size(a);
+	dp->sizeb=bfile_size(b);
+	dp->blocksize=blocksize;
+	// bigger chunks when A is too big for the table
+	dp->avg=DOTPLOT_AVG;
+	while (dp->sizea/dp->avg>DOTPLOT_MAXCHUNKS) dp->avg*=2;
+	if (blocksize) while (dp->sizea/dp->blocksize>DOTPLOT_MAXCHUNKS) dp->blocksize*=2;
+	chunks=blocksize?dp->sizea/dp->blocksize+1:dp->sizea/(dp->avg/4)+1;
+	if (chunks>DOTPLOT_MAXCHUNKS) chunks=DOTPLOT_MAXCHUNKS;
+	for (dp->slots=1024;dp->slots<2*chunks;dp->slots*=2);
+	dp->key=calloc(dp->slots,sizeof(uint64_t));
+	dp->val=malloc(dp->slots*sizeof(file_position_t));
+	dp->bfa=bfile_dup(a);
+	dp->bfb=bfile_dup(b);
+	if (dp->key==NULL || dp->val==NULL || dp->bfa==NULL || dp->bfb==NULL)
+	{
+		free(dp->key);
+		free(dp->val);
+		bfile_close(dp->bfa);
+		bfile_close(dp->bfb);
+		memset(dp,0,sizeof(struct dotplot));
+		return 0;
+	}
+	pthread_mutex_init(&dp->lock,NULL);
+	dp->running=1;
+	if (pthread_create(&dp->thread,NULL,dotplot_thread,dp)!=0)
+	{
+		pthread_mutex_destroy(&dp->lock);
+		free(dp->key);
+		free(dp->val);
+		bfile_close(dp->bfa);
+		bfile_close(dp->bfb);
+		memset(dp,0,sizeof(struct dotplot));
+		return 0;
+	}
+	return 1;
+}
+
+void dotplot_stop(struct dotplot *dp)
+{
+	if (dp->bfa==NULL) return;
+	dp->cancel=1;
+	pthread_join(dp->thread,NULL);
+	pthread_mutex_destroy(&dp->lock);
+	bfile_close(dp->bfa);
+	bfile_close(dp->bfb);
+	free(dp->seg);
+	memset(dp,0,sizeof(struct dotplot));
+}
+
+// how many matching bytes fall into each cell of a rows x cols grid over
+// [a0,a1) x [b0,b1). the segments are clipped to the view and walked in
+// steps of one cell, so zooming costs nothing but this.
+void dotplot_render(struct dotplot *dp,file_position_t a0,file_position_t a1,file_position_t b0,file_position_t b1,unsigned int rows,unsigned int cols,file_position_t *cell)
+{
+	struct dotseg *s;
+	file_position_t ca;
+	file_position_t cb;
+	file_position_t t0;
+	file_position_t t1;
+	file_position_t t;
+	file_position_t step;
+	file_position_t n;
+	unsigned int i;
+	memset(cell,0,rows*cols*sizeof(file_position_t));
+	if (a1<=a0 || b1<=b0 || rows==0 || cols==0) return;
+	ca=(a1-a0+rows-1)/rows;
+	cb=(b1-b0+cols-1)/cols;
+	pthread_mutex_lock(&dp->lock);
+	for (i=0;i<dp->num;i++)
+	{
+		s=&dp->seg[i];
+		// the part of the diagonal that is in view
+		t0=0;
+		t1=s->len;
+		if (s->a+t1<=a0 || s->b+t1<=b0 || s->a>=a1 || s->b>=b1) continue;
+		if (s->a<a0 && a0-s->a>t0) t0=a0-s->a;
+		if (s->b<b0 && b0-s->b>t0) t0=b0-s->b;
+		if (s->a+t1>a1) t1=a1-s->a;
+		if (s->b+t1>b1) t1=b1-s->b;
+		for (t=t0;t<t1;t+=step)
+		{
+			// to the next cell border in either direction
+			step=ca-(s->a+t-a0)%ca;
+			n=cb-(s->b+t-b0)%cb;
+			if (n<step) step=n;
+			if (t+step>t1) step=t1-t;
+			cell[((s->a+t-a0)/ca)*cols+(s->b+t-b0)/cb]+=step;
+		}
+	}
+	pthread_mutex_unlock(&dp->lock);
+}
@@ -0,0 +1,53 @@
+#ifndef DOTPLOT_H
+#define DOTPLOT_H
+#include <pthread.h>
+#include "data.h"
+
+// where the blocks of file A show up again in file B. A is cut into chunks,
+// either at content defined boundaries (so an insertion does not shift all
+// the following blocks) or every blocksize bytes. their hashes go into a
+// table, then B is cut the same way and looked up. matches that continue
+// each other are kept as one diagonal segment.
+
+#define DOTPLOT_MAXCHUNKS 1048576	// chunks of A in the table, bounds the memory
+#define DOTPLOT_MAXSEGS 1048576
+
+struct bfile;
+
+struct dotseg
+{
+	file_position_t a;
+	file_position_t b;
+	file_position_t len;
+};
+
+struct dotplot
+{
+	struct bfile *bfa;
+	struct bfile *bfb;
+	file_position_t sizea;
+	file_position_t sizeb;
+	unsigned int blocksize;		// 0: content defined
+	unsigned int avg;		// the chunk size that is aimed at
+	pthread_t thread;
+	pthread_mutex_t lock;
+	volatile int running;
+	volatile int cancel;
+	volatile file_position_t done;	// of sizea+sizeb
+	volatile int truncated;		// more segments than DOTPLOT_MAXSEGS
+	// the thread's, until it is done with A
+	uint64_t *key;
+	file_position_t *val;
+	unsigned int slots;
+	unsigned int used;
+	// protected by lock
+	struct dotseg *seg;
+	unsigned int num;
+	unsigned int max;
+};
+
+int dotplot_start(struct dotplot *dp,struct bfile *a,struct bfile *b,unsigned int blocksize);
+void dotplot_stop(struct dotplot *dp);
+void dotplot_render(struct dotplot *dp,file_position_t a0,file_position_t a1,file_position_t b0,file_position_t b1,unsigned int rows,unsigned int cols,file_position_t *cell);
+
+#endif
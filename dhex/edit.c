@@ -0,0 +1,671 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bfile.h"
+#include "edit.h"
+
+// the unsaved changes. the edited file is a sequence of pieces (a range of
+// the input file, typed bytes, or a repeated pattern) kept in an implicit
+// treap, ordered by position. every change splits and merges the treap and
+// builds new nodes only along the paths it touches, the old root stays
+// valid. so a change costs O(log n) no matter how many bytes it covers, the
+// undo journal is just the list of old roots, and a copied range is a
+// subtree that can be pasted anywhere.
+
+#define EDIT_FILE 0		// bytes of the input file
+#define EDIT_ADD 1		// bytes that were typed in
+#define EDIT_FILL 2		// a pattern over and over
+
+#define EDIT_CHUNK 1048576
+#define EDIT_NODES 4096
+
+struct piece
+{
+	int type;
+	file_position_t src;	// FILE: file offset, ADD: offset in addbuf, FILL: pattern phase
+	file_position_t len;
+	unsigned int pat;	// FILL: the pattern is in addbuf
+	unsigned int patlen;
+};
+
+struct enode
+{
+	struct piece pc;
+	file_position_t total;	// bytes in this subtree
+	unsigned int prio;
+	struct enode *l;
+	struct enode *r;
+};
+
+struct undo
+{
+	struct enode *root;
+	file_position_t where;
+};
+
+static struct enode *root=NULL;
+static struct enode *clip=NULL;
+static struct enode *nodes=NULL;	// nodes are never freed, old roots point to them
+static unsigned int nodesleft=0;
+static unsigned char *addbuf=NULL;
+static unsigned int addlen=0;
+static unsigned int addmax=0;
+static struct undo *journal=NULL;
+static int journaled=0;
+static int journalmax=0;
+static unsigned int serial=0;		// bumped by everything edit_dump() would write differently
+static uint32_t seed=2463534242U;
+
+static file_position_t total(struct enode *t)
+{
+	return t?t->total:0;
+}
+
+static struct enode *enew(const struct piece *pc,unsigned int prio,struct enode *l,struct enode *r)
+{
+	struct enode *n;
+	if (nodesleft==0)
+	{
+		nodes=malloc(EDIT_NODES*sizeof(struct enode));
+		nodesleft=EDIT_NODES;
+	}
+	n=nodes++;
+	nodesleft--;
+	n->pc=*pc;
+	n->prio=prio;
+	n->l=l;
+	n->r=r;
+	n->total=pc->len+total(l)+total(r);
+	return n;
+}
+
+static unsigned int randprio()
+{
+	seed^=seed<<13;
+	seed^=seed>>17;
+	seed^=seed<<5;
+	return seed;
+}
+
+// *a gets the first k bytes of t, *b the rest
+static void split(struct enode *t,file_position_t k,struct enode **a,struct enode **b)
+{
+	struct enode *x;
+	struct piece left;
+	struct piece right;
+	file_position_t lt;
+	if (t==NULL || k==0)
+	{
+		*a=NULL;
+		*b=t;
+		return;
+	}
+	if (k>=t->total)
+	{
+		*a=t;
+		*b=NULL;
+		return;
+	}
+	lt=total(t->l);
+	if (k<=lt)
+	{
+		split(t->l,k,a,&x);
+		*b=enew(&t->pc,t->prio,x,t->r);
+	} else if (k>=lt+t->pc.len) {
+		split(t->r,k-lt-t->pc.len,&x,b);
+		*a=enew(&t->pc,t->prio,t->l,x);
+	} else {
+		left=t->pc;
+		left.len=k-lt;
+		right=t->pc;
+		right.src+=k-lt;
+		right.len-=k-lt;
+		*a=enew(&left,t->prio,t->l,NULL);
+		*b=enew(&right,t->prio,NULL,t->r);
+	}
+}
+
+static struct enode *merge(struct enode *a,struct enode *b)
+{
+	if (a==NULL) return b;
+	if (b==NULL) return a;
+	if (a->prio>b->prio) return enew(&a->pc,a->prio,a->l,merge(a->r,b));
+	return enew(&b->pc,b->prio,merge(a,b->l),b->r);
+}
+
+static void commit(struct enode *t,file_position_t where)
+{
+	if (journaled==journalmax)
+	{
+		journalmax=journalmax?journalmax*2:1024;
+		journal=realloc(journal,journalmax*sizeof(struct undo));
+	}
+	journal[journaled].root=root;
+	journal[journaled].where=where;
+	journaled++;
+	root=t;
+	serial++;
+}
+
+static unsigned int addbytes(const unsigned char *buf,unsigned int len)
+{
+	unsigned int o=addlen;
+	if (addlen+len>addmax)
+	{
+		addmax=addmax?addmax*2:65536;
+		while (addlen+len>addmax) addmax*=2;
+		addbuf=realloc(addbuf,addmax);
+	}
+	memcpy(addbuf+addlen,buf,len);
+	addlen+=len;
+	return o;
+}
+
+// [pos,pos+len) is replaced by t, the file grows if it runs past the end
+static void replace(file_position_t pos,file_position_t len,struct enode *t)
+{
+	struct enode *a;
+	struct enode *b;
+	struct enode *c;
+	struct enode *x;
+	split(root,pos,&a,&b);
+	split(b,len,&x,&c);
+	commit(merge(merge(a,t),c),pos);
+}
+
+static struct enode *fillnode(file_position_t len,const unsigned char *pat,unsigned int patlen)
+{
+	struct piece pc;
+	pc.type=EDIT_FILL;
+	pc.src=0;
+	pc.len=len;
+	pc.patlen=patlen;
+	pc.pat=addbytes(pat,patlen);
+	return enew(&pc,randprio(),NULL,NULL);
+}
+
+void edit_open(struct bfile *bf)
+{
+	struct piece pc;
+	root=NULL;
+	journaled=0;
+	serial++;
+	if (bfile_size(bf)==0) return;
+	pc.type=EDIT_FILE;
+	pc.src=0;
+	pc.len=bfile_size(bf);
+	pc.pat=0;
+	pc.patlen=0;
+	root=enew(&pc,randprio(),NULL,NULL);
+}
+
+file_position_t edit_size()
+{
+	return total(root);
+}
+
+int edit_changed()
+{
+	return journaled;
+}
+
+unsigned int edit_serial()
+{
+	return serial;
+}
+
+static void readpiece(struct bfile *bf,const struct piece *pc,file_position_t off,unsigned char *buf,unsigned int len)
+{
+	unsigned int n;
+	unsigned int i;
+	if (pc->type==EDIT_FILE)
+	{
+		n=bfile_read(bf,pc->src+off,buf,len);
+		if (n<len) memset(buf+n,0,len-n);	// the file shrank behind our back
+	} else if (pc->type==EDIT_ADD) {
+		memcpy(buf,addbuf+pc->src+off,len);
+	} else {
+		i=(pc->src+off)%pc->patlen;
+		for (n=0;n<len;n++)
+		{
+			buf[n]=addbuf[pc->pat+i];
+			if (++i==pc->patlen) i=0;
+		}
+	}
+}
+
+// the part of [pos,end) that falls into subtree t, which begins at base
+static void readnode(struct bfile *bf,struct enode *t,file_position_t base,file_position_t pos,file_position_t end,unsigned char *buf)
+{
+	file_position_t s;
+	file_position_t e;
+	while (t!=NULL && base<end && base+t->total>pos)
+	{
+		s=base+total(t->l);
+		e=s+t->pc.len;
+		if (pos<s) readnode(bf,t->l,base,pos,end,buf);
+		if (s<end && e>pos)
+		{
+			if (s<pos) readpiece(bf,&t->pc,pos-s,buf,((e<end)?e:end)-pos);
+			else readpiece(bf,&t->pc,0,buf+(s-pos),((e<end)?e:end)-s);
+		}
+		t=t->r;
+		base=e;
+	}
+}
+
+// the file as it looks with the unsaved changes applied. bf can be a
+// bfile_dup() of the input file, so threads get their own cache.
+unsigned int edit_read(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	if (pos>=total(root)) return 0;
+	if (len>total(root)-pos) len=total(root)-pos;
+	readnode(bf,root,0,pos,pos+len,buf);
+	return len;
+}
+
+// like readnode(), but only notes where the pieces that are not file bytes go
+static void marknode(struct enode *t,file_position_t base,file_position_t pos,file_position_t end,unsigned char *map)
+{
+	file_position_t s;
+	file_position_t e;
+	while (t!=NULL && base<end && base+t->total>pos)
+	{
+		s=base+total(t->l);
+		e=s+t->pc.len;
+		if (pos<s) marknode(t->l,base,pos,end,map);
+		if (s<end && e>pos && t->pc.type!=EDIT_FILE)
+			memset(map+((s>pos)?s-pos:0),1,((e<end)?e:end)-((s>pos)?s:pos));
+		t=t->r;
+		base=e;
+	}
+}
+
+// map[i] is 1 where byte pos+i was typed or filled in, 0 where it is a byte
+// of the input file, wherever inserting or deleting has moved it to
+unsigned int edit_changes(file_position_t pos,unsigned char *map,unsigned int len)
+{
+	memset(map,0,len);
+	if (pos>=total(root)) return 0;
+	if (len>total(root)-pos) len=total(root)-pos;
+	marknode(root,0,pos,pos+len,map);
+	return len;
+}
+
+// where byte pos of the edited file is in the input file, 0 if it was
+// typed or filled in
+int edit_source(file_position_t pos,file_position_t *src)
+{
+	struct enode *t=root;
+	file_position_t s;
+	while (t!=NULL)
+	{
+		s=total(t->l);
+		if (pos<s) t=t->l;
+		else if (pos<s+t->pc.len)
+		{
+			if (t->pc.type!=EDIT_FILE) return 0;
+			*src=t->pc.src+(pos-s);
+			return 1;
+		}
+		else
+		{
+			pos-=s+t->pc.len;
+			t=t->r;
+		}
+	}
+	return 0;
+}
+
+// holes of a sparse input file, where they are still part of the edited file
+int edit_hole(struct bfile *bf,file_position_t pos,file_position_t *start,file_position_t *end)
+{
+	struct enode *t=root;
+	file_position_t base=0;
+	file_position_t s;
+	file_position_t hs;
+	file_position_t he;
+	while (t!=NULL)
+	{
+		s=base+total(t->l);
+		if (pos<s) t=t->l;
+		else if (pos>=s+t->pc.len)
+		{
+			base=s+t->pc.len;
+			t=t->r;
+		} else {
+			if (t->pc.type!=EDIT_FILE || !bfile_hole(bf,t->pc.src+(pos-s),&hs,&he)) return 0;
+			*start=s+((hs>t->pc.src)?hs-t->pc.src:0);
+			*end=s+((he-t->pc.src<t->pc.len)?he-t->pc.src:t->pc.len);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void edit_overwrite(file_position_t pos,const unsigned char *buf,unsigned int len)
+{
+	struct piece pc;
+	if (pos>total(root) || len==0) return;
+	pc.type=EDIT_ADD;
+	pc.src=addbytes(buf,len);
+	pc.len=len;
+	pc.pat=0;
+	pc.patlen=0;
+	replace(pos,len,enew(&pc,randprio(),NULL,NULL));
+}
+
+void edit_fill(file_position_t pos,file_position_t len,const unsigned char *pat,unsigned int patlen)
+{
+	if (pos>=total(root) || len==0 || patlen==0) return;
+	if (len>total(root)-pos) len=total(root)-pos;
+	replace(pos,len,fillnode(len,pat,patlen));
+}
+
+void edit_insert(file_position_t pos,file_position_t len,const unsigned char *pat,unsigned int patlen)
+{
+	if (pos>total(root) || len==0 || patlen==0) return;
+	replace(pos,0,fillnode(len,pat,patlen));
+}
+
+void edit_delete(file_position_t pos,file_position_t len)
+{
+	if (pos>=total(root) || len==0) return;
+	replace(pos,len,NULL);
+}
+
+// remembers [pos,pos+len) for edit_paste(), returns how much that is
+file_position_t edit_copy(file_position_t pos,file_position_t len)
+{
+	struct enode *a;
+	struct enode *b;
+	struct enode *c;
+	split(root,pos,&a,&b);
+	split(b,len,&clip,&c);
+	serial++;
+	return total(clip);
+}
+
+// overwrites what is at pos with the copied range
+file_position_t edit_paste(file_position_t pos)
+{
+	if (clip==NULL || pos>total(root)) return 0;
+	replace(pos,total(clip),clip);
+	return total(clip);
+}
+
+// what changed since edit_changed() said since is undone in one step
+void edit_squash(int since)
+{
+	if (journaled>since+1) journaled=since+1;
+	serial++;
+}
+
+int edit_undo(file_position_t *pos)
+{
+	if (journaled==0) return 0;
+	journaled--;
+	root=journal[journaled].root;
+	*pos=journal[journaled].where;
+	serial++;
+	return 1;
+}
+
+// is every piece of the input file still where it was?
+static int unmoved(struct enode *t,file_position_t base)
+{
+	file_position_t s;
+	while (t!=NULL)
+	{
+		s=base+total(t->l);
+		if (!unmoved(t->l,base)) return 0;
+		if (t->pc.type==EDIT_FILE && t->pc.src!=s) return 0;
+		base=s+t->pc.len;
+		t=t->r;
+	}
+	return 1;
+}
+
+// writes the typed and filled pieces over the file, the rest is left alone
+static int patch(struct bfile *bf,int fd,struct enode *t,file_position_t base,unsigned char *buf)
+{
+	file_position_t s;
+	file_position_t o;
+	unsigned int n;
+	while (t!=NULL)
+	{
+		s=base+total(t->l);
+		if (!patch(bf,fd,t->l,base,buf)) return 0;
+		for (o=0;t->pc.type!=EDIT_FILE && o<t->pc.len;o+=n)
+		{
+			n=(t->pc.len-o<EDIT_CHUNK)?t->pc.len-o:EDIT_CHUNK;
+			readpiece(bf,&t->pc,o,buf,n);
+			if (pwrite(fd,buf,n,s+o)!=(ssize_t)n) return 0;
+		}
+		base=s+t->pc.len;
+		t=t->r;
+	}
+	return 1;
+}
+
+// the file is only touched here. if nothing moved, the changed pieces are
+// written in place. otherwise the whole file is streamed into a temporary
+// file next to it, which then replaces it.
+int edit_save(struct bfile *bf,const char *filename)
+{
+	struct stat st;
+	unsigned char *buf;
+	char *tmp;
+	file_position_t pos;
+	unsigned int n;
+	int exists;
+	int fd;
+	int ok=1;
+	buf=malloc(EDIT_CHUNK);
+	exists=(stat(filename,&st)==0);
+	if (exists && bf->type==BFILE_PLAIN && strcmp(filename,bf->filename)==0 && total(root)==bfile_size(bf) && unmoved(root,0))
+	{
+		fd=open(filename,O_WRONLY);
+		if (fd<0) ok=0;
+		else
+		{
+			ok=patch(bf,fd,root,0,buf);
+			if (fsync(fd)!=0 && S_ISREG(st.st_mode)) ok=0;
+			if (close(fd)!=0) ok=0;
+		}
+		free(buf);
+		return ok;
+	}
+	if (exists && !S_ISREG(st.st_mode))
+	{
+		// a device can't be replaced, and patching it in place would
+		// overwrite data that is still to be copied
+		free(buf);
+		return 0;
+	}
+	tmp=malloc(strlen(filename)+8);
+	sprintf(tmp,"%s.XXXXXX",filename);
+	fd=mkstemp(tmp);
+	if (fd<0)
+	{
+		free(tmp);
+		free(buf);
+		return 0;
+	}
+	for (pos=0;ok && pos<total(root);pos+=n)
+	{
+		n=edit_read(bf,pos,buf,EDIT_CHUNK);
+		if (write(fd,buf,n)!=(ssize_t)n) ok=0;
+	}
+	if (exists) fchmod(fd,st.st_mode&07777);
+	else
+	{
+		n=umask(022);
+		umask(n);
+		fchmod(fd,0666&~n);
+	}
+	if (fsync(fd)!=0 || close(fd)!=0) ok=0;
+	if (ok && rename(tmp,filename)!=0) ok=0;
+	if (!ok) unlink(tmp);
+	free(tmp);
+	free(buf);
+	return ok;
+}
+
+// the changes and their undo history go into the session file. old roots
+// share most of their nodes, so every node is written once, after its
+// children, and refers to them by number (0 is none).
+
+struct enumber
+{
+	struct enode **key;
+	unsigned int *num;
+	unsigned int mask;
+	unsigned int used;
+};
+
+static unsigned int enumber_slot(struct enumber *en,struct enode *t)
+{
+	unsigned int i;
+	i=(unsigned int)(((uintptr_t)t>>4)*2654435761U)&en->mask;
+	while (en->key[i]!=NULL && en->key[i]!=t) i=(i+1)&en->mask;
+	return i;
+}
+
+static unsigned int edump(FILE *f,struct enumber *en,struct enode *t)
+{
+	struct enode **key;
+	unsigned int *num;
+	unsigned int i;
+	uint64_t rec[8];
+	if (t==NULL) return 0;
+	i=enumber_slot(en,t);
+	if (en->key[i]!=NULL) return en->num[i];
+	rec[6]=edump(f,en,t->l);
+	rec[7]=edump(f,en,t->r);
+	if (2*(en->used+1)>en->mask)
+	{
+		key=en->key;
+		num=en->num;
+		en->mask=en->mask*2+1;
+		en->key=calloc(en->mask+1,sizeof(struct enode*));
+		en->num=malloc((en->mask+1)*sizeof(unsigned int));
+		for (i=0;i<=en->mask/2;i++) if (key[i]!=NULL)
+		{
+			en->key[enumber_slot(en,key[i])]=key[i];
+			en->num[enumber_slot(en,key[i])]=num[i];
+		}
+		free(key);
+		free(num);
+	}
+	i=enumber_slot(en,t);
+	en->key[i]=t;
+	en->num[i]=++en->used;
+	rec[0]=t->pc.type;
+	rec[1]=t->pc.src;
+	rec[2]=t->pc.len;
+	rec[3]=t->pc.pat;
+	rec[4]=t->pc.patlen;
+	rec[5]=t->prio;
+	fwrite(rec,sizeof(rec),1,f);
+	return en->used;
+}
+
+void edit_dump(FILE *f)
+{
+	struct enumber en;
+	uint64_t rec[2];
+	long count;
+	long here;
+	int i;
+	en.mask=4095;
+	en.used=0;
+	en.key=calloc(en.mask+1,sizeof(struct enode*));
+	en.num=malloc((en.mask+1)*sizeof(unsigned int));
+	rec[0]=addlen;
+	fwrite(rec,sizeof(uint64_t),1,f);
+	fwrite(addbuf,1,addlen,f);
+	count=ftell(f);
+	fwrite(rec,sizeof(uint64_t),1,f);
+	for (i=0;i<journaled;i++) edump(f,&en,journal[i].root);
+	edump(f,&en,root);
+	edump(f,&en,clip);
+	here=ftell(f);
+	rec[0]=en.used;
+	fseek(f,count,SEEK_SET);
+	fwrite(rec,sizeof(uint64_t),1,f);
+	fseek(f,here,SEEK_SET);
+	rec[0]=journaled;
+	fwrite(rec,sizeof(uint64_t),1,f);
+	for (i=0;i<journaled;i++)
+	{
+		rec[0]=edump(f,&en,journal[i].root);
+		rec[1]=journal[i].where;
+		fwrite(rec,sizeof(rec),1,f);
+	}
+	rec[0]=edump(f,&en,root);
+	rec[1]=edump(f,&en,clip);
+	fwrite(rec,sizeof(rec),1,f);
+	free(en.key);
+	free(en.num);
+}
+
+// after edit_open() of the same file. on a broken dump nothing changes
+int edit_load(FILE *f)
+{
+	struct enode *n=NULL;
+	struct undo *j=NULL;
+	unsigned char *a=NULL;
+	uint64_t rec[8];
+	uint64_t na;
+	uint64_t nn=0;
+	uint64_t nj=0;
+	uint64_t i;
+	if (fread(&na,sizeof(uint64_t),1,f)!=1 || na>=0x80000000U) return 0;
+	a=malloc(na+1);
+	if (fread(a,1,na,f)!=na) goto broken;
+	if (fread(&nn,sizeof(uint64_t),1,f)!=1 || nn>=0x80000000U) goto broken;
+	n=malloc((nn+1)*sizeof(struct enode));
+	for (i=0;i<nn;i++)
+	{
+		if (fread(rec,sizeof(rec),1,f)!=1 || rec[0]>EDIT_FILL || rec[6]>i || rec[7]>i) goto broken;
+		n[i].pc.type=rec[0];
+		n[i].pc.src=rec[1];
+		n[i].pc.len=rec[2];
+		n[i].pc.pat=rec[3];
+		n[i].pc.patlen=rec[4];
+		n[i].prio=rec[5];
+		n[i].l=rec[6]?&n[rec[6]-1]:NULL;
+		n[i].r=rec[7]?&n[rec[7]-1]:NULL;
+		n[i].total=n[i].pc.len+total(n[i].l)+total(n[i].r);
+		if (n[i].pc.type!=EDIT_FILE && (n[i].pc.type==EDIT_ADD?n[i].pc.src+n[i].pc.len:n[i].pc.pat+n[i].pc.patlen)>na) goto broken;
+		if (n[i].pc.type==EDIT_FILL && n[i].pc.patlen==0) goto broken;
+	}
+	if (fread(&nj,sizeof(uint64_t),1,f)!=1 || nj>=0x10000000U) goto broken;
+	j=malloc((nj+1)*sizeof(struct undo));
+	for (i=0;i<nj;i++)
+	{
+		if (fread(rec,sizeof(uint64_t),2,f)!=2 || rec[0]>nn) goto broken;
+		j[i].root=rec[0]?&n[rec[0]-1]:NULL;
+		j[i].where=rec[1];
+	}
+	if (fread(rec,sizeof(uint64_t),2,f)!=2 || rec[0]>nn || rec[1]>nn) goto broken;
+	free(addbuf);
+	free(journal);
+	addbuf=a;
+	addlen=addmax=na;
+	journal=j;
+	journaled=journalmax=nj;
+	root=rec[0]?&n[rec[0]-1]:NULL;
+	clip=rec[1]?&n[rec[1]-1]:NULL;
+	serial++;
+	return 1;
+broken:
+	free(a);
+	free(n);
+	free(j);
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef EDIT_H
+#define EDIT_H
+#include <stdio.h>
+#include "data.h"
+
+struct bfile;
+
+void edit_open(struct bfile *bf);
+file_position_t edit_size(void);
+int edit_changed(void);
+unsigned int edit_serial(void);
+unsigned int edit_read(struct bfile *bf,file_position_t pos,unsigned char *buf,unsigned int len);
+unsigned int edit_changes(file_position_t pos,unsigned char *map,unsigned int len);
+int edit_source(file_position_t pos,file_position_t *src);
+int edit_hole(struct bfile *bf,file_position_t pos,file_position_t *start,file_position_t *end);
+
+void edit_overwrite(file_position_t pos,const unsigned char *buf,unsigned int len);
+void edit_fill(file_position_t pos,file_position_t len,const unsigned char *pat,unsigned int patlen);
+void edit_insert(file_position_t pos,file_position_t len,const unsigned char *pat,unsigned int patlen);
+void edit_delete(file_position_t pos,file_position_t len);
+file_position_t edit_copy(file_position_t pos,file_position_t len);
+file_position_t edit_paste(file_position_t pos);
+int edit_undo(file_position_t *pos);
+void edit_squash(int since);
+
+int edit_save(struct bfile *bf,const char *filename);
+void edit_dump(FILE *f);
+int edit_load(FILE *f);
+
+#endif
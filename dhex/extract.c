@@ -0,0 +1,311 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "bfile.h"
+#include "extract.h"
+
+// "strings -t x" inside dhex. a thread scans the file (or a part of it)
+// for printable ASCII and UTF-16LE strings. the classification is done 64
+// bytes at a time into bit masks, runs of ones in the masks are the strings.
+
+#define EXTRACT_CHUNK 1048576
+#define EXTRACT_NONE ((file_position_t)-1)
+
+// bit i of *printable: byte i is printable, of *zero: byte i+1 is 0
+static void extract_classify(const unsigned char *buf,uint64_t *printable,uint64_t *zero)
+{
+	unsigned int i;
+#ifdef __SSE2__
+	__m128i b;
+	__m128i x;
+	const __m128i space=_mm_set1_epi8(32);
+	const __m128i range=_mm_set1_epi8(126-32);
+	const __m128i tab=_mm_set1_epi8(9);
+	*printable=0;
+	*zero=0;
+	for (i=0;i<64;i+=16)
+	{
+		b=_mm_loadu_si128((const __m128i *)(buf+i));
+		x=_mm_sub_epi8(b,space);
+		x=_mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(x,range),x),_mm_cmpeq_epi8(b,tab));
+		*printable|=((uint64_t)(unsigned int)_mm_movemask_epi8(x))<<i;
+		b=_mm_loadu_si128((const __m128i *)(buf+i+1));
+		*zero|=((uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(b,_mm_setzero_si128())))<<i;
+	}
+#else
+	*printable=0;
+	*zero=0;
+	for (i=0;i<64;i++)
+	{
+		if ((buf[i]>=32 && buf[i]<127) || buf[i]==9) *printable|=((uint64_t)1)<<i;
+		if (buf[i+1]==0) *zero|=((uint64_t)1)<<i;
+	}
+#endif
+}
+
+// every other bit, packed together
+static uint32_t extract_evenbits(uint64_t x)
+{
+	x&=0x5555555555555555ULL;
+	x=(x|(x>>1))&0x3333333333333333ULL;
+	x=(x|(x>>2))&0x0f0f0f0f0f0f0f0fULL;
+	x=(x|(x>>4))&0x00ff00ff00ff00ffULL;
+	x=(x|(x>>8))&0x0000ffff0000ffffULL;
+	x=(x|(x>>16))&0x00000000ffffffffULL;
+	return (uint32_t)x;
+}
+
+static void extract_add(struct extract *ex,struct strhit *hit,const char *text)
+{
+	unsigned int i;
+	unsigned int l;
+	if (ex->num==ex->max)
+	{
+		ex->max=ex->max?ex->max*2:4096;
+		ex->hits=realloc(ex->hits,ex->max*sizeof(struct strhit));
+	}
+	l=(hit->len<EXTRACT_MAXTEXT)?hit->len:EXTRACT_MAXTEXT;
+	if (ex->textlen+l+1>ex->textmax)
+	{
+		ex->textmax=ex->textmax?ex->textmax*2:65536;
+		while (ex->textlen+l+1>ex->textmax) ex->textmax*=2;
+		ex->text=realloc(ex->text,ex->textmax);
+	}
+	hit->text=ex->textlen;
+	memcpy(ex->text+ex->textlen,text,l);
+	ex->text[ex->textlen+l]=0;
+	ex->textlen+=l+1;
+	// ascii and wide runs end in slightly different order, keep the index sorted
+	i=ex->num;
+	while (i>0 && ex->hits[i-1].pos>hit->pos)
+	{
+		ex->hits[i]=ex->hits[i-1];
+		i--;
+	}
+	ex->hits[i]=*hit;
+	ex->num++;
+}
+
+static void extract_emit(struct extract *ex,const unsigned char *buf,file_position_t bufpos,unsigned int buflen,file_position_t start,file_position_t end,int wide)
+{
+	struct strhit hit;
+	unsigned char raw[2*EXTRACT_MAXTEXT];
+	char text[EXTRACT_MAXTEXT];
+	unsigned int rawlen;
+	unsigned int i;
+	hit.pos=start;
+	hit.wide=wide;
+	hit.len=(end-start)/(wide?2:1);
+	if (hit.len<ex->minlen) return;
+	rawlen=(hit.len<EXTRACT_MAXTEXT)?hit.len:EXTRACT_MAXTEXT;
+	rawlen*=wide?2:1;
+	if (start>=bufpos && start+rawlen<=bufpos+buflen) memcpy(raw,buf+(start-bufpos),rawlen);
+	else rawlen=bfile_read(ex->bf,start,raw,rawlen);	// began in an earlier chunk
+	for (i=0;i<rawlen/(wide?2:1);i++) text[i]=raw[i*(wide?2:1)];
+	pthread_mutex_lock(&ex->lock);
+	extract_add(ex,&hit,text);
+	pthread_mutex_unlock(&ex->lock);
+}
+
+// runs of ones in a mask word. *start is the beginning of a run that is
+// still open from the previous word. stride is 1 for ascii, 2 for wide.
+static void extract_runs(struct extract *ex,const unsigned char *buf,file_position_t bufpos,unsigned int buflen,
+                         uint64_t m,unsigned int bits,file_position_t base,unsigned int stride,file_position_t *start,int wide)
+{
+	unsigned int bit=0;
+	uint64_t rest;
+	uint64_t full=(bits==64)?~0ULL:((1ULL<<bits)-1);
+	m&=full;
+	while (bit<bits)
+	{
+		if (*start==EXTRACT_NONE)
+		{
+			rest=m>>bit;
+			if (rest==0) return;
+			bit+=__builtin_ctzll(rest);
+			*start=base+bit*stride;
+		}
+		rest=(~m&full)>>bit;
+		if (rest==0) return;
+		bit+=__builtin_ctzll(rest);
+		extract_emit(ex,buf,bufpos,buflen,*start,base+bit*stride,wide);
+		*start=EXTRACT_NONE;
+	}
+}
+
+static void extract_chunk(struct extract *ex,const unsigned char *buf,file_position_t pos,unsigned int len)
+{
+	unsigned int o;
+	unsigned int q;
+	unsigned int bits;
+	uint64_t printable;
+	uint64_t zero;
+	uint64_t pair;
+	for (o=0;o<len;o+=64)
+	{
+		extract_classify(buf+o,&printable,&zero);
+		bits=(len-o<64)?len-o:64;
+		extract_runs(ex,buf,pos,len,printable,bits,pos+o,1,&ex->astart,0);
+		pair=printable&zero;
+		for (q=0;q<2;q++)
+		{
+			extract_runs(ex,buf,pos,len,extract_evenbits(pair>>q),(bits-q+1)/2,pos+o+q,2,&ex->wstart[q],1);
+		}
+	}
+}
+
+// hits before the earliest string that is still open can't move anymore
+static void extract_settle(struct extract *ex,file_position_t pos)
+{
+	file_position_t bound=pos;
+	unsigned int i;
+	if (ex->astart<bound) bound=ex->astart;
+	if (ex->wstart[0]<bound) bound=ex->wstart[0];
+	if (ex->wstart[1]<bound) bound=ex->wstart[1];
+	pthread_mutex_lock(&ex->lock);
+	for (i=ex->num;i>ex->stable && ex->hits[i-1].pos>=bound;i--);
+	ex->stable=i;
+	pthread_mutex_unlock(&ex->lock);
+}
+
+static void *extract_thread(void *arg)
+{
+	struct extract *ex=arg;
+	unsigned char *buf;
+	file_position_t pos;
+	unsigned int len;
+	unsigned int n;
+	unsigned int q;
+	buf=malloc(EXTRACT_CHUNK+128);
+	ex->astart=EXTRACT_NONE;
+	ex->wstart[0]=ex->wstart[1]=EXTRACT_NONE;
+	for (pos=ex->done;pos<ex->end && !ex->cancel;pos+=len)
+	{
+		len=(ex->end-pos<EXTRACT_CHUNK)?ex->end-pos:EXTRACT_CHUNK;
+		n=bfile_read(ex->bf,pos,buf,len+1);	// one more for the wide check
+		if (n==0) break;
+		if (n<=len)
+		{
+			len=n;
+			buf[len]=0xff;
+		}
+		extract_chunk(ex,buf,pos,len);
+		extract_settle(ex,pos+len);
+		ex->done=pos+len;
+	}
+	if (ex->astart!=EXTRACT_NONE) extract_emit(ex,buf,0,0,ex->astart,pos,0);
+	for (q=0;q<2;q++) if (ex->wstart[q]!=EXTRACT_NONE) extract_emit(ex,buf,0,0,ex->wstart[q],pos-((pos-ex->wstart[q])&1),1);
+	pthread_mutex_lock(&ex->lock);
+	ex->stable=ex->num;
+	pthread_mutex_unlock(&ex->lock);
+	ex->done=ex->end;
+	free(buf);
+	ex->running=0;
+	return NULL;
+}
+
+static int extract_run(struct extract *ex)
+{
+	pthread_mutex_init(&ex->lock,NULL);
+	ex->running=1;
+	if (pthread_create(&ex->thread,NULL,extract_thread,ex)!=0)
+	{
+		pthread_mutex_destroy(&ex->lock);
+		bfile_close(ex->bf);
+		free(ex->hits);
+		free(ex->text);
+		memset(ex,0,sizeof(struct extract));
+		return 0;
+	}
+	return 1;
+}
+
+int extract_start(struct extract *ex,struct bfile *bf,file_position_t start,file_position_t end,unsigned int minlen)
+{
+	extract_stop(ex);
+	memset(ex,0,sizeof(struct extract));
+	ex->bf=bfile_dup(bf);
+	if (ex->bf==NULL) return 0;
+	ex->start=start;
+	ex->end=end;
+	ex->done=start;
+	ex->minlen=minlen?minlen:1;
+	return extract_run(ex);
+}
+
+void extract_stop(struct extract *ex)
+{
+	if (ex->bf==NULL) return;
+	ex->cancel=1;
+	pthread_join(ex->thread,NULL);
+	pthread_mutex_destroy(&ex->lock);
+	bfile_close(ex->bf);
+	free(ex->hits);
+	free(ex->text);
+	memset(ex,0,sizeof(struct extract));
+}
+
+// case insensitive substring, call with the lock held
+int extract_match(struct extract *ex,unsigned int i,const char *filter)
+{
+	const char *t;
+	unsigned int j;
+	if (filter[0]==0) return 1;
+	for (t=ex->text+ex->hits[i].text;*t;t++)
+	{
+		for (j=0;filter[j] && t[j] && tolower((unsigned char)t[j])==tolower((unsigned char)filter[j]);j++);
+		if (filter[j]==0) return 1;
+	}
+	return 0;
+}
+
+// a finished list goes into the session file, and comes back from there
+// without scanning again
+int extract_dump(struct extract *ex,FILE *f)
+{
+	uint64_t hdr[5];
+	if (ex->bf==NULL || ex->running) return 0;
+	hdr[0]=ex->start;
+	hdr[1]=ex->end;
+	hdr[2]=ex->minlen;
+	hdr[3]=ex->num;
+	hdr[4]=ex->textlen;
+	fwrite(hdr,sizeof(hdr),1,f);
+	fwrite(ex->hits,sizeof(struct strhit),ex->num,f);
+	fwrite(ex->text,1,ex->textlen,f);
+	return 1;
+}
+
+int extract_load(struct extract *ex,struct bfile *bf,FILE *f)
+{
+	uint64_t hdr[5];
+	unsigned int i;
+	int ok;
+	extract_stop(ex);
+	if (fread(hdr,sizeof(hdr),1,f)!=1 || hdr[0]>hdr[1] || hdr[1]>bfile_size(bf) || hdr[3]>=0x10000000U || hdr[4]>=0x80000000U) return 0;
+	ex->max=hdr[3]?hdr[3]:1;
+	ex->textmax=hdr[4]?hdr[4]:1;
+	ex->hits=malloc(ex->max*sizeof(struct strhit));
+	ex->text=malloc(ex->textmax);
+	ex->num=ex->stable=hdr[3];
+	ex->textlen=hdr[4];
+	ok=(fread(ex->hits,sizeof(struct strhit),ex->num,f)==ex->num && fread(ex->text,1,ex->textlen,f)==ex->textlen);
+	if (ok && ex->textlen && ex->text[ex->textlen-1]!=0) ok=0;
+	for (i=0;ok && i<ex->num;i++) if (ex->hits[i].text>=ex->textlen) ok=0;
+	if (!ok || (ex->bf=bfile_dup(bf))==NULL)
+	{
+		free(ex->hits);
+		free(ex->text);
+		memset(ex,0,sizeof(struct extract));
+		return 0;
+	}
+	ex->start=hdr[0];
+	ex->end=hdr[1];
+	ex->minlen=hdr[2];
+	ex->done=ex->end;
+	return extract_run(ex);
+}
@@ -0,0 +1,49 @@
+#ifndef EXTRACT_H
+#define EXTRACT_H
+#include <stdio.h>
+#include <pthread.h>
+#include "data.h"
+
+#define EXTRACT_MAXTEXT 255
+
+struct bfile;
+
+struct strhit
+{
+	file_position_t pos;
+	unsigned int len;		// in characters
+	unsigned int text;		// offset into extract.text, at most EXTRACT_MAXTEXT chars
+	int wide;			// 1: UTF-16LE
+};
+
+struct extract
+{
+	struct bfile *bf;
+	file_position_t start;
+	file_position_t end;
+	unsigned int minlen;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	volatile int running;
+	volatile int cancel;
+	volatile file_position_t done;	// scanned up to here
+	// everything below is protected by lock
+	struct strhit *hits;		// sorted by pos
+	unsigned int num;
+	unsigned int stable;		// hits[0..stable) won't move anymore
+	unsigned int max;
+	char *text;
+	unsigned int textlen;
+	unsigned int textmax;
+	// scanner state, only touched by the thread
+	file_position_t astart;
+	file_position_t wstart[2];
+};
+
+int extract_start(struct extract *ex,struct bfile *bf,file_position_t start,file_position_t end,unsigned int minlen);
+void extract_stop(struct extract *ex);
+int extract_match(struct extract *ex,unsigned int i,const char *filter);
+int extract_dump(struct extract *ex,FILE *f);
+int extract_load(struct extract *ex,struct bfile *bf,FILE *f);
+
+#endif
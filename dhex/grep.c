@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "bfile.h"
+#include "bregex.h"
+#include "grep.h"
+
+// every worker has its own compiled pattern (the DFA is built while it
+// searches) and reads its file through the bfile in grepfile.
+
+#define GREP_MAXHITS 1048576		// kept for the list, all of them are printed
+#define GREP_READAHEAD 8388608
+
+static __thread struct bfile *grepfile;
+
+static unsigned int grep_read(file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	return bfile_read(grepfile,pos,buf,len);
+}
+
+// a file, or everything below a directory. symlinks to directories are
+// not followed, so there are no loops.
+int grep_addpath(struct grep *g,const char *path)
+{
+	struct stat st;
+	DIR *dir;
+	struct dirent *de;
+	char *sub;
+	if (lstat(path,&st)!=0) return 0;
+	if (S_ISLNK(st.st_mode) && stat(path,&st)!=0) return 0;
+	if (S_ISDIR(st.st_mode))
+	{
+		dir=opendir(path);
+		if (dir==NULL) return 0;
+		while ((de=readdir(dir))!=NULL)
+		{
+			if (strcmp(de->d_name,".")==0 || strcmp(de->d_name,"..")==0) continue;
+			sub=malloc(strlen(path)+strlen(de->d_name)+2);
+			sprintf(sub,"%s%s%s",path,(path[strlen(path)-1]=='/')?"":"/",de->d_name);
+			if (lstat(sub,&st)==0 && !S_ISLNK(st.st_mode)) grep_addpath(g,sub);
+			else if (stat(sub,&st)==0 && S_ISREG(st.st_mode)) grep_addpath(g,sub);
+			free(sub);
+		}
+		closedir(dir);
+		return 1;
+	}
+	if (!S_ISREG(st.st_mode) && !S_ISBLK(st.st_mode)) return 0;
+	if (g->files==g->maxfiles)
+	{
+		g->maxfiles=g->maxfiles?g->maxfiles*2:256;
+		g->name=realloc(g->name,g->maxfiles*sizeof(char*));
+	}
+	g->name[g->files]=malloc(strlen(path)+1);
+	memcpy(g->name[g->files],path,strlen(path)+1);
+	g->files++;
+	return 1;
+}
+
+static void grep_report(struct grep *g,unsigned int f,file_position_t *pos,unsigned int n)
+{
+	unsigned int i;
+	pthread_mutex_lock(&g->lock);
+	for (i=0;i<n;i++)
+	{
+		if (g->out!=NULL) fprintf(g->out,"%s:%08llX\n",g->name[f],(unsigned long long)pos[i]);
+		if (g->num==GREP_MAXHITS) continue;
+		if (g->num==g->max)
+		{
+			g->max=g->max?g->max*2:1024;
+			g->hit=realloc(g->hit,g->max*sizeof(struct grephit));
+		}
+		g->hit[g->num].file=f;
+		g->hit[g->num].pos=pos[i];
+		g->num++;
+	}
+	pthread_mutex_unlock(&g->lock);
+}
+
+static void *grep_thread(void *arg)
+{
+	struct grep *g=arg;
+	struct bregex *re;
+	const char *error;
+	file_position_t *pos=NULL;
+	unsigned int n;
+	unsigned int max=0;
+	unsigned int f;
+	file_position_t p;
+	file_position_t size;
+	file_position_t start;
+	file_position_t stop;
+	re=bregex_compile(g->pattern,&error);
+	if (re==NULL) return NULL;
+	for (;;)
+	{
+		pthread_mutex_lock(&g->lock);
+		f=g->next++;
+		pthread_mutex_unlock(&g->lock);
+		if (f>=g->files) break;
+		grepfile=bfile_open(g->name[f]);
+		if (grepfile==NULL)
+		{
+			pthread_mutex_lock(&g->lock);
+			g->failed++;
+			pthread_mutex_unlock(&g->lock);
+			continue;
+		}
+		// the kernel reads ahead further when it knows
+		if (grepfile->type==BFILE_PLAIN)
+		{
+			posix_fadvise(grepfile->fd,0,0,POSIX_FADV_SEQUENTIAL);
+			posix_fadvise(grepfile->fd,0,GREP_READAHEAD,POSIX_FADV_WILLNEED);
+		}
+		size=bfile_size(grepfile);
+		bregex_forget(re);
+		n=0;
+		for (p=0;p<size && bregex_search(re,grep_read,p,size,&start,&stop);p=stop)
+		{
+			if (n==max)
+			{
+				max=max?max*2:256;
+				pos=realloc(pos,max*sizeof(file_position_t));
+			}
+			pos[n++]=start;
+			// a file's hits go out together
+			if (n==65536)
+			{
+				grep_report(g,f,pos,n);
+				n=0;
+			}
+		}
+		grep_report(g,f,pos,n);
+		bfile_close(grepfile);
+		grepfile=NULL;
+	}
+	free(pos);
+	bregex_free(re);
+	return NULL;
+}
+
+static int grep_cmp(const void *x,const void *y)
+{
+	const struct grephit *a=x;
+	const struct grephit *b=y;
+	if (a->file!=b->file) return (a->file<b->file)?-1:1;
+	if (a->pos!=b->pos) return (a->pos<b->pos)?-1:1;
+	return 0;
+}
+
+// the number of hits, -1 if the pattern is wrong
+int grep_run(struct grep *g,const char *pattern,unsigned int threads,FILE *out,const char **error)
+{
+	pthread_t thread[GREP_MAXTHREADS];
+	struct bregex *re;
+	unsigned int i;
+	unsigned int started=0;
+	long cpus;
+	re=bregex_compile(pattern,error);
+	if (re==NULL) return -1;
+	bregex_free(re);
+	if (threads==0)
+	{
+		cpus=sysconf(_SC_NPROCESSORS_ONLN);
+		threads=(cpus>0)?cpus:1;
+	}
+	if (threads>GREP_MAXTHREADS) threads=GREP_MAXTHREADS;
+	if (threads>g->files) threads=g->files?g->files:1;
+	g->pattern=pattern;
+	g->out=out;
+	g->next=0;
+	pthread_mutex_init(&g->lock,NULL);
+	for (i=0;i<threads;i++) if (pthread_create(&thread[started],NULL,grep_thread,g)==0) started++;
+	if (started==0) grep_thread(g);
+	for (i=0;i<started;i++) pthread_join(thread[i],NULL);
+	pthread_mutex_destroy(&g->lock);
+	qsort(g->hit,g->num,sizeof(struct grephit),grep_cmp);
+	return g->num;
+}
+
+void grep_free(struct grep *g)
+{
+	unsigned int i;
+	for (i=0;i<g->files;i++) free(g->name[i]);
+	free(g->name);
+	free(g->hit);
+	memset(g,0,sizeof(struct grep));
+}
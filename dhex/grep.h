@@ -0,0 +1,38 @@
+#ifndef GREP_H
+#define GREP_H
+#include <stdio.h>
+#include <pthread.h>
+#include "data.h"
+
+// dhex --grep: one search pattern (the regex syntax of the Search-Menu)
+// over many files, a file per worker thread at a time.
+
+#define GREP_MAXTHREADS 64
+
+struct grephit
+{
+	unsigned int file;
+	file_position_t pos;
+};
+
+struct grep
+{
+	char **name;
+	unsigned int files;
+	unsigned int maxfiles;
+	const char *pattern;
+	FILE *out;			// where the hits are printed as they come, or NULL
+	pthread_mutex_t lock;
+	// protected by lock
+	unsigned int next;		// the next file a worker takes
+	struct grephit *hit;		// sorted by file and offset once grep_run is done
+	unsigned int num;
+	unsigned int max;
+	unsigned int failed;		// files that could not be opened
+};
+
+int grep_addpath(struct grep *g,const char *path);
+int grep_run(struct grep *g,const char *pattern,unsigned int threads,FILE *out,const char **error);
+void grep_free(struct grep *g);
+
+#endif
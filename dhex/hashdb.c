@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bfile.h"
+#include "runs.h"
+#include "hashdb.h"
+
+#define HASHDB_MAGIC "DHEXHDB1"
+#define HASHDB_CHUNK 1048576
+
+// eight bytes per step, every step through a multiply
+uint64_t hashdb_hash(const unsigned char *buf,unsigned int len)
+{
+	uint64_t h=0x243f6a8885a308d3ULL^len;
+	uint64_t w;
+	unsigned int i;
+	for (i=0;i+8<=len;i+=8)
+	{
+		memcpy(&w,buf+i,8);
+		h=(h^w)*0x9e3779b97f4a7c15ULL;
+		h^=h>>29;
+	}
+	for (;i<len;i++) h=(h^buf[i])*0x100000001b3ULL;
+	h^=h>>32;
+	h*=0xd6e8feb86659fd93ULL;
+	h^=h>>32;
+	return h;
+}
+
+static int hashdb_cmp(const void *x,const void *y)
+{
+	const struct hashrec *a=x;
+	const struct hashrec *b=y;
+	if (a->hash!=b->hash) return (a->hash<b->hash)?-1:1;
+	if (a->file!=b->file) return (a->file<b->file)?-1:1;
+	return (a->block<b->block)?-1:(a->block>b->block);
+}
+
+// the number of distinct blocks that went in, -1 if the database could not
+// be written. a block that is in several places is kept with the first one.
+int64_t hashdb_build(const char *out,char **files,unsigned int nfiles,unsigned int blocksize,FILE *log)
+{
+	struct bfile *bf;
+	struct hashrec *rec=NULL;
+	uint64_t num=0;
+	uint64_t max=0;
+	uint64_t hdr[5];
+	uint64_t *dir;
+	uint64_t i;
+	uint64_t j;
+	unsigned char *buf;
+	file_position_t pos;
+	file_position_t size;
+	unsigned int bits;
+	unsigned int n;
+	unsigned int k;
+	unsigned int f;
+	FILE *o;
+	int ok=1;
+	if (blocksize==0 || blocksize>HASHDB_CHUNK || HASHDB_CHUNK%blocksize) return -1;
+	buf=malloc(HASHDB_CHUNK);
+	for (f=0;f<nfiles;f++)
+	{
+		bf=bfile_open(files[f]);
+		if (bf==NULL)
+		{
+			if (log!=NULL) fprintf(log,"%s: can not be opened\n",files[f]);
+			continue;
+		}
+		size=bfile_size(bf);
+		for (pos=0;pos<size;pos+=n)
+		{
+			n=bfile_read(bf,pos,buf,HASHDB_CHUNK);
+			if (n==0) break;
+			for (k=0;k+blocksize<=n;k+=blocksize)
+			{
+				if ((pos+k)/blocksize>0xffffffffULL || runs_uniform(buf+k,blocksize)) continue;
+				if (num==max)
+				{
+					max=max?max*2:65536;
+					rec=realloc(rec,max*sizeof(struct hashrec));
+				}
+				rec[num].hash=hashdb_hash(buf+k,blocksize);
+				rec[num].file=f;
+				rec[num].block=(pos+k)/blocksize;
+				num++;
+			}
+		}
+		if (log!=NULL) fprintf(log,"%s: %llu bytes\n",files[f],(unsigned long long)size);
+		bfile_close(bf);
+	}
+	free(buf);
+	qsort(rec,num,sizeof(struct hashrec),hashdb_cmp);
+	for (i=0,j=0;i<num;i++) if (j==0 || rec[i].hash!=rec[j-1].hash) rec[j++]=rec[i];
+	num=j;
+	// about four records per directory entry
+	for (bits=8;bits<24 && (1ULL<<(bits+2))<num;bits++);
+	dir=malloc(((1ULL<<bits)+1)*sizeof(uint64_t));
+	for (i=0,j=0;i<=(1ULL<<bits);i++)
+	{
+		while (j<num && (rec[j].hash>>(64-bits))<i) j++;
+		dir[i]=j;
+	}
+	o=fopen(out,"wb");
+	if (o==NULL) ok=0;
+	else
+	{
+		hdr[0]=blocksize;
+		hdr[1]=nfiles;
+		hdr[2]=num;
+		hdr[3]=bits;
+		hdr[4]=0;
+		for (f=0;f<nfiles;f++) hdr[4]+=strlen(files[f])+1;
+		fwrite(HASHDB_MAGIC,8,1,o);
+		fwrite(hdr,sizeof(hdr),1,o);
+		fwrite(dir,sizeof(uint64_t),(1ULL<<bits)+1,o);
+		fwrite(rec,sizeof(struct hashrec),num,o);
+		for (f=0;f<nfiles;f++) fwrite(files[f],strlen(files[f])+1,1,o);
+		if (ferror(o)) ok=0;
+		if (fclose(o)!=0) ok=0;
+		if (!ok) unlink(out);
+	}
+	free(dir);
+	free(rec);
+	return ok?(int64_t)num:-1;
+}
+
+int hashdb_open(struct hashdb *db,const char *filename)
+{
+	struct stat st;
+	uint64_t hdr[5];
+	uint64_t need;
+	const char *t;
+	unsigned int f;
+	int fd;
+	memset(db,0,sizeof(struct hashdb));
+	fd=open(filename,O_RDONLY);
+	if (fd<0) return 0;
+	if (fstat(fd,&st)!=0 || st.st_size<8+(off_t)sizeof(hdr))
+	{
+		close(fd);
+		return 0;
+	}
+	db->map=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if (db->map==MAP_FAILED)
+	{
+		db->map=NULL;
+		return 0;
+	}
+	db->mapsize=st.st_size;
+	memcpy(hdr,db->map+8,sizeof(hdr));
+	need=8+sizeof(hdr)+((1ULL<<(hdr[3]&31))+1)*sizeof(uint64_t)+hdr[2]*sizeof(struct hashrec)+hdr[4];
+	if (memcmp(db->map,HASHDB_MAGIC,8)!=0 || hdr[0]==0 || hdr[0]>HASHDB_CHUNK || hdr[1]>65536 || hdr[3]<8 || hdr[3]>24
+		|| hdr[2]>(uint64_t)st.st_size || need!=(uint64_t)st.st_size || (hdr[4] && db->map[st.st_size-1]!=0))
+	{
+		hashdb_close(db);
+		return 0;
+	}
+	db->blocksize=hdr[0];
+	db->files=hdr[1];
+	db->num=hdr[2];
+	db->bits=hdr[3];
+	db->dir=(const uint64_t *)(db->map+8+sizeof(hdr));
+	db->rec=(const struct hashrec *)(db->dir+(1ULL<<db->bits)+1);
+	db->name=malloc((db->files+1)*sizeof(char*));
+	t=(const char *)(db->rec+db->num);
+	for (f=0;f<db->files;f++)
+	{
+		if (t>=(const char *)db->map+db->mapsize) break;
+		db->name[f]=t;
+		t+=strlen(t)+1;
+	}
+	if (f<db->files || db->dir[1ULL<<db->bits]!=db->num)
+	{
+		hashdb_close(db);
+		return 0;
+	}
+	return 1;
+}
+
+void hashdb_close(struct hashdb *db)
+{
+	if (db->map!=NULL) munmap(db->map,db->mapsize);
+	free(db->name);
+	memset(db,0,sizeof(struct hashdb));
+}
+
+const struct hashrec *hashdb_find(struct hashdb *db,uint64_t hash)
+{
+	uint64_t lo;
+	uint64_t hi;
+	uint64_t mid;
+	uint64_t b;
+	b=hash>>(64-db->bits);
+	lo=db->dir[b];
+	hi=db->dir[b+1];
+	if (lo>hi || hi>db->num) return NULL;
+	while (lo<hi)
+	{
+		mid=lo+(hi-lo)/2;
+		if (db->rec[mid].hash<hash) lo=mid+1; else hi=mid;
+	}
+	if (lo<db->dir[b+1] && db->rec[lo].hash==hash && db->rec[lo].file<db->files) return &db->rec[lo];
+	return NULL;
+}
+
+static void *hashdb_thread(void *arg)
+{
+	struct hashscan *hs=arg;
+	unsigned char *buf;
+	unsigned int bs=hs->db->blocksize;
+	file_position_t pos;
+	file_position_t b;
+	unsigned int n;
+	unsigned int k;
+	unsigned char s;
+	buf=malloc(HASHDB_CHUNK);
+	for (b=0;b<hs->blocks && !hs->cancel;b+=n/bs)
+	{
+		pos=b*bs;
+		n=bfile_read(hs->bf,pos,buf,HASHDB_CHUNK);
+		n-=n%bs;
+		if (n/bs>hs->blocks-b) n=(hs->blocks-b)*bs;
+		if (n==0) break;
+		for (k=0;k<n;k+=bs)
+		{
+			if (runs_uniform(buf+k,bs)) s=HASHDB_SKIP;
+			else if (hashdb_find(hs->db,hashdb_hash(buf+k,bs))!=NULL)
+			{
+				s=HASHDB_KNOWN;
+				hs->known++;
+			} else {
+				s=HASHDB_NOVEL;
+				hs->novel++;
+			}
+			hs->state[b+k/bs]=s;
+		}
+		__sync_synchronize();
+		hs->done=b+n/bs;
+	}
+	free(buf);
+	hs->running=0;
+	return NULL;
+}
+
+// looks up every whole block of bf in the background
+int hashdb_start(struct hashscan *hs,struct hashdb *db,struct bfile *bf)
+{
+	hashdb_stop(hs);
+	memset(hs,0,sizeof(struct hashscan));
+	hs->db=db;
+	hs->blocks=bfile_size(bf)/db->blocksize;
+	if (hs->blocks>HASHDB_MAXBLOCKS) hs->blocks=HASHDB_MAXBLOCKS;
+	hs->state=calloc(hs->blocks+1,1);
+	hs->bf=bfile_dup(bf);
+	if (hs->state==NULL || hs->bf==NULL)
+	{
+		free(hs->state);
+		bfile_close(hs->bf);
+		memset(hs,0,sizeof(struct hashscan));
+		return 0;
+	}
+	hs->running=1;
+	if (pthread_create(&hs->thread,NULL,hashdb_thread,hs)!=0)
+	{
+		free(hs->state);
+		bfile_close(hs->bf);
+		memset(hs,0,sizeof(struct hashscan));
+		return 0;
+	}
+	return 1;
+}
+
+void hashdb_stop(struct hashscan *hs)
+{
+	if (hs->bf==NULL) return;
+	hs->cancel=1;
+	pthread_join(hs->thread,NULL);
+	bfile_close(hs->bf);
+	free(hs->state);
+	memset(hs,0,sizeof(struct hashscan));
+}
+
+// HASHDB_NONE until the thread got there
+int hashdb_state(struct hashscan *hs,file_position_t pos)
+{
+	file_position_t b;
+	if (hs->bf==NULL) return HASHDB_NONE;
+	b=pos/hs->db->blocksize;
+	if (b>=hs->done) return HASHDB_NONE;
+	return hs->state[b];
+}
@@ -0,0 +1,66 @@
+#ifndef HASHDB_H
+#define HASHDB_H
+#include <stdio.h>
+#include <pthread.h>
+#include "data.h"
+
+// a database of the block hashes of reference images (dhex --mkdb), and a
+// thread that sorts the blocks of the open file into known and novel ones.
+// on disk the records are sorted by hash, with a directory over the top
+// bits of the hash, so a lookup touches one or two pages of the mapping.
+// blocks of one and the same byte are not in there and are not looked up.
+
+#define HASHDB_MAXBLOCKS 268435456	// bounds the state array of a scan
+
+#define HASHDB_NONE 0			// not looked at yet
+#define HASHDB_SKIP 1			// uniform or short
+#define HASHDB_KNOWN 2
+#define HASHDB_NOVEL 3
+
+struct bfile;
+
+struct hashrec
+{
+	uint64_t hash;
+	uint32_t file;
+	uint32_t block;
+};
+
+struct hashdb
+{
+	unsigned char *map;
+	size_t mapsize;
+	unsigned int blocksize;
+	unsigned int files;
+	uint64_t num;
+	unsigned int bits;
+	const uint64_t *dir;		// (1<<bits)+1 starts into rec
+	const struct hashrec *rec;
+	const char **name;
+};
+
+struct hashscan
+{
+	struct hashdb *db;
+	struct bfile *bf;
+	file_position_t blocks;
+	pthread_t thread;
+	volatile int running;
+	volatile int cancel;
+	volatile file_position_t done;	// blocks below this one have their state
+	unsigned char *state;
+	volatile file_position_t known;
+	volatile file_position_t novel;
+};
+
+uint64_t hashdb_hash(const unsigned char *buf,unsigned int len);
+int64_t hashdb_build(const char *out,char **files,unsigned int nfiles,unsigned int blocksize,FILE *log);
+int hashdb_open(struct hashdb *db,const char *filename);
+void hashdb_close(struct hashdb *db);
+const struct hashrec *hashdb_find(struct hashdb *db,uint64_t hash);
+
+int hashdb_start(struct hashscan *hs,struct hashdb *db,struct bfile *bf);
+void hashdb_stop(struct hashscan *hs);
+int hashdb_state(struct hashscan *hs,file_position_t pos);
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hits.h"
+
+void hits_clear(struct hits *hs)
+{
+	free(hs->h);
+	hs->h=NULL;
+	hs->num=0;
+	hs->serial++;
+}
+
+static int cmpstart(const void *a,const void *b)
+{
+	const struct hit *x=a;
+	const struct hit *y=b;
+	if (x->start!=y->start) return (x->start<y->start)?-1:1;
+	return 0;
+}
+
+void hits_build(struct hits *hs,struct results *res)
+{
+	file_position_t m=0;
+	unsigned int i;
+	hits_clear(hs);
+	if (res->num==0) return;
+	hs->h=malloc(res->num*sizeof(struct hit));
+	for (i=0;i<res->num;i++)
+	{
+		hs->h[i].start=res->r[i].offset;
+		hs->h[i].end=res->r[i].offset+(res->r[i].len?res->r[i].len:1);
+	}
+	qsort(hs->h,res->num,sizeof(struct hit),cmpstart);
+	for (i=0;i<res->num;i++)
+	{
+		if (hs->h[i].end>m) m=hs->h[i].end;
+		hs->h[i].maxend=m;
+	}
+	hs->num=res->num;
+}
+
+// the first hit that starts at pos or after it, num if there is none
+unsigned int hits_find(struct hits *hs,file_position_t pos)
+{
+	unsigned int lo=0;
+	unsigned int hi=hs->num;
+	unsigned int mid;
+	while (lo<hi)
+	{
+		mid=(lo+hi)/2;
+		if (hs->h[mid].start<pos) lo=mid+1; else hi=mid;
+	}
+	return lo;
+}
+
+// mark[i] is set for every byte pos+i some hit covers. returns the hits
+// that touch [pos,pos+len)
+unsigned int hits_mark(struct hits *hs,file_position_t pos,unsigned int len,unsigned char *mark)
+{
+	file_position_t s;
+	file_position_t e;
+	unsigned int lo;
+	unsigned int n=0;
+	memset(mark,0,len);
+	lo=hits_find(hs,pos+len);
+	while (lo>0 && hs->h[lo-1].maxend>pos)
+	{
+		lo--;
+		if (hs->h[lo].end<=pos) continue;
+		s=(hs->h[lo].start>pos)?hs->h[lo].start:pos;
+		e=(hs->h[lo].end<pos+len)?hs->h[lo].end:pos+len;
+		memset(mark+(s-pos),1,e-s);
+		n++;
+	}
+	return n;
+}
+
+// len bytes were inserted at pos (or -len deleted from there): the hits
+// behind move along, a hit that was cut into or lost bytes is dropped
+void hits_shift(struct hits *hs,file_position_t pos,int64_t len)
+{
+	file_position_t cut=(len<0)?pos-len:pos;
+	file_position_t m=0;
+	unsigned int i;
+	unsigned int j=0;
+	for (i=0;i<hs->num;i++)
+	{
+		if (hs->h[i].start<cut && hs->h[i].end>pos) continue;
+		hs->h[j]=hs->h[i];
+		if (hs->h[j].start>=cut)
+		{
+			hs->h[j].start+=len;
+			hs->h[j].end+=len;
+		}
+		if (hs->h[j].end>m) m=hs->h[j].end;
+		hs->h[j].maxend=m;
+		j++;
+	}
+	hs->num=j;
+	hs->serial++;
+}
@@ -0,0 +1,31 @@
+#ifndef HITS_H
+#define HITS_H
+#include "data.h"
+#include "results.h"
+
+// the hits of a search as intervals, to be asked which of them a window
+// of the file touches. they are sorted by where they start, and each one
+// knows the furthest end of all before it: going back from the window's
+// end stops at the first one whose predecessors all end before the window.
+
+struct hit
+{
+	file_position_t start;
+	file_position_t end;
+	file_position_t maxend;		// of this one and all before it
+};
+
+struct hits
+{
+	struct hit *h;
+	unsigned int num;
+	unsigned int serial;		// counts up with every new set
+};
+
+void hits_clear(struct hits *hs);
+void hits_build(struct hits *hs,struct results *res);
+unsigned int hits_find(struct hits *hs,file_position_t pos);
+unsigned int hits_mark(struct hits *hs,file_position_t pos,unsigned int len,unsigned char *mark);
+void hits_shift(struct hits *hs,file_position_t pos,int64_t len);
+
+#endif
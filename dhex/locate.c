@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <string.h>
+#include "runs.h"
+#include "locate.h"
+
+#define LOCATE_CHUNK 1048576
+#define LOCATE_BASE 0x100000001b3ULL
+#define LOCATE_FILTERBITS 20		// 128KB of bits, a cheap no for most windows
+
+struct needle
+{
+	uint64_t *fp;			// fingerprint of every block of B, 0: not used
+	unsigned int *slot;		// open addressing over fp, block number+1
+	unsigned int slots;
+	unsigned char *filter;
+};
+
+static unsigned int locate_mix(uint64_t h,unsigned int bits)
+{
+	return (unsigned int)((h*0x9e3779b97f4a7c15ULL)>>(64-bits));
+}
+
+static uint64_t locate_hash(const unsigned char *p,unsigned int len)
+{
+	uint64_t h=0;
+	unsigned int i;
+	for (i=0;i<len;i++) h=h*LOCATE_BASE+p[i];
+	return h;
+}
+
+static void locate_add(struct locate *lo,int64_t shift,file_position_t a,unsigned int len)
+{
+	unsigned int i;
+	unsigned int *old;
+	unsigned int oldslots;
+	unsigned int j;
+	if (lo->num*2>=lo->slots)
+	{
+		old=lo->index;
+		oldslots=lo->slots;
+		lo->slots=lo->slots?lo->slots*2:4096;
+		lo->index=calloc(lo->slots,sizeof(unsigned int));
+		for (j=0;j<oldslots;j++)
+		{
+			if (old[j]==0) continue;
+			for (i=locate_mix(lo->hit[old[j]-1].shift,31)&(lo->slots-1);lo->index[i]!=0;i=(i+1)&(lo->slots-1));
+			lo->index[i]=old[j];
+		}
+		free(old);
+	}
+	for (i=locate_mix(shift,31)&(lo->slots-1);lo->index[i]!=0;i=(i+1)&(lo->slots-1))
+	{
+		if (lo->hit[lo->index[i]-1].shift==shift)
+		{
+			lo->hit[lo->index[i]-1].bytes+=len;
+			return;
+		}
+	}
+	if (lo->num==LOCATE_MAXHITS) return;
+	if (lo->num==lo->max)
+	{
+		lo->max=lo->max?lo->max*2:256;
+		lo->hit=realloc(lo->hit,lo->max*sizeof(struct locatehit));
+	}
+	lo->hit[lo->num].shift=shift;
+	lo->hit[lo->num].a=a;
+	lo->hit[lo->num].bytes=len;
+	lo->num++;
+	lo->index[i]=lo->num;
+}
+
+static int locate_cmp(const void *x,const void *y)
+{
+	const struct locatehit *a=x;
+	const struct locatehit *b=y;
+	if (a->bytes!=b->bytes) return (a->bytes>b->bytes)?-1:1;
+	if (a->a!=b->a) return (a->a<b->a)?-1:1;
+	return 0;
+}
+
+// blocks of one and the same byte (padding, erased flash) are everywhere,
+// they are not looked for. a block that B already had is only looked for
+// where it came first, or a periodic B makes every window match every copy
+static unsigned int locate_needle(struct needle *nd,locate_readfn readb,unsigned int block,unsigned int blocks)
+{
+	unsigned char *buf;
+	unsigned int j;
+	unsigned int i;
+	unsigned int used=0;
+	nd->fp=calloc(blocks,sizeof(uint64_t));
+	for (nd->slots=1024;nd->slots<2*blocks;nd->slots*=2);
+	nd->slot=calloc(nd->slots,sizeof(unsigned int));
+	nd->filter=calloc(1<<(LOCATE_FILTERBITS-3),1);
+	buf=malloc(block);
+	for (j=0;j<blocks;j++)
+	{
+		if (readb((file_position_t)j*block,buf,block)!=block || runs_uniform(buf,block)) continue;
+		nd->fp[j]=locate_hash(buf,block)|1;
+		for (i=locate_mix(nd->fp[j],31)&(nd->slots-1);nd->slot[i]!=0 && nd->fp[nd->slot[i]-1]!=nd->fp[j];i=(i+1)&(nd->slots-1));
+		if (nd->slot[i]!=0)
+		{
+			nd->fp[j]=0;
+			continue;
+		}
+		nd->slot[i]=j+1;
+		i=locate_mix(nd->fp[j],LOCATE_FILTERBITS);
+		nd->filter[i>>3]|=1<<(i&7);
+		used++;
+	}
+	free(buf);
+	return used;
+}
+
+int locate_run(struct locate *lo,locate_readfn reada,file_position_t sizea,locate_readfn readb,file_position_t sizeb,locate_progressfn progress)
+{
+	struct needle nd;
+	unsigned char *buf;
+	unsigned char *bblk;
+	uint64_t h;
+	uint64_t top=1;			// LOCATE_BASE^(block-1)
+	uint64_t f;
+	file_position_t pos;
+	unsigned int blocks;
+	unsigned int n;
+	unsigned int i;
+	unsigned int k;
+	unsigned int s;
+	int stopped=0;
+	memset(lo,0,sizeof(struct locate));
+	if (sizeb==0 || sizea==0) return 0;
+	lo->block=64;
+	while (sizeb/lo->block>LOCATE_MAXBLOCKS) lo->block*=2;
+	if (lo->block>sizeb) lo->block=sizeb;
+	blocks=sizeb/lo->block;
+	if (locate_needle(&nd,readb,lo->block,blocks)==0)
+	{
+		free(nd.fp);
+		free(nd.slot);
+		free(nd.filter);
+		return 0;
+	}
+	for (i=1;i<lo->block;i++) top*=LOCATE_BASE;
+	buf=malloc(LOCATE_CHUNK+lo->block);
+	bblk=malloc(lo->block);
+	for (pos=0;pos+lo->block<=sizea && !stopped;pos+=n)
+	{
+		// windows starting in [pos,pos+n), the last one needs block-1 more bytes
+		n=reada(pos,buf,(sizea-pos<LOCATE_CHUNK+lo->block-1)?sizea-pos:LOCATE_CHUNK+lo->block-1);
+		if (n<lo->block) break;
+		n-=lo->block-1;
+		h=locate_hash(buf,lo->block);
+		for (i=0;i<n;i++)
+		{
+			if (i) h=(h-top*buf[i-1])*LOCATE_BASE+buf[i+lo->block-1];
+			f=h|1;
+			k=locate_mix(f,LOCATE_FILTERBITS);
+			if (!(nd.filter[k>>3]&(1<<(k&7)))) continue;
+			for (s=locate_mix(f,31)&(nd.slots-1);nd.slot[s]!=0;s=(s+1)&(nd.slots-1))
+			{
+				if (nd.fp[nd.slot[s]-1]!=f) continue;
+				// a hash is only a hint
+				k=nd.slot[s]-1;
+				if (readb((file_position_t)k*lo->block,bblk,lo->block)==lo->block && memcmp(bblk,buf+i,lo->block)==0)
+					locate_add(lo,(int64_t)(pos+i)-(int64_t)k*lo->block,pos+i,lo->block);
+				break;
+			}
+		}
+		if (progress!=NULL && progress(pos+n,sizea)) stopped=1;
+	}
+	free(buf);
+	free(bblk);
+	free(nd.fp);
+	free(nd.slot);
+	free(nd.filter);
+	free(lo->index);
+	lo->index=NULL;
+	lo->slots=0;
+	qsort(lo->hit,lo->num,sizeof(struct locatehit),locate_cmp);
+	return !stopped;
+}
+
+void locate_free(struct locate *lo)
+{
+	free(lo->hit);
+	free(lo->index);
+	memset(lo,0,sizeof(struct locate));
+}
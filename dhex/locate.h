@@ -0,0 +1,37 @@
+#ifndef LOCATE_H
+#define LOCATE_H
+#include "data.h"
+
+// where does file B (the needle) sit inside file A? B is cut into blocks,
+// a Rabin-Karp hash rolls over A and every window that hashes like a block
+// of B is compared byte by byte. the hits are grouped by the shift between
+// A and B, so a copy with a few changed blocks is still one hit.
+
+#define LOCATE_MAXBLOCKS 65536
+#define LOCATE_MAXHITS 65536
+
+typedef unsigned int (*locate_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+typedef int (*locate_progressfn)(file_position_t done,file_position_t total);	// nonzero stops
+
+struct locatehit
+{
+	int64_t shift;			// B's offset 0 is at A's offset shift
+	file_position_t a;		// the first block that matched, in A
+	file_position_t bytes;		// how much of B matched at this shift
+};
+
+struct locate
+{
+	unsigned int block;
+	struct locatehit *hit;		// the most bytes first
+	unsigned int num;
+	unsigned int max;
+	// shift -> hit, while scanning
+	unsigned int *index;
+	unsigned int slots;
+};
+
+int locate_run(struct locate *lo,locate_readfn reada,file_position_t sizea,locate_readfn readb,file_position_t sizeb,locate_progressfn progress);
+void locate_free(struct locate *lo);
+
+#endif
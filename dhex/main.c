@@ -1,37 +1,43 @@
 #include <stdio.h>
-#include <sys/types.h>        // uint64_t
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ctype.h>
 #include <ncurses.h>
+#include "data.h"
 #include "gpl.h"
 #include "ui.h"
-#ifdef FREEBSD
-	#define file_position_t uint64_t
-#endif
-#ifdef LINUX
-	#include <stdint.h>
-	#define file_position_t uint64_t
-#endif
-#ifdef IRIX
-        #define file_position_t fpos_t
-#endif
-#ifdef SOLARIS
-	#define file_position_t fpos64_t
-#endif
-#ifdef HPUX
-	#define file_position_t fpos64_t
-#endif
+#include "bfile.h"
+#include "runs.h"
+#include "extract.h"
+#include "edit.h"
+#include "digest.h"
+#include "bregex.h"
+#include "approx.h"
+#include "results.h"
+#include "values.h"
+#include "narrow.h"
+#include "mask.h"
+#include "dotplot.h"
+#include "locate.h"
+#include "grep.h"
+#include "session.h"
+#include "hashdb.h"
+#include "stride.h"
+#include "bits.h"
+#include "xform.h"
+#include "patch.h"
+#include "scanio.h"
+#include "stats.h"
+#include "hits.h"
 
 
-FILE* inputfile;
-FILE* inputfile2;
+struct bfile* inputfile;
+struct bfile* inputfile2;
 int obenanfangen=1;
 file_position_t cursorpos;
 unsigned int cols;
 int rows;
-FILE *inputfile;
-file_position_t chpos[524288];
-unsigned char change[524288];
-int chnum=0;
 char* searchstring;
 int searchstring2[255];
 unsigned int searchstring2len=0;
@@ -42,9 +48,158 @@ char* readsearchfilename;
 FILE *readsearchfile;
 int writesearch=0;
 int readsearch=0;
+int searchregex=0;
+char* regexstring;
+struct bregex* searchre=NULL;
+unsigned int searchmismatches=0;
+struct results searchresults;
+struct hits searchhits;		// the hits of the last scan or result file, highlighted
+char hitsfile[256]="";		// the result file they were read from
+time_t hitsmtime;
+unsigned char shownpat[255];	// a plain search keeps no result set, what it looked for
+unsigned int shownlen=0;	// fills searchhits around the screen. 0: nothing
+unsigned int shownk=0;		// bytes that may differ
+struct bregex* shownre=NULL;	// or the regex
+file_position_t shownlo=0;	// searchhits has its matches in [shownlo,shownhi)
+file_position_t shownhi=0;
+unsigned int shownserial=0;	// edit_serial() they were found in
+#define SHOWN_REACH 65536	// the screen is kept this far inside [shownlo,shownhi)
+#define SHOWN_CHUNK 16777216	// the results panel's scan says how far it is after this much
+#define SHOWN_MAXHITS 1048576	// and stops after this many hits
+int showncut=0;			// the panel's scan stopped early, searchhits has only the first
+char hitfilter[64]="";		// the results panel: lo..hi and/or hex bytes the hits start with
+unsigned int hitfirst=0;	// the hits in the offset range
+unsigned int hitlast=0;
+unsigned char hitbytes[32];
+unsigned int nhitbytes=0;
+unsigned int* hitfiltered=NULL;	// with bytes: those that start with them
+unsigned int hitnfiltered=0;
+unsigned int hitmaxfiltered=0;
+unsigned int hitupto=0;		// the next one to look at
+unsigned int hitserial=0;	// the set of hits the list is for
+unsigned int hitsel=0;
+unsigned int hittop=0;
+file_position_t approxhit;
 int kmp[256];
 int kmpback[256];
 int diffnotedit=0;
+unsigned int skipblocksize=512;
+int dimerased=0;
+int marked=0;
+file_position_t markpos=0;
+struct extract strs;
+unsigned int stringsminlen=4;
+char strfilter[64];
+unsigned int* strfiltered=NULL;
+unsigned int strnfiltered=0;
+unsigned int strmaxfiltered=0;
+unsigned int strupto=0;		// hits before this one went through the filter
+unsigned int strsel=0;
+unsigned int strtop=0;
+#define SPECIAL_STRINGS 1
+#define SPECIAL_CHECKSUMS 2
+#define SPECIAL_FILL 3
+#define SPECIAL_COPY 4
+#define SPECIAL_PASTE 5
+#define SPECIAL_INSERT 6
+#define SPECIAL_DELETE 7
+#define SPECIAL_VALUE 8
+#define SPECIAL_NARROW 9
+#define SPECIAL_DIFFSUMMARY 10
+#define SPECIAL_DOTPLOT 11
+#define SPECIAL_LOCATE 12
+#define SPECIAL_STRIDE 13
+#define SPECIAL_BITS 14
+#define SPECIAL_XFORM 15
+#define SPECIAL_PATCH 16
+#define SPECIAL_RESULTS 17
+int searchkind=0;		// what F5 goes on with, 0: the search menu, 1: a value search, 2: candidates, 3: bits, 4: encoded
+char valuetext[64]="";
+int valuefloats=0;
+struct values searchvalues;
+file_position_t valuehit;
+unsigned int valuewhich;
+const char* foundwhat=NULL;	// shown once in the headline
+struct narrow candidates;
+struct bfile* narrowold=NULL;	// the snapshot the next one is compared with, NULL: the file itself
+struct bfile* narrownew=NULL;
+unsigned int narrowwidth=4;
+char narrowsnapshot[256]="";
+unsigned char fillpattern[16]={0};
+unsigned int fillpatternlen=1;
+char fillpatternhex[33]="00";
+file_position_t insertcount=1;
+struct bits searchbits;
+char bitstext[64]="";
+file_position_t bitfrom;
+file_position_t bithit=(file_position_t)-1;	// bit offset of the last bit pattern found
+char bitwhat[64];
+unsigned int viewbits=0;	// the view starts this many bits into the bytes
+struct xform searchxform;
+char xformtext[64]="";
+int xformhex=0;			// the plaintext is hex bytes
+struct xformkey
+{
+	unsigned int which;
+	unsigned char key[XFORM_MAXPERIOD];
+};
+struct xformkey* xformkeys=NULL;	// a result file comment for every change of key
+unsigned int nxformkeys=0;
+unsigned int maxxformkeys=0;
+char xformwhat[32];
+char patchname[256]="";
+char patchwhat[64];
+int poscols=10;		// hex digits of the offsets on the left
+#define LIVE_INTERVAL 1000	// ms between two samples of a process
+#define COALESCE_KEYS 32	// keys taken at the most before a frame is drawn
+#define KEY_STATS 20		// ^T shows the counters in the status line
+int statsshown=0;
+char* statsfile=NULL;		// the counters go there at the exit
+int livesample=1;		// the process was read again, remember what is on screen
+unsigned char* livecur=NULL;	// the screen at the last sample
+file_position_t livecurpos;
+unsigned int livecurlen=0;
+unsigned char* liveprev=NULL;	// and at the one before, changes show against it
+file_position_t liveprevpos;
+unsigned int liveprevlen=0;
+struct mask diffmask;		// what the diff does not look at
+char masktext[64]="";
+struct dotplot plot;
+int plotfixed=0;		// 1: blocks of skipblocksize instead of content defined chunks
+file_position_t plota0,plota1,plotb0,plotb1;	// what the dotplot shows
+unsigned int plotrow=0;
+unsigned int plotcol=0;
+int64_t diffshift=0;		// the diffile's offset 0 is shown under this offset of the inputfile
+struct locate located;
+unsigned int locatesel=0;
+unsigned int locatetop=0;
+int scankey=ERR;		// typed while a panel scans, for the panel
+file_position_t sessionp=0;	// where the session puts the screen and the cursor back
+file_position_t sessioncp=0;
+int sessiondirty=0;		// keys were pressed since the session was written
+uint64_t sessionid[SESSION_ID];	// the inputfile as it was opened, for every save
+int sessionknown=0;
+uint64_t sessionsaved[12];	// sessionstamp() of the last save
+char restoredwhat[64];
+unsigned int viewcols=0;	// bytes per row, 0: as many as fit
+#define STRIDE_REGION 16777216	// the most a record size is looked for in
+#define STRIDE_NOMARK 1048576	// from the cursor on, without a selection
+struct hashdb knowndb;		// dhex --db: blocks of the reference images
+struct hashscan knownscan;
+char knownwhat[256];
+struct grep grepped;		// dhex --grep ... --open
+int uistarted=0;
+// as many bytes as fit in a row, or the record size, or the biggest part of
+// it that fits, so the records line up every few rows. a size with no such
+// part (a prime bigger than the screen) gets full rows, not tiny ones
+unsigned int rowwidth(unsigned int fit)
+{
+	unsigned int w;
+	if (viewcols==0 || fit==0) return fit;
+	for (w=(viewcols<fit)?viewcols:fit;viewcols%w;w--);
+	if (w*2<fit && w<viewcols) return fit;
+	return w;
+}
 char* tohex(char x)
 {
 	char ziffern[]={'0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F'};
@@ -58,73 +213,181 @@ char* tohex(char x)
 	return ch;	
 	
 }
+unsigned int readedited(file_position_t pos,unsigned char* buf,unsigned int len)
+{
+	return edit_read(inputfile,pos,buf,len);
+}
+int holeedited(file_position_t pos,file_position_t* start,file_position_t* end)
+{
+	return edit_hole(inputfile,pos,start,end);
+}
+unsigned int readfile1(file_position_t pos,unsigned char* buf,unsigned int len)
+{
+	return bfile_read(inputfile,pos,buf,len);
+}
+unsigned int readfile2(file_position_t pos,unsigned char* buf,unsigned int len)
+{
+	return bfile_read(inputfile2,pos,buf,len);
+}
+// the diffile as it lines up under the inputfile, only called for the overlap
+unsigned int readshifted(file_position_t pos,unsigned char* buf,unsigned int len)
+{
+	return bfile_read(inputfile2,pos-diffshift,buf,len);
+}
+// the part of the inputfile that has the diffile underneath
+void diffoverlap(file_position_t filesize1,file_position_t filesize2,file_position_t* lo,file_position_t* hi)
+{
+	*lo=(diffshift>0)?(file_position_t)diffshift:0;
+	*hi=filesize1;
+	if (diffshift<0 && filesize2<=(file_position_t)-diffshift) *hi=0;
+	else if ((int64_t)filesize2+diffshift<(int64_t)*hi) *hi=filesize2+diffshift;
+	if (*hi<*lo) *hi=*lo;
+}
 void print_pos(WINDOW *parent_window, file_position_t p,int y)
 {
-	mvwprintw(parent_window,y,0,"%10X",(unsigned long) p);	
+	mvwprintw(parent_window,y,0,"%*llX",poscols,(unsigned long long) p);	
 	
 }
-void print_hex(WINDOW *parent_window,file_position_t p,file_position_t cursorpos,file_position_t filesize,file_position_t rfilesize,int hexnotasc,int ch2)
+void print_hex(WINDOW *parent_window,file_position_t p,file_position_t cursorpos,file_position_t filesize,int hexnotasc,int ch2)
 {
 	unsigned char buffer[2];
+	unsigned char *window;
+	unsigned char *edited;
+	unsigned char *changed;
+	unsigned int wlen;
+	unsigned int elen;
+	unsigned char *block;
+	unsigned char *erased=NULL;
+	unsigned char *match=NULL;
+	unsigned int nblocks=0;
+	unsigned int n;
 	float f;
 	unsigned int i;
-	int j;
 	int x;
 	int y;
 	int c;
+	int hexfield;
+	int known;
+	int left=(poscols>10)?poscols+1:10;	// the wide offsets get a blank after them
 	file_position_t ap=p;
-	f=(float)COLS-10;
+	file_position_t src;
+	f=(float)COLS-left;
 	f=f/4.125;
-	cols=(int)f;
-	x=COLS-10-((int)((float)cols*4.125));
+	cols=rowwidth((int)f);
+	x=COLS-left-((int)((float)cols*4.125));
 	rows=LINES-2;
 	wattrset(parent_window,attrs[COLOR_BRACKETS]);
-	mvwprintw(parent_window,0,1,"[          /          ]");
+	mvwprintw(parent_window,0,1,"[%*s/%*s]",poscols,"",poscols,"");
 	wattrset(parent_window,attrs[COLOR_TEXT]);
-	mvwprintw(parent_window,0,2,"%10X",(unsigned long)cursorpos);	
-	mvwprintw(parent_window,0,13,"%10X",(unsigned long)(filesize-1));	
+	mvwprintw(parent_window,0,2,"%*llX",poscols,(unsigned long long)cursorpos);	
+	mvwprintw(parent_window,0,3+poscols,"%*llX",poscols,(unsigned long long)(filesize-1));	
 	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
-	fseek(inputfile,p,SEEK_SET);
+	window=malloc(rows*cols+2);
+	wlen=bfile_read(inputfile,p,window,rows*cols+(viewbits!=0));
+	if (viewbits)
+	{
+		// the byte after the last one shifts its bits in
+		if (wlen<=rows*cols) window[wlen]=0;
+		bits_shift(window,rows*cols,viewbits);
+		if (wlen>rows*cols) wlen=rows*cols;
+	}
+	if (inputfile->type==BFILE_PROCESS && livesample)
+	{
+		free(liveprev);
+		liveprev=livecur;
+		liveprevpos=livecurpos;
+		liveprevlen=livecurlen;
+		livecur=malloc(wlen+1);
+		memcpy(livecur,window,wlen);
+		livecurpos=p;
+		livecurlen=wlen;
+		livesample=0;
+	}
+	edited=malloc(rows*cols+2);
+	elen=readedited(p,edited,rows*cols+(viewbits!=0));
+	if (viewbits)
+	{
+		if (elen<=rows*cols) edited[elen]=0;
+		bits_shift(edited,rows*cols,viewbits);
+		if (elen>rows*cols) elen=rows*cols;
+	}
+	// what was typed or filled in, inserted bytes don't make the rest look changed
+	changed=malloc(rows*cols+1);
+	edit_changes(p,changed,rows*cols);
+	if (dimerased && skipblocksize)
+	{
+		nblocks=(p%skipblocksize+rows*cols)/skipblocksize+1;
+		erased=malloc(nblocks);
+		block=malloc(skipblocksize);
+		for (i=0;i<nblocks;i++)
+		{
+			n=readedited((p/skipblocksize+i)*skipblocksize,block,skipblocksize);
+			erased[i]=(n==skipblocksize && (block[0]==0x00 || block[0]==0xff) && runs_uniform(block,n));
+		}
+		free(block);
+	}
+	if (searchhits.num>0)
+	{
+		match=malloc(rows*cols);
+		if (hits_mark(&searchhits,p,rows*cols,match)==0)
+		{
+			free(match);
+			match=NULL;
+		}
+	}
 	for (y=1;y<LINES-1;y++)
 	{
 		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
 		print_pos(parent_window,p+(y-1)*cols,y);
 		for (i=0;i<cols;i++)
 		{
-			if (!feof(inputfile)) fgets(buffer,sizeof(buffer),inputfile);
-			c=buffer[0];
-			
-			if (chnum!=0) for (j=0;j<chnum;j++) if (ap==chpos[j]) c=change[j];
+			if (ap-p<wlen) buffer[0]=window[ap-p]; else buffer[0]=0;
+			if (ap-p<elen) c=edited[ap-p]; else c=buffer[0];
+			hexfield=COLOR_HEXFIELD;
+			if (erased!=NULL && erased[ap/skipblocksize-p/skipblocksize]) hexfield=COLOR_ERASED;
+			// the database knows the blocks of the input file, wherever
+			// inserting or deleting has moved their bytes to
+			if (knownscan.bf!=NULL && edit_source(ap,&src))
+			{
+				known=hashdb_state(&knownscan,src);
+				if (known==HASHDB_KNOWN) hexfield=COLOR_KNOWN;
+				if (known==HASHDB_NOVEL) hexfield=COLOR_NOVEL;
+			}
+			if (match!=NULL && match[ap-p]) hexfield=COLOR_MATCH;
+			if (liveprev!=NULL && ap>=liveprevpos && ap-liveprevpos<liveprevlen && ap-p<wlen && liveprev[ap-liveprevpos]!=window[ap-p]) hexfield=COLOR_DIFF;
+			if (marked && ((ap>=markpos && ap<=cursorpos) || (ap>=cursorpos && ap<=markpos))) hexfield=COLOR_SELECTION;
 			f=(float)i;
 			f=f*3.125;
 			if (ap==cursorpos && hexnotasc==1 && ap<=filesize) 
 			{
-				if (c==buffer[0]) wattrset(parent_window,attrs[COLOR_CURSOR]); else wattrset(parent_window,attrs[COLOR_DIFF_CURSOR]);
-				if (ap>=rfilesize) wattrset(parent_window,attrs[COLOR_DIFF_CURSOR]);
-
+				if (!changed[ap-p]) wattrset(parent_window,attrs[COLOR_CURSOR]); else wattrset(parent_window,attrs[COLOR_DIFF_CURSOR]);
 			} else {
-				if (c==buffer[0]) wattrset(parent_window,attrs[COLOR_HEXFIELD]); else wattrset(parent_window,attrs[COLOR_DIFF]);
-				if (ap>=rfilesize) wattrset(parent_window,attrs[COLOR_DIFF]);
+				if (!changed[ap-p]) wattrset(parent_window,attrs[hexfield]); else wattrset(parent_window,attrs[COLOR_DIFF]);
 			}
 			if (ch2==0 || ap!=cursorpos) 
-			if (ap<filesize) mvwprintw(parent_window,y,(int)f+10+x/2,"%s",tohex(c)); else mvwprintw(parent_window,y,(int)f+10+x/2,"  ");		 
+			if (ap<filesize) mvwprintw(parent_window,y,(int)f+left+x/2,"%s",tohex(c)); else mvwprintw(parent_window,y,(int)f+left+x/2,"  ");		 
 			else if (ch2!=0 && ap==cursorpos)
 			{
-				mvwprintw(parent_window,y,(int)f+10+x/2,"%c ",ch2);
+				mvwprintw(parent_window,y,(int)f+left+x/2,"%c ",ch2);
 			}
 			wattrset(parent_window,attrs[COLOR_HEXFIELD]);
-			mvwprintw(parent_window,y,(int)f+12+x/2," ");	
+			mvwprintw(parent_window,y,(int)f+left+2+x/2," ");	
 			if (ap==cursorpos && hexnotasc==0 && ap<=filesize) 
 			{
-				if (c==buffer[0]) wattrset(parent_window,attrs[COLOR_CURSOR]); else wattrset(parent_window,attrs[COLOR_DIFF_CURSOR]);
+				if (!changed[ap-p]) wattrset(parent_window,attrs[COLOR_CURSOR]); else wattrset(parent_window,attrs[COLOR_DIFF_CURSOR]);
 			} else {
-				if (c==buffer[0]) wattrset(parent_window,attrs[COLOR_HEXFIELD]); else wattrset(parent_window,attrs[COLOR_DIFF]);
+				if (!changed[ap-p]) wattrset(parent_window,attrs[hexfield]); else wattrset(parent_window,attrs[COLOR_DIFF]);
 			}
 			if (ap<filesize) if (c>=32 && c<=127) mvwprintw(parent_window,y,(int)i+(COLS-cols),"%c",(char)c);	else
 			mvwprintw(parent_window,y,(int)i+(COLS-cols),".");	else mvwprintw(parent_window,y,(int)i+(COLS-cols)," ");
 			ap++;
 		}
 	}
+	free(window);
+	free(edited);
+	free(changed);
+	free(erased);
+	free(match);
 	
 }
 void print_hex_diff( WINDOW *parent_window,
@@ -136,6 +399,14 @@ void print_hex_diff( WINDOW *parent_window,
 {
 	unsigned char buffer[2];
 	unsigned char buffer2[2];
+	unsigned char *window;
+	unsigned char *window2;
+	unsigned char *keep;
+	unsigned int skip2=0;		// where the diffile begins in window2
+	int in2;
+	char shifted[64];
+	unsigned int wlen;
+	unsigned int wlen2;
 	float f;
 	unsigned int i;
 	int x;
@@ -144,7 +415,7 @@ void print_hex_diff( WINDOW *parent_window,
 	file_position_t ap=p;
 	f=(float)COLS-10;
 	f=f/4.125;
-	cols=(int)f;
+	cols=rowwidth((int)f);
 	x=COLS-10-((int)((float)cols*4.125));
 	rows=LINES-2;
 	b=(LINES-1)/2;
@@ -155,20 +426,37 @@ void print_hex_diff( WINDOW *parent_window,
 	wattrset(parent_window,attrs[COLOR_TEXT]);
 	mvwprintw(parent_window,0,2,"%10X",(unsigned long)cursorpos);	
 	mvwprintw(parent_window,0,13,"%10X",(unsigned long)(filesize1-1));	
-	mvwprintw(parent_window,b,2,"%10X",(unsigned long)cursorpos);	
+	if ((int64_t)cursorpos>=diffshift) mvwprintw(parent_window,b,2,"%10llX",(unsigned long long)(cursorpos-diffshift));
 	mvwprintw(parent_window,b,13,"%10X",(unsigned long)(filesize2-1));	
 	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
-	fseek(inputfile,p,SEEK_SET);
-	fseek(inputfile2,p,SEEK_SET);
+	window=malloc(b*cols+1);
+	window2=malloc(b*cols+1);
+	wlen=bfile_read(inputfile,p,window,b*cols);
+	if ((int64_t)p>=diffshift) wlen2=bfile_read(inputfile2,p-diffshift,window2,b*cols);
+	else
+	{
+		// the diffile begins further down
+		skip2=(diffshift-(int64_t)p<b*cols)?diffshift-p:b*cols;
+		wlen2=skip2+bfile_read(inputfile2,0,window2+skip2,b*cols-skip2);
+	}
+	if (diffshift!=0)
+	{
+		sprintf(shifted,"at %c%llX",(diffshift<0)?'-':'+',(unsigned long long)((diffshift<0)?-diffshift:diffshift));
+		headline(parent_window,b,26,shifted);
+	}
+	keep=malloc(b*cols+1);
+	mask_build(&diffmask,p,keep,b*cols);
 	for (y=1;y<b;y++)
 	{
 		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
 		print_pos(parent_window,p+(y-1)*cols,y);
-		print_pos(parent_window,p+(y-1)*cols,y+b);
+		if ((int64_t)(p+(y-1)*cols)>=diffshift) print_pos(parent_window,p+(y-1)*cols-diffshift,y+b);
+		else mvwprintw(parent_window,y+b,0,"%10s","");
 		for (i=0;i<cols;i++)
 		{
-			if (!feof(inputfile)) fgets(buffer,sizeof(buffer),inputfile);
-			if (!feof(inputfile2)) fgets(buffer2,sizeof(buffer2),inputfile2);
+			if (ap-p<wlen) buffer[0]=window[ap-p]; else buffer[0]=0;
+			if (ap-p<wlen2) buffer2[0]=window2[ap-p]; else buffer2[0]=0;
+			in2=(ap-p>=skip2 && (int64_t)ap-diffshift<(int64_t)filesize2);
 			// TODO: find a nice and satisfactional way to edit two files at once!
 /*
 			c=buffer[0];
@@ -205,11 +493,12 @@ void print_hex_diff( WINDOW *parent_window,
 			
 			f=(float)i;
 			f=f*3.125;
-			if (buffer[0]!=buffer2[0] || ap>=filesize1 || ap>=filesize2) wattrset(parent_window,attrs[COLOR_DIFF]); else wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+			if (buffer[0]!=buffer2[0] || ap>=filesize1 || !in2) wattrset(parent_window,attrs[COLOR_DIFF]); else wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+			if (keep[ap-p]==0) wattrset(parent_window,attrs[COLOR_ERASED]);
 			if (ap<filesize1) mvwprintw(parent_window,y,(int)f+10+x/2,"%s",tohex(buffer[0])); else mvwprintw(parent_window,y,(int)f+10+x/2,"  ");
-			if (ap<filesize2) mvwprintw(parent_window,y+b,(int)f+10+x/2,"%s",tohex(buffer2[0])); else mvwprintw(parent_window,y+b,(int)f+10+x/2,"  ");
+			if (in2) mvwprintw(parent_window,y+b,(int)f+10+x/2,"%s",tohex(buffer2[0])); else mvwprintw(parent_window,y+b,(int)f+10+x/2,"  ");
 			if (ap<filesize1) if (buffer[0]>=32 && buffer[0]<=127) mvwprintw(parent_window,y,(int)i+(COLS-cols),"%c",(char)buffer[0]); else mvwprintw(parent_window,y,(int)i+(COLS-cols),".");      else mvwprintw(parent_window,y,(int)i+(COLS-cols)," ");
-			if (ap<filesize2) if (buffer2[0]>=32 && buffer2[0]<=127) mvwprintw(parent_window,y+b,(int)i+(COLS-cols),"%c",(char)buffer2[0]); else mvwprintw(parent_window,y+b,(int)i+(COLS-cols),".");      else mvwprintw(parent_window,y+b,(int)i+(COLS-cols)," ");
+			if (in2) if (buffer2[0]>=32 && buffer2[0]<=127) mvwprintw(parent_window,y+b,(int)i+(COLS-cols),"%c",(char)buffer2[0]); else mvwprintw(parent_window,y+b,(int)i+(COLS-cols),".");      else mvwprintw(parent_window,y+b,(int)i+(COLS-cols)," ");
 			wattrset(parent_window,attrs[COLOR_HEXFIELD]);
 			mvwprintw(parent_window,y,(int)f+12+x/2," ");
 			mvwprintw(parent_window,y+b,(int)f+12+x/2," ");
@@ -217,6 +506,9 @@ void print_hex_diff( WINDOW *parent_window,
 			
 		}
 	}
+	free(window);
+	free(window2);
+	free(keep);
 	wrefresh(parent_window);
 	
 }
@@ -411,11 +703,11 @@ void draw_menu(WINDOW* parent_window)
 	mvwprintw(parent_window,LINES-1,1 ,"Search ");
 	mvwprintw(parent_window,LINES-1,9 ,"Goto   ");
 	mvwprintw(parent_window,LINES-1,17,"HexCalc");
-	mvwprintw(parent_window,LINES-1,25,"       "); 
+	mvwprintw(parent_window,LINES-1,25,"Special"); 
 	mvwprintw(parent_window,LINES-1,33,"Next   ");
 	mvwprintw(parent_window,LINES-1,41,"Previou");
-	mvwprintw(parent_window,LINES-1,49,"       "); 
-	mvwprintw(parent_window,LINES-1,57,"       "); 
+	mvwprintw(parent_window,LINES-1,49,"NextBlk"); 
+	mvwprintw(parent_window,LINES-1,57,"PrevBlk"); 
 	mvwprintw(parent_window,LINES-1,65,"UnDo   ");
 	mvwprintw(parent_window,LINES-1,73,"Exit   ");
 	wattrset(parent_window,attrs[COLOR_MENU_HOTKEY]);
@@ -431,13 +723,184 @@ void draw_menu(WINDOW* parent_window)
 	mvwprintw(parent_window,LINES-1,72,"0");
 	
 }
+// right of the function keys if there is room, over them if not
+void draw_stats(WINDOW* parent_window)
+{
+	char s[160];
+	int x=81;
+	int w;
+	stats_line(s,sizeof(s));
+	if (COLS-x<(int)strlen(s)) x=0;
+	w=COLS-x;
+	if (w<80 && x==0) w=80;
+	wattrset(parent_window,attrs[COLOR_MENU]);
+	mvwprintw(parent_window,LINES-1,x,"%-*.*s",w,w,s);
+}
+void statsexit(void)
+{
+	stats_dump(statsfile);
+}
+// the same name, or another name for the same file
+int samefile(const char* a,const char* b)
+{
+	struct stat sa;
+	struct stat sb;
+	if (a==NULL || b==NULL) return 0;
+	if (strcmp(a,b)==0) return 1;
+	return stat(a,&sa)==0 && stat(b,&sb)==0 && sa.st_dev==sb.st_dev && sa.st_ino==sb.st_ino;
+}
+void sessionstring(FILE* f,const char* t)
+{
+	uint64_t len=strlen(t);
+	fwrite(&len,sizeof(len),1,f);
+	fwrite(t,1,len,f);
+}
+char* sessionreadstring(FILE* f,unsigned int max)
+{
+	uint64_t len;
+	char* t;
+	if (fread(&len,sizeof(len),1,f)!=1 || len>max) return NULL;
+	t=malloc(len+1);
+	if (fread(t,1,len,f)!=len)
+	{
+		free(t);
+		return NULL;
+	}
+	t[len]=0;
+	return t;
+}
+uint64_t sessionhash(uint64_t h,const void* p,unsigned int len)
+{
+	unsigned int i;
+	for (i=0;i<len;i++) h=(h^((const unsigned char*)p)[i])*1099511628211ULL;
+	return h;
+}
+// everything the session keeps, in short: what changed since the last save?
+void sessionstamp(uint64_t* v)
+{
+	v[0]=sessionp;
+	v[1]=sessioncp;
+	v[2]=marked;
+	v[3]=markpos;
+	v[4]=edit_serial();
+	v[5]=searchregex;
+	v[6]=searchmismatches;
+	v[7]=sessionhash(sessionhash(sessionhash(14695981039346656037ULL,searchstring,strlen(searchstring)),
+		regexstring,strlen(regexstring)),searchstring3,searchstring3len*sizeof(int));
+	v[8]=(strs.bf!=NULL && !strs.running)?strs.num+1:0;
+	v[9]=strs.start;
+	v[10]=strs.end;
+	v[11]=strs.minlen;
+}
+int sessionchanged()
+{
+	uint64_t v[12];
+	sessionstamp(v);
+	return memcmp(v,sessionsaved,sizeof(v))!=0;
+}
+// the cursor and the search always go into the session, the unsaved changes
+// and the strings list only when asked to
+void sessionsave(int edits,int indexes)
+{
+	struct session s;
+	uint64_t v[6];
+	if (!sessionknown || !session_create(&s,inputfile,sessionid)) return;
+	session_begin(&s,"CURS");
+	v[0]=sessionp;
+	v[1]=sessioncp;
+	v[2]=marked;
+	v[3]=markpos;
+	fwrite(v,sizeof(uint64_t),4,s.f);
+	session_end(&s);
+	session_begin(&s,"SRCH");
+	sessionstring(s.f,searchstring);
+	sessionstring(s.f,regexstring);
+	v[0]=searchregex;
+	v[1]=searchmismatches;
+	v[2]=searchstring3len;
+	fwrite(v,sizeof(uint64_t),3,s.f);
+	fwrite(searchstring3,sizeof(int),searchstring3len,s.f);
+	session_end(&s);
+	if (edits && edit_changed())
+	{
+		session_begin(&s,"EDIT");
+		edit_dump(s.f);
+		session_end(&s);
+	}
+	if (indexes && strs.bf!=NULL && !strs.running)
+	{
+		session_begin(&s,"STRS");
+		extract_dump(&strs,s.f);
+		session_end(&s);
+	}
+	if (session_commit(&s)) sessionstamp(sessionsaved);
+}
+// the changes and the strings list only come back if the file is the same
+void sessionload(file_position_t* p,file_position_t* cp)
+{
+	struct session s;
+	uint64_t v[4];
+	uint64_t len;
+	char* t;
+	sessionknown=session_identity(inputfile,sessionid);
+	if (!sessionknown || !session_open(&s,inputfile,sessionid)) return;
+	if (s.same && session_find(&s,"EDIT",&len) && edit_load(s.f))
+	{
+		snprintf(restoredwhat,sizeof(restoredwhat),"%d unsaved changes restored",edit_changed());
+		foundwhat=restoredwhat;
+	}
+	if (p!=NULL && session_find(&s,"CURS",&len) && fread(v,sizeof(uint64_t),4,s.f)==4)
+	{
+		*p=(v[0]<=edit_size())?v[0]:0;
+		*cp=(v[1]<=edit_size())?v[1]:*p;
+		marked=(v[2] && v[3]<=edit_size());
+		markpos=v[3];
+	}
+	if (session_find(&s,"SRCH",&len))
+	{
+		if ((t=sessionreadstring(s.f,254))!=NULL)
+		{
+			free(searchstring);
+			searchstring=t;
+		}
+		if ((t=sessionreadstring(s.f,4096))!=NULL)
+		{
+			free(regexstring);
+			regexstring=t;
+		}
+		if (fread(v,sizeof(uint64_t),3,s.f)==3 && v[2]<=255 && fread(searchstring3,sizeof(int),v[2],s.f)==v[2])
+		{
+			searchregex=(v[0]!=0);
+			searchmismatches=v[1];
+			searchstring3len=v[2];
+		}
+	}
+	if (s.same && session_find(&s,"STRS",&len) && extract_load(&strs,inputfile,s.f)) stringsminlen=strs.minlen;
+	session_close(&s);
+}
+int savechanges(char* filename)
+{
+	char* name;
+	int r;
+	if (inputfile->type==BFILE_PLAIN) return edit_save(inputfile,filename);
+	if (inputfile->type==BFILE_PROCESS) return 0;	// nothing is written into a running process
+	// compressed input can't be patched in place: write it out uncompressed,
+	// next to it, without the .gz/.zst suffix (or with .dhex if that exists)
+	name=malloc(strlen(filename)+6);
+	strncpy(name,filename,strlen(filename)+1);
+	if (strrchr(name,'.')!=NULL && strrchr(name,'/')<strrchr(name,'.')) *strrchr(name,'.')=0;
+	if (access(name,F_OK)==0) sprintf(name,"%s.dhex",filename);
+	r=edit_save(inputfile,name);
+	free(name);
+	return r;
+}
 void exit_yesno(WINDOW* parent_window,char* filename)
 {
 	int wtop;
 	int wbot;
 	int wleft;
 	int wright;
-	int m,i;
+	int m;
 	wtop=LINES/2-2;
 	wbot=wtop+4;
 	wleft=COLS/2-16;
@@ -455,18 +918,23 @@ void exit_yesno(WINDOW* parent_window,char* filename)
 		mvwprintw(parent_window,wtop+1,wleft+1,"Do you want to save the changes?");	
 		headline(parent_window,wtop,wleft,"EXIT");
 		m=menu_show(parent_window);
-		if (m==2) finish(0);
+		if (m==2)
+		{
+			sessionsave(0,1);
+			finish(0);
+		}
 		if (m==1) 
 		{
-			fclose(inputfile);
-			inputfile=fopen(filename,"r+");
-			for (i=0;i<chnum;i++)
+			if (savechanges(filename))
 			{
-				fseek(inputfile,chpos[i],SEEK_SET);
-				fprintf(inputfile,"%c",change[i]);
+				// the file is another one now
+				sessionknown=session_identity(inputfile,sessionid);
+				sessionsave(0,0);
+				finish(0);
 			}
-			fclose(inputfile);	
-			finish(0);
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			mvwprintw(parent_window,wtop+2,wleft+1,"Could not write the file!");
+			getch2();
 		}
 		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
 		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
@@ -518,6 +986,137 @@ void kmpPreprocesshexback()
 		kmpback[i]=j;
 	}	
 }
+// what a scan collected in searchresults stays highlighted
+void keephits()
+{
+	hits_build(&searchhits,&searchresults);
+	results_clear(&searchresults);
+	hitsfile[0]=0;
+	showncut=0;
+}
+// the hits in a result file are highlighted while it is searched through.
+// it is read again only when it is another one or was changed
+void loadhits(const char* filename,file_position_t len)
+{
+	struct stat st;
+	if (stat(filename,&st)!=0) return;
+	if (strcmp(hitsfile,filename)==0 && st.st_mtime==hitsmtime) return;
+	results_clear(&searchresults);
+	results_read(&searchresults,filename,len);
+	keephits();
+	strncpy(hitsfile,filename,sizeof(hitsfile)-1);
+	hitsmtime=st.st_mtime;
+}
+// the part of [pos,filesize) a search should look at next: for a running
+// process that is one mapping, a file is searched in one go
+file_position_t searchrange(file_position_t pos,file_position_t filesize,file_position_t* end)
+{
+	file_position_t s;
+	*end=filesize;
+	if (inputfile->type!=BFILE_PROCESS || pos>=filesize) return pos;
+	s=bfile_nextdata(inputfile,pos,end);
+	if (*end>filesize) *end=filesize;
+	if (s>filesize) return filesize;
+	return (s>pos)?s:pos;
+}
+// a plain search (no result file, the search menu's string or regex) stops
+// at the first match; the others around the screen go into searchhits, from
+// what it looked for. on=0 forgets it
+void showsearch(int on)
+{
+	const char* error;
+	unsigned int i;
+	bregex_free(shownre);
+	shownre=NULL;
+	shownlen=0;
+	shownlo=0;
+	shownhi=0;
+	showncut=0;
+	if (!on) return;
+	if (searchregex==1)
+	{
+		shownre=bregex_compile(regexstring,&error);
+		return;
+	}
+	if (searchmismatches>=searchstring2len) return;
+	// the search never matches a nibble wildcard (or a negative char)
+	for (i=0;i<searchstring2len;i++) if (searchstring2[i]<0 || searchstring2[i]>255) return;
+	for (i=0;i<searchstring2len;i++) shownpat[i]=searchstring2[i];
+	shownlen=searchstring2len;
+	shownk=searchmismatches;
+}
+int shownhit(file_position_t pos,unsigned int dist)
+{
+	results_add(&searchresults,pos,shownlen,dist);
+	return searchresults.num>=SHOWN_MAXHITS;
+}
+// the matches of the plain search that start in [lo,hi) become searchhits.
+// a regex match may run on up to SHOWN_REACH past hi. progress (or NULL)
+// is asked every SHOWN_CHUNK and stops it. 1 if all of them were found
+int findshown(file_position_t lo,file_position_t hi,int (*progress)(file_position_t done,file_position_t total))
+{
+	file_position_t size=edit_size();
+	file_position_t s;
+	file_position_t e;
+	file_position_t c;
+	file_position_t n;
+	file_position_t from;
+	file_position_t a;
+	file_position_t b;
+	int stop=0;
+	// the regex keeps the bytes it read last, they may be edited now
+	if (shownre!=NULL && shownserial!=edit_serial()) bregex_forget(shownre);
+	shownserial=edit_serial();
+	results_clear(&searchresults);
+	for (s=searchrange(lo,hi,&e);s<hi && !stop;s=searchrange(e,hi,&e))
+	{
+		from=s;
+		for (c=s;c<e && !stop;c=n)
+		{
+			n=(e-c>SHOWN_CHUNK)?c+SHOWN_CHUNK:e;
+			if (shownre==NULL) stop=approx_search(readedited,shownpat,shownlen,shownk,c,(n+shownlen-1<size)?n+shownlen-1:size,shownhit);
+			else
+			{
+				if (from<c) from=c;
+				while (!stop && from<n && bregex_search(shownre,readedited,from,(n+SHOWN_REACH<size)?n+SHOWN_REACH:size,&a,&b) && a<n)
+				{
+					results_add(&searchresults,a,b-a,0);
+					from=(b>a)?b:a+1;
+					stop=(searchresults.num>=SHOWN_MAXHITS);
+				}
+			}
+			if (!stop && progress!=NULL && progress(n-lo,hi-lo)) stop=1;
+		}
+	}
+	keephits();
+	return !stop;
+}
+// the hits of the plain search around the screen at p: only looked for
+// again when the screen gets near the edge of them or the bytes changed
+void showhits(file_position_t p,unsigned int len)
+{
+	file_position_t size=edit_size();
+	if (shownlen==0 && shownre==NULL) return;
+	if (shownserial==edit_serial() && shownhi>shownlo
+		&& (shownlo==0 || p>=shownlo+SHOWN_REACH) && (shownhi==size || p+len+SHOWN_REACH<=shownhi)) return;
+	shownlo=(p>2*SHOWN_REACH)?p-2*SHOWN_REACH:0;
+	shownhi=(p+len+2*SHOWN_REACH<size)?p+len+2*SHOWN_REACH:size;
+	findshown(shownlo,shownhi,NULL);
+}
+// the results panel wants all of them: the whole file is searched once,
+// unless that was stopped or found too many
+void collectshown(int (*progress)(file_position_t done,file_position_t total))
+{
+	if (findshown(0,edit_size(),progress))
+	{
+		shownlo=0;
+		shownhi=edit_size();
+		return;
+	}
+	showncut=1;
+	shownlo=0;
+	shownhi=0;
+}
 file_position_t searchforwardhex( file_position_t cursorpos,
 	                              file_position_t filesize)
 {
@@ -526,7 +1125,7 @@ file_position_t searchforwardhex( file_position_t cursorpos,
 	file_position_t cp=cursorpos;
 	file_position_t ocp=cursorpos;
 	file_position_t t = 0;
-	int i=0;
+	file_position_t e = 0;
 	int j=0;
 	int k=sizeof(buffer);
 	kmpPreprocesshex();
@@ -537,19 +1136,20 @@ file_position_t searchforwardhex( file_position_t cursorpos,
 		cp=0;
 		ocp=0;
 	}
-	fseek(inputfile,cp,0);
 	while (cp<filesize)
 	{
+		if (cp>=e)
+		{
+			// on to the next mapping, nothing matches across the gap
+			cp=searchrange(cp,filesize,&e);
+			j=0;
+			k=sizeof(buffer);
+			continue;
+		}
 		if (k==sizeof(buffer)) 
 		{
-			if (!feof(inputfile)) fread(buffer,sizeof(buffer),1,inputfile);
-			for (i=0;i<chnum;i++)
-			{
-				if (chpos[i]>=ocp && chpos[i]<=ocp+sizeof(buffer))
-				{
-					buffer[chpos[i]-ocp]=change[i];
-				}
-			}
+			memset(buffer,0,sizeof(buffer));
+			readedited(cp,buffer,sizeof(buffer));
 			ocp=cp;
 			k=0;
 		}
@@ -566,6 +1166,7 @@ file_position_t searchforwardhex( file_position_t cursorpos,
 					   ((int)((t>>32)&65535)),
 					   ((int)((t>>16)&65535)),
 					   ((int)(t&65535)));
+			  results_add(&searchresults,t,searchstring2len,0);
 			} else {
 				return t;
 			}
@@ -573,9 +1174,255 @@ file_position_t searchforwardhex( file_position_t cursorpos,
 			j=kmp[j];
 		}
 	}
-	if (writesearch==1) fclose(writesearchfile);
+	if (writesearch==1)
+	{
+		fclose(writesearchfile);
+		keephits();
+	}
+	return cursorpos;
+}
+file_position_t searchforwardregex(file_position_t cursorpos,file_position_t filesize)
+{
+	FILE *writesearchfile = NULL;
+	file_position_t cp=cursorpos;
+	file_position_t start;
+	file_position_t stop;
+	file_position_t e;
+	if (writesearch==1) 
+	{
+		writesearchfile=fopen(writesearchfilename,"w");
+		fprintf(writesearchfile,"#DHEXSEARCHFILE\n#VERSION 0\n");
+		cp=0;
+	}
+	e=cp;
+	while (cp<filesize)
+	{
+		if (cp>=e)
+		{
+			cp=searchrange(cp,filesize,&e);
+			continue;
+		}
+		if (!bregex_search(searchre,readedited,cp,e,&start,&stop))
+		{
+			cp=e;
+			continue;
+		}
+		if (writesearch==0) return start;
+		fprintf(writesearchfile,"%04X%04X%04X%04X\n",((int)((start>>48)&65535)),((int)((start>>32)&65535)),((int)((start>>16)&65535)),((int)(start&65535)));
+		results_add(&searchresults,start,stop-start,0);
+		cp=stop;
+	}
+	if (writesearch==1)
+	{
+		fclose(writesearchfile);
+		keephits();
+	}
+	return cursorpos;
+}
+int approxfirst(file_position_t pos,unsigned int dist)
+{
+	approxhit=pos;
+	return 1;
+}
+int approxcollect(file_position_t pos,unsigned int dist)
+{
+	results_add(&searchresults,pos,searchstring2len,dist);
+	return 0;
+}
+const char* distancename(unsigned int tag)
+{
+	static char s[32];
+	sprintf(s,"DISTANCE %u",tag);
+	return s;
+}
+// like searchforwardhex(), but with up to searchmismatches bytes different.
+// the result file has the closest matches first
+file_position_t searchforwardapprox(file_position_t cursorpos,file_position_t filesize)
+{
+	unsigned char pat[255];
+	unsigned int i;
+	file_position_t s;
+	file_position_t e;
+	for (i=0;i<searchstring2len;i++) pat[i]=searchstring2[i];
+	if (writesearch==1)
+	{
+		results_clear(&searchresults);
+		for (s=searchrange(0,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+			approx_search(readedited,pat,searchstring2len,searchmismatches,s,e,approxcollect);
+		results_rank(&searchresults);
+		results_write(&searchresults,writesearchfilename,distancename);
+		keephits();
+		return cursorpos;
+	}
+	for (s=searchrange(cursorpos,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+		if (approx_search(readedited,pat,searchstring2len,searchmismatches,s,e,approxfirst)) return approxhit;
+	return cursorpos;
+}
+int valuefirst(file_position_t pos,unsigned int which)
+{
+	valuehit=pos;
+	valuewhich=which;
+	return 1;
+}
+int valuecollect(file_position_t pos,unsigned int which)
+{
+	results_add(&searchresults,pos,searchvalues.range?4:searchvalues.patlen[which],which);
+	return 0;
+}
+const char* valuename(unsigned int tag)
+{
+	return searchvalues.name[tag];
+}
+// the next place the value is stored at, in whichever encoding
+file_position_t searchforwardvalue(file_position_t cursorpos,file_position_t filesize)
+{
+	file_position_t s;
+	file_position_t e;
+	if (writesearch==1)
+	{
+		results_clear(&searchresults);
+		for (s=searchrange(0,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+			values_search(&searchvalues,readedited,s,e,valuecollect);
+		results_rank(&searchresults);
+		results_write(&searchresults,writesearchfilename,valuename);
+		keephits();
+		return cursorpos;
+	}
+	for (s=searchrange(cursorpos,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+	if (values_search(&searchvalues,readedited,s,e,valuefirst))
+	{
+		foundwhat=searchvalues.name[valuewhich];
+		return valuehit;
+	}
+	return cursorpos;
+}
+int bitsfirst(file_position_t bitpos)
+{
+	if (bitpos<bitfrom) return 0;
+	bithit=bitpos;
+	return 1;
+}
+int bitscollect(file_position_t bitpos)
+{
+	results_add(&searchresults,bitpos/8,(bitpos%8+searchbits.nbits+7)/8,bitpos%8);
+	return 0;
+}
+const char* bitname(unsigned int tag)
+{
+	static char s[32];
+	sprintf(s,"BIT %u",tag);
+	return s;
+}
+// the next place the bit pattern starts at, on from the bit after the last
+// hit when the cursor is still on it. the view shifts to line it up
+file_position_t searchforwardbits(file_position_t cursorpos,file_position_t filesize)
+{
+	file_position_t s;
+	file_position_t e;
+	if (writesearch==1)
+	{
+		results_clear(&searchresults);
+		for (s=searchrange(0,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+			bits_search(&searchbits,readedited,s,e,bitscollect);
+		results_write(&searchresults,writesearchfilename,bitname);
+		keephits();
+		return cursorpos;
+	}
+	bitfrom=cursorpos*8;
+	if (bithit!=(file_position_t)-1 && bithit/8==cursorpos) bitfrom=bithit+1;
+	for (s=searchrange(cursorpos,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+	if (bits_search(&searchbits,readedited,s,e,bitsfirst))
+	{
+		viewbits=bithit%8;
+		snprintf(bitwhat,sizeof(bitwhat),"BIT %u, BIT OFFSET %llX",(unsigned int)(bithit%8),(unsigned long long)bithit);
+		foundwhat=bitwhat;
+		return bithit/8;
+	}
+	return cursorpos;
+}
+int xformfirst(file_position_t pos,unsigned int which,const unsigned char* key)
+{
+	valuehit=pos;
+	xform_name(&searchxform,which,key,xformwhat);
+	return 1;
+}
+int xformcollect(file_position_t pos,unsigned int which,const unsigned char* key)
+{
+	struct xformkey* k=(nxformkeys>0)?xformkeys+nxformkeys-1:NULL;
+	if (k==NULL || k->which!=which || memcmp(k->key,key,XFORM_MAXPERIOD)!=0)
+	{
+		if (nxformkeys==maxxformkeys)
+		{
+			maxxformkeys=maxxformkeys?maxxformkeys*2:256;
+			xformkeys=realloc(xformkeys,maxxformkeys*sizeof(struct xformkey));
+		}
+		k=xformkeys+nxformkeys++;
+		k->which=which;
+		memcpy(k->key,key,XFORM_MAXPERIOD);
+	}
+	results_add(&searchresults,pos,searchxform.len,nxformkeys-1);
+	return 0;
+}
+const char* xformname(unsigned int tag)
+{
+	xform_name(&searchxform,xformkeys[tag].which,xformkeys[tag].key,xformwhat);
+	return xformwhat;
+}
+// the next place the plaintext is stored at, under whatever key
+file_position_t searchforwardxform(file_position_t cursorpos,file_position_t filesize)
+{
+	file_position_t s;
+	file_position_t e;
+	if (writesearch==1)
+	{
+		results_clear(&searchresults);
+		nxformkeys=0;
+		for (s=searchrange(0,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+			xform_search(&searchxform,readedited,s,e,xformcollect);
+		results_write(&searchresults,writesearchfilename,xformname);
+		keephits();
+		return cursorpos;
+	}
+	for (s=searchrange(cursorpos,filesize,&e);s<filesize;s=searchrange(e,filesize,&e))
+	if (xform_search(&searchxform,readedited,s,e,xformfirst))
+	{
+		foundwhat=xformwhat;
+		return valuehit;
+	}
 	return cursorpos;
 }
+unsigned int narrowreadold(file_position_t pos,unsigned char* buf,unsigned int len)
+{
+	if (narrowold==NULL) return readedited(pos,buf,len);
+	return bfile_read(narrowold,pos,buf,len);
+}
+unsigned int narrowreadnew(file_position_t pos,unsigned char* buf,unsigned int len)
+{
+	return bfile_read(narrownew,pos,buf,len);
+}
+// the next candidate left by narrowing down
+file_position_t searchforwardnarrow(file_position_t cursorpos)
+{
+	FILE *writesearchfile = NULL;
+	file_position_t t;
+	if (writesearch==1)
+	{
+		writesearchfile=fopen(writesearchfilename,"w");
+		if (writesearchfile==NULL) return cursorpos;
+		fprintf(writesearchfile,"#DHEXSEARCHFILE\n#VERSION 0\n");
+		t=0;
+		while ((t=narrow_next(&candidates,t,(file_position_t)-1))!=(file_position_t)-1)
+		{
+			fprintf(writesearchfile,"%04X%04X%04X%04X\n",((int)((t>>48)&65535)),((int)((t>>32)&65535)),((int)((t>>16)&65535)),((int)(t&65535)));
+			results_add(&searchresults,t,narrowwidth,0);
+			t++;
+		}
+		fclose(writesearchfile);
+		keephits();
+		return cursorpos;
+	}
+	return narrow_next(&candidates,cursorpos,cursorpos);
+}
 file_position_t searchbackwardhex(file_position_t cursorpos,file_position_t filesize,int hexnotasc)
 {
   /* remove me */ filesize = 0;
@@ -600,7 +1447,8 @@ file_position_t searchforwardhex2(file_position_t cursorpos)
 	int mismatch;
 
 	if (obenanfangen==1 || writesearch==1 || cursorpos==0) readsearchfile=fopen(readsearchfilename,"r");
-	obenanfangen=0;	
+	obenanfangen=0;
+	if (writesearch==0) loadhits(readsearchfilename,(searchre!=NULL)?1:searchstring2len);	
 	if (writesearch==1) 
 	{
 		writesearchfile=fopen(writesearchfilename,"w");
@@ -612,19 +1460,33 @@ file_position_t searchforwardhex2(file_position_t cursorpos)
 		if (p[0]!='#')
 		{
 			cp=stohex(p);
-			fseek(inputfile,cp,SEEK_SET);
-			fread(buffer,sizeof(buffer),1,inputfile);
+			memset(buffer,0,sizeof(buffer));
+			readedited(cp,buffer,sizeof(buffer));
 			mismatch=0;
-			for (i=0;mismatch==0 && i<searchstring2len;i++) if (buffer[i]!=searchstring2[i]) mismatch=1;
+			if (searchre!=NULL) mismatch=!bregex_matchat(searchre,readedited,cp,edit_size());
+			else if (searchmismatches>0)
+			{
+				for (i=0;i<searchstring2len;i++) if (buffer[i]!=(searchstring2[i]&255)) mismatch++;
+				mismatch=(mismatch>(int)searchmismatches);
+			}
+			else for (i=0;mismatch==0 && i<searchstring2len;i++) if (buffer[i]!=searchstring2[i]) mismatch=1;
 			if (mismatch==0 && cp!=ocp)
 			{
 				ocp=cp;
-				if (writesearch==1) fprintf(writesearchfile,"%04X%04X%04X%04X\n",((int)((cp>>48)&65535)),((int)((cp>>32)&65535)),((int)((cp>>16)&65535)),((int)(cp&65535))); 
+				if (writesearch==1)
+				{
+					fprintf(writesearchfile,"%04X%04X%04X%04X\n",((int)((cp>>48)&65535)),((int)((cp>>32)&65535)),((int)((cp>>16)&65535)),((int)(cp&65535))); 
+					results_add(&searchresults,cp,(searchre!=NULL)?1:searchstring2len,0);
+				}
 				else return cp;
 			}
 		}
 	}
-	if (writesearch==1) fclose(writesearchfile);
+	if (writesearch==1)
+	{
+		fclose(writesearchfile);
+		keephits();
+	}
 	if (feof(readsearchfile)) 
 	{
 		fclose(readsearchfile);	
@@ -645,6 +1507,7 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 	int cursor;
 	unsigned int offset;
 	int doit=0;
+	const char* error;
 	wtop=LINES/2-6;
 	wbot=wtop+12;
 	wleft=COLS/2-16;
@@ -655,27 +1518,39 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 	if(hexnotasc==1)
 	menu_item(0,wtop+1,wleft+1,"%%Searchstring (Hex)",'s','S',0);
 	else menu_item(0,wtop+1,wleft+1,"%%Searchstring (Asc)",'s','S',0);
-	menu_item(1,wtop+4,wleft+1,"Search %Forward",'f','F',0);
-	menu_item(2,wtop+5,wleft+1,"Search %Backwards",'b','B',0);
-	menu_item(3,wtop+6,wleft+5,"%Write Result to file",'w','W',0);
-	menu_item(4,wtop+7,wleft+1," ",0,0,0);
-	menu_item(5,wtop+8,wleft+5,"%Read Searchpos. from file",'r','R',0);
-	menu_item(6,wtop+9,wleft+1," ",0,0,0);
-	menu_item(7,wtop+11,wleft+1,"%%Cancel",0,0,0);
+	menu_item(1,wtop+3,wleft+5,"Rege%x",'x','X',0);
+	menu_item(2,wtop+3,wleft+13,"%Mismatches",'m','M',0);
+	menu_item(3,wtop+4,wleft+1,"Search %Forward",'f','F',0);
+	menu_item(4,wtop+5,wleft+1,"Search %Backwards",'b','B',0);
+	menu_item(5,wtop+6,wleft+5,"%Write Result to file",'w','W',0);
+	menu_item(6,wtop+7,wleft+1," ",0,0,0);
+	menu_item(7,wtop+8,wleft+5,"%Read Searchpos. from file",'r','R',0);
+	menu_item(8,wtop+9,wleft+1," ",0,0,0);
+	menu_item(9,wtop+11,wleft+1,"%%Cancel",0,0,0);
 
 	if (LINES>10 && COLS>32)
 	{
 		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
-		if (hexnotasc==1) headline(parent_window,wtop,wleft,"SEARCH HEXSTRING"); else headline(parent_window,wtop,wleft,"SEARCH ASCIISTRING");
-		while (m!=1 && m!=2 && m!=7)
+		if (searchregex==1) headline(parent_window,wtop,wleft,"SEARCH REGEX");
+		else if (hexnotasc==1) headline(parent_window,wtop,wleft,"SEARCH HEXSTRING"); else headline(parent_window,wtop,wleft,"SEARCH ASCIISTRING");
+		while (m!=3 && m!=4 && m!=9)
 		{
 			wattrset(parent_window,attrs[COLOR_BRACKETS]);
 			mvwprintw(parent_window,wtop+2,wleft+1,"[                              ]"); 
 			mvwprintw(parent_window,wtop+7,wleft+2,"[                             ]"); 
 			mvwprintw(parent_window,wtop+9,wleft+2,"[                             ]"); 
+			mvwprintw(parent_window,wtop+3,wleft+1,"( )");
+			mvwprintw(parent_window,wtop+3,wleft+25,"[  ]");
 			mvwprintw(parent_window,wtop+6,wleft+1,"( )");
 			mvwprintw(parent_window,wtop+8,wleft+1,"( )");
 			wattrset(parent_window,attrs[COLOR_TEXT]);
+			if (searchregex==1) mvwprintw(parent_window,wtop+3,wleft+2,"X");
+			mvwprintw(parent_window,wtop+3,wleft+26,"%2u",searchmismatches);
+			if (searchregex==1) 
+			{
+				if (strlen(regexstring)<=30) mvwprintw(parent_window,wtop+2,wleft+2,"%s",regexstring);
+				else mvwprintw(parent_window,wtop+2,wleft+2,"%s",regexstring+strlen(regexstring)-30);
+			} else
 			if (hexnotasc==1) 
 			{
 				printsearchstring3(parent_window,wtop+2,wleft+2,0);
@@ -721,7 +1596,25 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 				}
 			}
 			m=menu_show(parent_window);
-			if (m==7 || m==1 || m==2) 
+			if (m==3 && searchregex==0 && searchmismatches>0 && searchmismatches>=(hexnotasc==1?searchstring3len:strlen(searchstring)))
+			{
+				wattrset(parent_window,attrs[COLOR_TEXT]);
+				mvwprintw(parent_window,wtop+10,wleft+2,"%-30.30s","more mismatches than bytes");
+				m=-1;
+			}
+			if (m==3 && searchregex==1)
+			{
+				searchre=bregex_compile(regexstring,&error);
+				if (searchre==NULL)
+				{
+					wattrset(parent_window,attrs[COLOR_TEXT]);
+					mvwprintw(parent_window,wtop+10,wleft+2,"%-30.30s",error);
+					m=-1;
+				}
+				bregex_free(searchre);
+				searchre=NULL;
+			}
+			if (m==9 || m==3 || m==4) 
 			{
 				wattrset(parent_window,attrs[COLOR_HEXFIELD]);
 				erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
@@ -735,9 +1628,15 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 					}
 				}
 			}
-			if (m==7) return 0;
+			if (m==9) return 0;
 			if (m==0) 
 			{
+				if (searchregex==1)
+				{
+					s=input2(parent_window,wtop+2,wleft+2,29,"",255,0,0);
+					free(regexstring);
+					regexstring=s;
+				} else
 				if (hexnotasc==1) 
 				{
 					cursor=0;
@@ -839,10 +1738,23 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 					free(s);	
 				}
 			}
-			if (m==1) return KEY_F(5);
-			if (m==2) return KEY_F(6);
-			if (m==3) writesearch=1-writesearch;
-			if (m==4) 
+			if (m==1)
+			{
+				searchregex=1-searchregex;
+				draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+				if (searchregex==1) headline(parent_window,wtop,wleft,"SEARCH REGEX");
+				else if (hexnotasc==1) headline(parent_window,wtop,wleft,"SEARCH HEXSTRING"); else headline(parent_window,wtop,wleft,"SEARCH ASCIISTRING");
+			}
+			if (m==2)
+			{
+				s=input2(parent_window,wtop+3,wleft+26,2,"",2,0,0);
+				searchmismatches=atoi(s);
+				free(s);
+			}
+			if (m==3) return KEY_F(5);
+			if (m==4) return KEY_F(6);
+			if (m==5) writesearch=1-writesearch;
+			if (m==6) 
 			{
 				doit=1;
 				while ((strcmp(readsearchfilename,writesearchfilename)==0 && strlen(readsearchfilename)>0) || (doit==1))	
@@ -857,8 +1769,8 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 					mvwprintw(parent_window,wtop+10,wleft+2,"Please choose a different name");
 				} 
 			}
-			if (m==5) readsearch=1-readsearch;
-			if (m==6) 
+			if (m==7) readsearch=1-readsearch;
+			if (m==8) 
 			{
 				doit=1;
 				while ((strcmp(readsearchfilename,writesearchfilename)==0 && strlen(readsearchfilename)>0) || (doit==1))	
@@ -873,7 +1785,7 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 					mvwprintw(parent_window,wtop+10,wleft+2,"Please choose a different name");
 				}
 			}
-			if (m==4 || m==6)
+			if (m==6 || m==8)
 			{
 				wattrset(parent_window,attrs[COLOR_FRAME]);
 				mvwprintw(parent_window,wtop+10,wleft+2,"                              ");
@@ -884,10 +1796,378 @@ int searchfor(WINDOW* parent_window,int hexnotasc)
 	}
 	return 0;
 }
-int gotowhere( WINDOW* parent_window,
-	           file_position_t ap, 
-	           file_position_t ap2,
-			   file_position_t filesize)
+int valuefor(WINDOW* parent_window)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int m=0;
+	char* s;
+	wtop=LINES/2-4;
+	wbot=wtop+8;
+	wleft=COLS/2-16;
+	wright=wleft+33;
+	new_menu(1);
+	menu_item(0,wtop+1,wleft+1,"%Value (or lo..hi)",'v','V',0);
+	menu_item(1,wtop+3,wleft+5,"Also as %float and double",'f','F',0);
+	menu_item(2,wtop+5,wleft+1,"%Search Forward",'s','S',0);
+	menu_item(3,wtop+7,wleft+1,"%%Cancel",0,0,0);
+	if (LINES>10 && COLS>32)
+	{
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"SEARCH VALUE");
+		while (m!=2 && m!=3)
+		{
+			wattrset(parent_window,attrs[COLOR_BRACKETS]);
+			mvwprintw(parent_window,wtop+2,wleft+1,"[                              ]"); 
+			mvwprintw(parent_window,wtop+3,wleft+1,"( )");
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			mvwprintw(parent_window,wtop+2,wleft+2,"%-30.30s",valuetext);
+			if (valuefloats==1) mvwprintw(parent_window,wtop+3,wleft+2,"X"); 
+			m=menu_show(parent_window);
+			if (m==0)
+			{
+				s=input2(parent_window,wtop+2,wleft+2,29,"",63,0,0);
+				strncpy(valuetext,s,sizeof(valuetext)-1);
+				free(s);
+			}
+			if (m==1) valuefloats=1-valuefloats;
+			if (m==2)
+			{
+				values_free(&searchvalues);
+				if (!values_parse(&searchvalues,valuetext,valuefloats))
+				{
+					wattrset(parent_window,attrs[COLOR_TEXT]);
+					mvwprintw(parent_window,wtop+6,wleft+2,"%-30.30s","that is not a number");
+					m=-1;
+				}
+			}
+		}
+		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	}
+	if (m==2) return KEY_F(5);
+	return 0;
+}
+int bitsfor(WINDOW* parent_window)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int m=0;
+	char* s;
+	wtop=LINES/2-4;
+	wbot=wtop+8;
+	wleft=COLS/2-16;
+	wright=wleft+33;
+	new_menu(1);
+	menu_item(0,wtop+1,wleft+1,"%Bits (0, 1 and x)",'b','B',0);
+	menu_item(1,wtop+3,wleft+5,"%View starts     bits in",'v','V',0);
+	menu_item(2,wtop+5,wleft+1,"%Search Forward",'s','S',0);
+	menu_item(3,wtop+7,wleft+1,"%%Cancel",0,0,0);
+	if (LINES>10 && COLS>32)
+	{
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"SEARCH BITS");
+		while (m!=2 && m!=3)
+		{
+			wattrset(parent_window,attrs[COLOR_BRACKETS]);
+			mvwprintw(parent_window,wtop+2,wleft+1,"[                              ]"); 
+			mvwprintw(parent_window,wtop+3,wleft+17,"[ ]");
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			if (strlen(bitstext)<=30) mvwprintw(parent_window,wtop+2,wleft+2,"%-30.30s",bitstext);
+			else mvwprintw(parent_window,wtop+2,wleft+2,"%s",bitstext+strlen(bitstext)-30);
+			mvwprintw(parent_window,wtop+3,wleft+18,"%u",viewbits);
+			m=menu_show(parent_window);
+			if (m==0)
+			{
+				s=input2(parent_window,wtop+2,wleft+2,29,"",63,0,0);
+				memcpy(bitstext,s,strlen(s)<sizeof(bitstext)?strlen(s)+1:sizeof(bitstext));
+				bitstext[sizeof(bitstext)-1]=0;
+				free(s);
+			}
+			if (m==1)
+			{
+				s=input2(parent_window,wtop+3,wleft+18,1,"",1,0,0);
+				if (s[0]>='0' && s[0]<='7') viewbits=s[0]-'0';
+				free(s);
+			}
+			if (m==2 && !bits_parse(&searchbits,bitstext))
+			{
+				wattrset(parent_window,attrs[COLOR_TEXT]);
+				mvwprintw(parent_window,wtop+6,wleft+2,"%-30.30s","not a bit pattern");
+				m=-1;
+			}
+		}
+		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	}
+	if (m==2) return KEY_F(5);
+	return 0;
+}
+// the plaintext as bytes, NULL when the hex does not work out
+unsigned char* xformbytes(unsigned int* len)
+{
+	static unsigned char b[XFORM_MAXLEN];
+	unsigned int n=0;
+	unsigned int i;
+	int d;
+	int hi=-1;
+	if (!xformhex)
+	{
+		*len=strlen(xformtext);
+		memcpy(b,xformtext,*len);
+		return b;
+	}
+	for (i=0;xformtext[i];i++)
+	{
+		if (xformtext[i]==' ') continue;
+		d=xformtext[i];
+		if (d>='0' && d<='9') d-='0';
+		else if (d>='a' && d<='f') d-='a'-10;
+		else if (d>='A' && d<='F') d-='A'-10;
+		else return NULL;
+		if (hi<0) hi=d;
+		else
+		{
+			b[n++]=(hi<<4)|d;
+			hi=-1;
+		}
+	}
+	if (hi>=0) return NULL;
+	*len=n;
+	return b;
+}
+int xformfor(WINDOW* parent_window)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int m=0;
+	char* s;
+	unsigned char* b;
+	unsigned int len;
+	wtop=LINES/2-4;
+	wbot=wtop+8;
+	wleft=COLS/2-16;
+	wright=wleft+33;
+	new_menu(1);
+	menu_item(0,wtop+1,wleft+1,"%Plaintext",'p','P',0);
+	menu_item(1,wtop+3,wleft+5,"%Hex bytes",'h','H',0);
+	menu_item(2,wtop+5,wleft+1,"%Search Forward",'s','S',0);
+	menu_item(3,wtop+7,wleft+1,"%%Cancel",0,0,0);
+	if (LINES>10 && COLS>32)
+	{
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"SEARCH XOR/ADD/ROL");
+		while (m!=2 && m!=3)
+		{
+			wattrset(parent_window,attrs[COLOR_BRACKETS]);
+			mvwprintw(parent_window,wtop+2,wleft+1,"[                              ]"); 
+			mvwprintw(parent_window,wtop+3,wleft+1,"( )");
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			mvwprintw(parent_window,wtop+2,wleft+2,"%-30.30s",xformtext);
+			if (xformhex==1) mvwprintw(parent_window,wtop+3,wleft+2,"X"); 
+			m=menu_show(parent_window);
+			if (m==0)
+			{
+				s=input2(parent_window,wtop+2,wleft+2,29,"",63,0,0);
+				memcpy(xformtext,s,strlen(s)<sizeof(xformtext)?strlen(s)+1:sizeof(xformtext));
+				xformtext[sizeof(xformtext)-1]=0;
+				free(s);
+			}
+			if (m==1) xformhex=1-xformhex;
+			if (m==2)
+			{
+				b=xformbytes(&len);
+				if (b==NULL || !xform_prepare(&searchxform,b,len))
+				{
+					wattrset(parent_window,attrs[COLOR_TEXT]);
+					mvwprintw(parent_window,wtop+6,wleft+2,"%-30.30s","4 bytes or more, please");
+					m=-1;
+				}
+			}
+		}
+		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	}
+	if (m==2) return KEY_F(5);
+	return 0;
+}
+void narrowrestart(void)
+{
+	if (narrowold!=NULL) bfile_close(narrowold);
+	narrowold=NULL;
+	narrow_start(&candidates,edit_size(),narrowwidth);
+}
+int narrowdown(WINDOW* parent_window)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int m=0;
+	int pred;
+	char* s;
+	const char* msg="";
+	uint64_t x=0;
+	wtop=LINES/2-7;
+	wbot=wtop+14;
+	wleft=COLS/2-21;
+	wright=wleft+43;
+	new_menu(1);
+	menu_item(0,wtop+1,wleft+1,"Value si%ze",'z','Z',0);
+	menu_item(1,wtop+2,wleft+1,"S%tart over",'t','T',0);
+	menu_item(2,wtop+4,wleft+1,"S%napshot file",'n','N',0);
+	menu_item(3,wtop+8,wleft+1,"%changed",'c','C',0);
+	menu_item(4,wtop+8,wleft+10,"%unchanged",'u','U',0);
+	menu_item(5,wtop+8,wleft+21,"%increased",'i','I',0);
+	menu_item(6,wtop+8,wleft+32,"%decreased",'d','D',0);
+	menu_item(7,wtop+9,wleft+1,"%equal to",'e','E',0);
+	menu_item(8,wtop+12,wleft+1,"%Goto next candidate",'g','G',0);
+	menu_item(9,wtop+13,wleft+1,"%%Cancel",0,0,0);
+	if (LINES>16 && COLS>42)
+	{
+		if (candidates.width==0) narrowrestart();
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"NARROW DOWN");
+		while (m!=8 && m!=9)
+		{
+			wattrset(parent_window,attrs[COLOR_BRACKETS]);
+			mvwprintw(parent_window,wtop+1,wleft+13,"[ ]");
+			mvwprintw(parent_window,wtop+5,wleft+1,"[                                        ]");
+			mvwprintw(parent_window,wtop+9,wleft+11,"[                    ]");
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			mvwprintw(parent_window,wtop+1,wleft+14,"%u",narrowwidth);
+			mvwprintw(parent_window,wtop+1,wleft+18,"bytes, little endian");
+			mvwprintw(parent_window,wtop+5,wleft+2,"%-40.40s",narrowsnapshot);
+			mvwprintw(parent_window,wtop+7,wleft+1,"Keep the values that have");
+			mvwprintw(parent_window,wtop+9,wleft+12,"%20llu",(unsigned long long)x);
+			mvwprintw(parent_window,wtop+11,wleft+1,"Candidates: %-29llu",(unsigned long long)candidates.count);
+			mvwprintw(parent_window,wtop+10,wleft+1,"%-41.41s",msg);
+			m=menu_show(parent_window);
+			msg="";
+			pred=-1;
+			if (m==0)
+			{
+				s=input2(parent_window,wtop+1,wleft+14,1,"",1,0,0);
+				if (s[0]=='1' || s[0]=='2' || s[0]=='4' || s[0]=='8') narrowwidth=s[0]-'0';
+				free(s);
+				narrowrestart();
+			}
+			if (m==1) narrowrestart();
+			if (m==2)
+			{
+				s=input2(parent_window,wtop+5,wleft+2,39,"",255,0,0);
+				strncpy(narrowsnapshot,s,sizeof(narrowsnapshot)-1);
+				free(s);
+			}
+			if (m>=3 && m<=6) pred=m-3;
+			if (m==7)
+			{
+				s=input2(parent_window,wtop+9,wleft+12,20,"",20,0,0);
+				x=strtoull(s,NULL,0);
+				free(s);
+				pred=NARROW_EQUALS;
+			}
+			if (pred>=0 && narrowsnapshot[0]==0)
+			{
+				// without a new snapshot only "equal to" makes sense, on the current one
+				if (pred==NARROW_EQUALS)
+				{
+					narrow_apply(&candidates,narrowreadold,narrowreadold,narrowold?bfile_size(narrowold):edit_size(),pred,x);
+				} else msg="Which snapshot? Give a file first";
+			} else if (pred>=0) {
+				narrownew=bfile_open(narrowsnapshot);
+				if (narrownew==NULL) msg="Could not open the snapshot";
+				else
+				{
+					narrow_apply(&candidates,narrowreadold,narrowreadnew,bfile_size(narrownew),pred,x);
+					if (narrowold!=NULL) bfile_close(narrowold);
+					narrowold=narrownew;
+					narrowsnapshot[0]=0;
+				}
+			}
+		}
+		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	}
+	if (m==8) return KEY_F(5);
+	return 0;
+}
+// in diff mode writes a patch that turns file 1 into file 2, otherwise
+// applies one to the file as unsaved changes. 1: the file changed
+int patchfor(WINDOW* parent_window,file_position_t filesize1,file_position_t filesize2)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int m=0;
+	char* s;
+	const char* msg="";
+	struct patchstats st;
+	wtop=LINES/2-4;
+	wbot=wtop+8;
+	wleft=COLS/2-21;
+	wright=wleft+43;
+	new_menu(1);
+	menu_item(0,wtop+1,wleft+1,"Patch %file",'f','F',0);
+	if (diffnotedit==1) menu_item(1,wtop+4,wleft+1,"%Write file 1 -> file 2",'w','W',0);
+	else menu_item(1,wtop+4,wleft+1,"%Apply as unsaved changes",'a','A',0);
+	menu_item(2,wtop+7,wleft+1,"%%Cancel",0,0,0);
+	if (LINES>10 && COLS>42)
+	{
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"PATCH");
+		while (m!=1 && m!=2)
+		{
+			wattrset(parent_window,attrs[COLOR_BRACKETS]);
+			mvwprintw(parent_window,wtop+2,wleft+1,"[                                        ]");
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			mvwprintw(parent_window,wtop+2,wleft+2,"%-40.40s",patchname);
+			mvwprintw(parent_window,wtop+5,wleft+1,"%-41.41s",msg);
+			m=menu_show(parent_window);
+			msg="";
+			if (m==0)
+			{
+				s=input2(parent_window,wtop+2,wleft+2,39,"",255,0,0);
+				memcpy(patchname,s,strlen(s)<sizeof(patchname)?strlen(s)+1:sizeof(patchname));
+				patchname[sizeof(patchname)-1]=0;
+				free(s);
+			}
+			if (m==1 && patchname[0]==0)
+			{
+				msg="Which file? Give one first";
+				m=-1;
+			}
+			if (m==1 && diffnotedit==1)
+			{
+				wattrset(parent_window,attrs[COLOR_TEXT]);
+				mvwprintw(parent_window,wtop+5,wleft+1,"%-41.41s","Comparing...");
+				wrefresh(parent_window);
+				if (!patch_make(patchname,readfile1,filesize1,readfile2,filesize2,&st))
+				{
+					msg="Could not write the patch";
+					m=-1;
+				}
+			} else if (m==1 && !patch_apply(patchname,readedited,filesize1,&st,&msg)) m=-1;
+		}
+		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	}
+	if (m!=1) return 0;
+	snprintf(patchwhat,sizeof(patchwhat),"PATCH: %llu RANGES, %llu BYTES",(unsigned long long)st.ranges,(unsigned long long)st.bytes);
+	foundwhat=patchwhat;
+	return diffnotedit==0;
+}
+int gotowhere( WINDOW* parent_window,
+	           file_position_t ap, 
+	           file_position_t ap2,
+			   file_position_t filesize)
 {
 	int wtop;
 	int wbot;
@@ -910,39 +2190,1030 @@ int gotowhere( WINDOW* parent_window,
 	menu_item(0,wtop+4,wright-6,"%%Cancel",'c','C',0);	
 	if (LINES>9 && COLS>32)
 	{
-		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
-		headline(parent_window,wtop,wleft,"GOTO");
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"GOTO");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		mvwprintw(parent_window,wtop+1,wleft+1,"Goto where? (Enter +x or -x to");
+		mvwprintw(parent_window,wtop+2,wleft+1,"jump relative to your position)");
+		m=1;
+		while (m==1)
+		{
+			wattrset(parent_window,attrs[COLOR_BRACKETS]);
+			mvwprintw(parent_window,wtop+4,wleft+5,"[           ]");	
+			wattrset(parent_window,attrs[COLOR_TEXT]);
+			mvwprintw(parent_window,wtop+4,wleft+6,"%11X",ap);	
+			m=menu_show(parent_window);	
+		
+			if (m==1)
+			{
+//				s=input2(parent_window,wtop+4,wleft+6,11,tohex2(ap2,10),11,0,0);// TODO: er zeigt mir hier mist an. warum??
+				s=input2(parent_window,wtop+4,wleft+6,11,"\0",11,0,0);// TODO: er zeigt mir hier mist an. warum??
+				plus=0;
+				minus=0;
+				value=(int)stohex(s);
+				for (i=0;i<strlen(s);i++)
+				{
+					if (s[i]=='-' || s[i]=='m') {value=ap2-value;i=20;}
+					if (s[i]=='+' || s[i]=='p') {value=ap2+value;i=20;}
+				}
+				if (value<=filesize) ap=value;
+				free(s);
+			} else if (m==0) ap=ap2;
+		}
+		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	}
+	return ap;	
+}
+file_position_t nextdifference(file_position_t pos,file_position_t filesize1,file_position_t filesize2,file_position_t notfound)
+{
+	file_position_t lo;
+	file_position_t hi;
+	diffoverlap(filesize1,filesize2,&lo,&hi);
+	if (pos<lo) pos=lo;
+	return mask_nextdiff(&diffmask,readfile1,readshifted,pos,hi,notfound);
+}
+void diffsummary(WINDOW* parent_window,file_position_t filesize1,file_position_t filesize2)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	file_position_t start;
+	file_position_t end;
+	file_position_t diff;
+	file_position_t runs;
+	file_position_t ignored;
+	file_position_t first;
+	wtop=LINES/2-4;
+	wbot=wtop+8;
+	wleft=COLS/2-20;
+	wright=wleft+40;
+	if (LINES<=10 || COLS<=40) return;
+	diffoverlap(filesize1,filesize2,&start,&end);
+	draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	headline(parent_window,wtop,wleft,"DIFF SUMMARY");
+	wattrset(parent_window,attrs[COLOR_TEXT]);
+	mvwprintw(parent_window,wtop+1,wleft+2,"Comparing...");
+	wrefresh(parent_window);
+	mask_summary(&diffmask,readfile1,readshifted,start,end,&diff,&runs,&ignored);
+	first=nextdifference(start,filesize1,filesize2,end);
+	mvwprintw(parent_window,wtop+1,wleft+2,"Different bytes   %18llu",(unsigned long long)diff);
+	mvwprintw(parent_window,wtop+2,wleft+2,"in stretches      %18llu",(unsigned long long)runs);
+	mvwprintw(parent_window,wtop+3,wleft+2,"Ignored bytes     %18llu",(unsigned long long)ignored);
+	if (first<end) mvwprintw(parent_window,wtop+4,wleft+2,"First difference  %18llX",(unsigned long long)first);
+	else mvwprintw(parent_window,wtop+4,wleft+2,"First difference  %18s","none");
+	if (filesize1!=filesize2) mvwprintw(parent_window,wtop+5,wleft+2,"The sizes differ by %16llu",(unsigned long long)((filesize1>filesize2)?filesize1-filesize2:filesize2-filesize1));
+	wattrset(parent_window,attrs[COLOR_MENU_HI]);
+	mvwprintw(parent_window,wtop+7,wleft+1,"OK");
+	wrefresh(parent_window);
+	getch2();
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+}
+file_position_t nextblock(file_position_t pos,file_position_t filesize,int dir)
+{
+	return runs_next(readedited,holeedited,pos,filesize,skipblocksize,dir,pos);
+}
+void selection(file_position_t cp,file_position_t filesize,file_position_t* start,file_position_t* end)
+{
+	if (marked)
+	{
+		*start=(markpos<cp)?markpos:cp;
+		*end=((markpos>cp)?markpos:cp)+1;
+		if (*end>filesize) *end=filesize;
+	} else if (inputfile->type==BFILE_PROCESS) {
+		// the whole address space is too much, take the mapping
+		*start=bfile_nextdata(inputfile,cp,end);
+		if (*end>filesize) *end=filesize;
+		if (*start>*end) *start=*end;
+	} else {
+		*start=0;
+		*end=filesize;
+	}
+}
+void stringsreset()
+{
+	strupto=0;
+	strnfiltered=0;
+	strsel=0;
+	strtop=0;
+}
+// run the new strings through the filter, a few at a time so the panel stays responsive
+int stringscatchup(unsigned int limit)
+{
+	pthread_mutex_lock(&strs.lock);
+	while (strupto<strs.stable && limit--)
+	{
+		if (extract_match(&strs,strupto,strfilter))
+		{
+			if (strnfiltered==strmaxfiltered)
+			{
+				strmaxfiltered=strmaxfiltered?strmaxfiltered*2:4096;
+				strfiltered=realloc(strfiltered,strmaxfiltered*sizeof(unsigned int));
+			}
+			strfiltered[strnfiltered++]=strupto;
+		}
+		strupto++;
+	}
+	limit=(strupto<strs.stable);
+	pthread_mutex_unlock(&strs.lock);
+	return limit;
+}
+// the filter got longer: everything it matches now is in the old list already
+void stringsnarrow()
+{
+	unsigned int i;
+	unsigned int j=0;
+	pthread_mutex_lock(&strs.lock);
+	for (i=0;i<strnfiltered;i++) if (extract_match(&strs,strfiltered[i],strfilter)) strfiltered[j++]=strfiltered[i];
+	pthread_mutex_unlock(&strs.lock);
+	strnfiltered=j;
+	strsel=0;
+	strtop=0;
+}
+int stringspanel(WINDOW* parent_window,file_position_t* target)
+{
+	struct strhit* hit;
+	unsigned int i;
+	unsigned int l;
+	unsigned int height;
+	int busy;
+	int y;
+	int ch=0;
+	char* t;
+	height=LINES-4;
+	for (;;)
+	{
+		busy=stringscatchup(100000);
+		if (strsel>=strnfiltered) strsel=strnfiltered?strnfiltered-1:0;
+		if (strsel<strtop) strtop=strsel;
+		if (strsel>=strtop+height) strtop=strsel-height+1;
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"STRINGS");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		if (strs.running) mvwprintw(parent_window,1,12," %u found, %3u%% ",strnfiltered,(unsigned int)((strs.done-strs.start)*100/(strs.end>strs.start?strs.end-strs.start:1)));
+		else mvwprintw(parent_window,1,12," %u found ",strnfiltered);
+		wattrset(parent_window,attrs[COLOR_BRACKETS]);
+		mvwprintw(parent_window,LINES-2,2,"[Filter:                              ]");
+		wattrset(parent_window,attrs[COLOR_INPUT]);
+		mvwprintw(parent_window,LINES-2,10,"%-29.29s",strfilter);
+		pthread_mutex_lock(&strs.lock);
+		for (y=0;y<(int)height && strtop+y<strnfiltered;y++)
+		{
+			hit=&strs.hits[strfiltered[strtop+y]];
+			wattrset(parent_window,attrs[(strtop+y==strsel)?COLOR_MENU_HI:COLOR_MENU]);
+			mvwprintw(parent_window,y+2,1,"%10llX %c ",(unsigned long long)hit->pos,hit->wide?'W':'A');
+			t=strs.text+hit->text;
+			l=strlen(t);
+			for (i=0;(int)i<COLS-15;i++) waddch(parent_window,(i<l && t[i]!=9)?t[i]:' ');
+		}
+		pthread_mutex_unlock(&strs.lock);
+		wrefresh(parent_window);
+		timeout((busy || strs.running)?(busy?0:200):-1);
+		ch=getch();
+		timeout(-1);
+		if (ch==ERR) continue;
+		if (ch==KEY_ESC || ch==KEY_CANCEL || ch==KEY_F(10)) break;
+		if (ch==KEY_RETURN || ch==KEY_ENTER || ch==10)
+		{
+			if (strnfiltered==0) continue;
+			pthread_mutex_lock(&strs.lock);
+			*target=strs.hits[strfiltered[strsel]].pos;
+			pthread_mutex_unlock(&strs.lock);
+			break;
+		}
+		if (ch==KEY_DOWN && strsel+1<strnfiltered) strsel++;
+		if (ch==KEY_UP && strsel>0) strsel--;
+		if (ch==KEY_NPAGE) strsel=(strsel+height<strnfiltered)?strsel+height:(strnfiltered?strnfiltered-1:0);
+		if (ch==KEY_PPAGE) strsel=(strsel>height)?strsel-height:0;
+		if (ch==KEY_HOME) strsel=0;
+		if (ch==KEY_END && strnfiltered) strsel=strnfiltered-1;
+		if ((ch==KEY_BACKSPACE || ch==KEY_DELETE || ch==8) && strfilter[0])
+		{
+			strfilter[strlen(strfilter)-1]=0;
+			stringsreset();
+		}
+		if (ch>=32 && ch<127 && strlen(strfilter)<sizeof(strfilter)-1)
+		{
+			l=strlen(strfilter);
+			strfilter[l]=ch;
+			strfilter[l+1]=0;
+			stringsnarrow();
+		}
+	}
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	return ch!=KEY_ESC && ch!=KEY_CANCEL && ch!=KEY_F(10);
+}
+// how far a scan behind a panel is. ESC stops it, other keys wait for the panel
+int scanprogress(file_position_t done,file_position_t total)
+{
+	int ch;
+	wattrset(stdscr,attrs[COLOR_TEXT]);
+	mvwprintw(stdscr,1,12," %3u%% ",(unsigned int)(done*100/(total?total:1)));
+	wrefresh(stdscr);
+	timeout(0);
+	while ((ch=getch())!=ERR && ch!=KEY_ESC && ch!=KEY_F(10))
+		if (scankey==ERR) scankey=ch;
+	timeout(-1);
+	return ch!=ERR;
+}
+// "100..1FFF" keeps the hits that start in there, hex bytes those that
+// start with them. both can be given, the range first
+void hitsreset()
+{
+	char* dots;
+	char* t=hitfilter;
+	char lo[64];
+	file_position_t hi=(file_position_t)-1;
+	unsigned int n=0;
+	hitfirst=0;
+	dots=strstr(hitfilter,"..");
+	if (dots!=NULL)
+	{
+		snprintf(lo,sizeof(lo),"%.*s",(int)(dots-hitfilter),hitfilter);
+		hitfirst=hits_find(&searchhits,stohex(lo));
+		for (t=dots+2;*t!=0 && *t!=' ';t++);
+		snprintf(lo,sizeof(lo),"%.*s",(int)(t-dots-2),dots+2);
+		if (lo[0]!=0) hi=stohex(lo);
+	}
+	hitlast=(hi==(file_position_t)-1)?searchhits.num:hits_find(&searchhits,hi+1);
+	if (hitlast<hitfirst) hitlast=hitfirst;
+	nhitbytes=0;
+	for (;*t!=0 && nhitbytes<sizeof(hitbytes);t++)
+	{
+		if (!isxdigit((unsigned char)*t)) continue;
+		hitbytes[nhitbytes]=(hitbytes[nhitbytes]<<4)|((*t<='9')?*t-'0':(*t|32)-'a'+10);
+		if (++n%2==0) nhitbytes++;
+	}
+	hitnfiltered=0;
+	hitupto=hitfirst;
+	hitsel=0;
+	hittop=0;
+	hitserial=searchhits.serial;
+}
+// tests up to limit more hits against the bytes, 1 if there are more left
+int hitscatchup(unsigned int limit)
+{
+	unsigned char buf[32];
+	if (nhitbytes==0) return 0;
+	while (hitupto<hitlast && limit--)
+	{
+		if (readedited(searchhits.h[hitupto].start,buf,nhitbytes)==nhitbytes && memcmp(buf,hitbytes,nhitbytes)==0)
+		{
+			if (hitnfiltered==hitmaxfiltered)
+			{
+				hitmaxfiltered=hitmaxfiltered?hitmaxfiltered*2:4096;
+				hitfiltered=realloc(hitfiltered,hitmaxfiltered*sizeof(unsigned int));
+			}
+			hitfiltered[hitnfiltered++]=hitupto;
+		}
+		hitupto++;
+	}
+	return hitupto<hitlast;
+}
+unsigned int hitsshown()
+{
+	return (nhitbytes==0)?hitlast-hitfirst:hitnfiltered;
+}
+unsigned int hitshown(unsigned int i)
+{
+	return (nhitbytes==0)?hitfirst+i:hitfiltered[i];
+}
+// the first one shown at pos or after it
+unsigned int hitshownat(file_position_t pos)
+{
+	unsigned int k=hits_find(&searchhits,pos);
+	unsigned int lo=0;
+	unsigned int hi=hitnfiltered;
+	unsigned int mid;
+	if (nhitbytes==0) return (k<hitfirst)?0:k-hitfirst;
+	while (lo<hi)
+	{
+		mid=(lo+hi)/2;
+		if (hitfiltered[mid]<k) lo=mid+1; else hi=mid;
+	}
+	return lo;
+}
+// the hits of the last result set, a line each with the bytes around
+// them. only the lines on the screen are read, so it does not matter how
+// many there are. Enter goes to one, F2 to the first at an offset
+int resultspanel(WINDOW* parent_window,file_position_t* target)
+{
+	struct hit* hit;
+	unsigned char buf[256];
+	file_position_t from;
+	unsigned int height;
+	unsigned int nbytes;
+	unsigned int n;
+	unsigned int l;
+	unsigned int i;
+	int busy;
+	int x;
+	int y;
+	int ch=0;
+	char* s;
+	height=LINES-4;
+	if ((shownlen>0 || shownre!=NULL) && (shownlo>0 || shownhi<edit_size() || shownserial!=edit_serial()))
+	{
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"RESULTS");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		wrefresh(parent_window);
+		scankey=ERR;
+		collectshown(scanprogress);
+		if (scankey!=ERR) ungetch(scankey);
+	}
+	if (hitserial!=searchhits.serial) hitsreset();
+	// offset, length, then every byte as hex and as a character
+	nbytes=(COLS-poscols-11)/4;
+	if (nbytes>sizeof(buf)) nbytes=sizeof(buf);
+	for (;;)
+	{
+		busy=hitscatchup(100000);
+		n=hitsshown();
+		if (hitsel>=n) hitsel=n?n-1:0;
+		if (hitsel<hittop) hittop=hitsel;
+		if (hitsel>=hittop+height) hittop=hitsel-height+1;
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"RESULTS");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		if (busy) mvwprintw(parent_window,1,12," %u of %u hits%s, %3u%% ",n,searchhits.num,showncut?" (not all)":"",(unsigned int)((uint64_t)(hitupto-hitfirst)*100/(hitlast-hitfirst)));
+		else mvwprintw(parent_window,1,12," %u of %u hits%s ",n,searchhits.num,showncut?" (not all)":"");
+		wattrset(parent_window,attrs[COLOR_BRACKETS]);
+		mvwprintw(parent_window,LINES-2,2,"[Filter:                              ]");
+		wattrset(parent_window,attrs[COLOR_INPUT]);
+		mvwprintw(parent_window,LINES-2,10,"%-29.29s",hitfilter);
+		for (y=0;y<(int)height && hittop+y<n;y++)
+		{
+			hit=&searchhits.h[hitshown(hittop+y)];
+			// a few bytes of what comes before
+			from=(hit->start>4)?hit->start-4:0;
+			l=readedited(from,buf,nbytes);
+			wattrset(parent_window,attrs[(hittop+y==hitsel)?COLOR_MENU_HI:COLOR_MENU]);
+			mvwprintw(parent_window,y+2,1,"%*llX %5llu ",poscols,(unsigned long long)hit->start,(unsigned long long)(hit->end-hit->start));
+			x=poscols+9;
+			for (i=0;i<nbytes;i++)
+			{
+				wattrset(parent_window,attrs[(from+i>=hit->start && from+i<hit->end)?COLOR_MATCH:(hittop+y==hitsel)?COLOR_MENU_HI:COLOR_MENU]);
+				if (i<l) mvwprintw(parent_window,y+2,x+i*3,"%02X",buf[i]); else mvwprintw(parent_window,y+2,x+i*3,"  ");
+				if (i<l) mvwprintw(parent_window,y+2,x+nbytes*3+i,"%c",(buf[i]>=32 && buf[i]<127)?buf[i]:'.');
+				else mvwprintw(parent_window,y+2,x+nbytes*3+i," ");
+				wattrset(parent_window,attrs[(hittop+y==hitsel)?COLOR_MENU_HI:COLOR_MENU]);
+				mvwprintw(parent_window,y+2,x+i*3+2," ");
+			}
+		}
+		wattrset(parent_window,attrs[COLOR_MENU]);
+		if (searchhits.num==0) mvwprintw(parent_window,2,1,"No results: search for something, or read a result file in");
+		wrefresh(parent_window);
+		timeout(busy?0:-1);
+		ch=getch();
+		timeout(-1);
+		if (ch==ERR) continue;
+		if (ch==KEY_ESC || ch==KEY_CANCEL || ch==KEY_F(10)) break;
+		if (ch==KEY_RETURN || ch==KEY_ENTER || ch==10)
+		{
+			if (n==0) continue;
+			*target=searchhits.h[hitshown(hitsel)].start;
+			break;
+		}
+		if (ch==KEY_F(2))
+		{
+			s=input2(parent_window,LINES-2,10,29,"",16,0,0);
+			if (s[0]!=0) hitsel=hitshownat(stohex(s));
+			free(s);
+		}
+		if (ch==KEY_DOWN && hitsel+1<n) hitsel++;
+		if (ch==KEY_UP && hitsel>0) hitsel--;
+		if (ch==KEY_NPAGE) hitsel=(hitsel+height<n)?hitsel+height:(n?n-1:0);
+		if (ch==KEY_PPAGE) hitsel=(hitsel>height)?hitsel-height:0;
+		if (ch==KEY_HOME) hitsel=0;
+		if (ch==KEY_END && n) hitsel=n-1;
+		if ((ch==KEY_BACKSPACE || ch==KEY_DELETE || ch==8) && hitfilter[0])
+		{
+			hitfilter[strlen(hitfilter)-1]=0;
+			hitsreset();
+		}
+		if (ch>=32 && ch<127 && strlen(hitfilter)<sizeof(hitfilter)-1)
+		{
+			l=strlen(hitfilter);
+			hitfilter[l]=ch;
+			hitfilter[l+1]=0;
+			hitsreset();
+		}
+	}
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	return ch==KEY_RETURN || ch==KEY_ENTER || ch==10;
+}
+// where the diffile shows up in the inputfile. Enter lines the diff up there
+int locatepanel(WINDOW* parent_window,file_position_t filesize2,file_position_t* target)
+{
+	struct locatehit* hit;
+	unsigned int height;
+	int y;
+	int ch=0;
+	height=LINES-4;
+	draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	headline(parent_window,1,0,"LOCATE");
+	if (located.block==0)
+	{
+		scankey=ERR;
+		if (!locate_run(&located,readfile1,bfile_size(inputfile),readfile2,filesize2,scanprogress)) locate_free(&located);
+		else if (scankey!=ERR) ungetch(scankey);
+		locatesel=0;
+		locatetop=0;
+	}
+	for (;;)
+	{
+		if (locatesel>=located.num) locatesel=located.num?located.num-1:0;
+		if (locatesel<locatetop) locatetop=locatesel;
+		if (locatesel>=locatetop+height) locatetop=locatesel-height+1;
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"LOCATE");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		mvwprintw(parent_window,1,12," %u places, in blocks of %u bytes ",located.num,located.block);
+		for (y=0;y<(int)height && locatetop+y<located.num;y++)
+		{
+			hit=&located.hit[locatetop+y];
+			wattrset(parent_window,attrs[(locatetop+y==locatesel)?COLOR_MENU_HI:COLOR_MENU]);
+			mvwprintw(parent_window,y+2,1,"%10llX  offset 0 at %c%10llX  %12llu bytes, %3u%%",(unsigned long long)hit->a,
+				(hit->shift<0)?'-':' ',(unsigned long long)((hit->shift<0)?-hit->shift:hit->shift),
+				(unsigned long long)hit->bytes,(unsigned int)(hit->bytes*100/(filesize2?filesize2:1)));
+		}
+		if (located.num==0) mvwprintw(parent_window,2,1,"Not found");
+		wrefresh(parent_window);
+		ch=getch2();
+		if (ch==KEY_ESC || ch==KEY_CANCEL || ch==KEY_F(10)) break;
+		if (ch=='0')
+		{
+			diffshift=0;
+			break;
+		}
+		if ((ch==KEY_RETURN || ch==KEY_ENTER || ch==10) && located.num)
+		{
+			diffshift=located.hit[locatesel].shift;
+			*target=located.hit[locatesel].a;
+			break;
+		}
+		if (ch==KEY_DOWN && locatesel+1<located.num) locatesel++;
+		if (ch==KEY_UP && locatesel>0) locatesel--;
+		if (ch==KEY_NPAGE) locatesel+=height;
+		if (ch==KEY_PPAGE) locatesel=(locatesel>height)?locatesel-height:0;
+	}
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	return ch==KEY_RETURN || ch==KEY_ENTER || ch==10;
+}
+// the hits of dhex --grep. Enter opens the file there
+int greppanel(WINDOW* parent_window,unsigned int* sel)
+{
+	struct grephit* hit;
+	unsigned int height;
+	unsigned int top=0;
+	int y;
+	int ch=0;
+	height=LINES-4;
+	for (;;)
+	{
+		if (*sel>=grepped.num) *sel=grepped.num?grepped.num-1:0;
+		if (*sel<top) top=*sel;
+		if (*sel>=top+height) top=*sel-height+1;
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"GREP");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		mvwprintw(parent_window,1,12," %u found in %u files ",grepped.num,grepped.files);
+		for (y=0;y<(int)height && top+y<grepped.num;y++)
+		{
+			hit=&grepped.hit[top+y];
+			wattrset(parent_window,attrs[(top+y==*sel)?COLOR_MENU_HI:COLOR_MENU]);
+			mvwprintw(parent_window,y+2,1,"%10llX  %-*.*s",(unsigned long long)hit->pos,COLS-15,COLS-15,grepped.name[hit->file]);
+		}
+		if (grepped.num==0) mvwprintw(parent_window,2,1,"Not found");
+		wrefresh(parent_window);
+		ch=getch2();
+		if (ch==KEY_ESC || ch==KEY_CANCEL || ch==KEY_F(10)) break;
+		if ((ch==KEY_RETURN || ch==KEY_ENTER || ch==10) && grepped.num) break;
+		if (ch==KEY_DOWN && *sel+1<grepped.num) (*sel)++;
+		if (ch==KEY_UP && *sel>0) (*sel)--;
+		if (ch==KEY_NPAGE) *sel+=height;
+		if (ch==KEY_PPAGE) *sel=(*sel>height)?*sel-height:0;
+		if (ch==KEY_HOME) *sel=0;
+		if (ch==KEY_END) *sel=grepped.num;
+	}
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	return ch==KEY_RETURN || ch==KEY_ENTER || ch==10;
+}
+// what the database says about the block under the cursor, for the headline
+const char* knownblock(file_position_t pos)
+{
+	const struct hashrec* rec;
+	unsigned char* block;
+	unsigned int bs=knowndb.blocksize;
+	int state;
+	state=hashdb_state(&knownscan,pos);
+	if (state==HASHDB_NONE && knownscan.running)
+	{
+		snprintf(knownwhat,sizeof(knownwhat),"looking up blocks, %u%%",(unsigned int)(knownscan.done*100/(knownscan.blocks?knownscan.blocks:1)));
+		return knownwhat;
+	}
+	if (state==HASHDB_NOVEL)
+	{
+		snprintf(knownwhat,sizeof(knownwhat),"novel, %llu of %llu blocks",(unsigned long long)knownscan.novel,(unsigned long long)(knownscan.known+knownscan.novel));
+		return knownwhat;
+	}
+	if (state!=HASHDB_KNOWN) return NULL;
+	block=malloc(bs);
+	rec=NULL;
+	if (bfile_read(inputfile,pos-pos%bs,block,bs)==bs) rec=hashdb_find(&knowndb,hashdb_hash(block,bs));
+	free(block);
+	if (rec==NULL) return NULL;
+	snprintf(knownwhat,sizeof(knownwhat),"known: %s+%llX",knowndb.name[rec->file],(unsigned long long)rec->block*bs);
+	return knownwhat;
+}
+// the next (dir>0) or previous novel block, notfound if there is none
+file_position_t knownnext(file_position_t pos,int dir,file_position_t notfound)
+{
+	file_position_t b=pos/knowndb.blocksize;
+	if (dir>0)
+	{
+		for (b++;b<knownscan.done;b++) if (knownscan.state[b]==HASHDB_NOVEL) return b*knowndb.blocksize;
+	} else {
+		if (b>knownscan.done) b=knownscan.done;
+		while (b-->0) if (knownscan.state[b]==HASHDB_NOVEL) return b*knowndb.blocksize;
+	}
+	return notfound;
+}
+// dhex --mkdb [database] [-b blocksize] [reference images]
+void mkdbmain(int argc,char *argv[])
+{
+	unsigned int blocksize=512;
+	int64_t n;
+	int i=3;
+	if (argc>=5 && strcmp(argv[3],"-b")==0)
+	{
+		if (strncmp(argv[4],"0x",2)==0) blocksize=stohex(argv[4]+2); else blocksize=stoint(argv[4]);
+		i=5;
+	}
+	if (i>=argc)
+	{
+		fprintf(stderr,"Please run with %s --mkdb [database] [-b blocksize] [reference images]\n",argv[0]);
+		exit(2);
+	}
+	n=hashdb_build(argv[2],argv+i,argc-i,blocksize,stderr);
+	if (n<0)
+	{
+		fprintf(stderr,"Could not write [%s]\n",argv[2]);
+		exit(1);
+	}
+	fprintf(stderr,"%lld blocks of %u bytes\n",(long long)n,blocksize);
+	exit(0);
+}
+// dhex --mkpatch [old] [new] [patch]
+void mkpatchmain(int argc,char *argv[])
+{
+	struct bfile* a;
+	struct patchstats st;
+	if (argc!=5)
+	{
+		fprintf(stderr,"Please run with %s --mkpatch [old file] [new file] [patch]\n",argv[0]);
+		exit(2);
+	}
+	a=bfile_open(argv[2]);
+	inputfile2=bfile_open(argv[3]);
+	if (a==NULL || inputfile2==NULL)
+	{
+		fprintf(stderr,"Error opening [%s]\n",(a==NULL)?argv[2]:argv[3]);
+		exit(1);
+	}
+	inputfile=a;
+	if (!patch_make(argv[4],readfile1,bfile_size(a),readfile2,bfile_size(inputfile2),&st))
+	{
+		fprintf(stderr,"Could not write [%s]\n",argv[4]);
+		exit(1);
+	}
+	fprintf(stderr,"%llu ranges, %llu bytes\n",(unsigned long long)st.ranges,(unsigned long long)st.bytes);
+	exit(0);
+}
+// dhex --grep [pattern] [-j threads] [--open] [files and directories]
+// prints file:offset for every match and exits, unless --open lists them
+// and one is picked; that file is then opened at the match.
+char* grepmain(int argc,char *argv[],file_position_t* pos)
+{
+	const char* error;
+	unsigned int threads=0;
+	unsigned int sel=0;
+	int open=0;
+	int paths=0;
+	int i;
+	int n;
+	for (i=3;i<argc;i++)
+	{
+		if (strcmp(argv[i],"-j")==0 && i+1<argc) threads=stoint(argv[++i]);
+		else if (strcmp(argv[i],"--open")==0) open=1;
+		else
+		{
+			paths++;
+			if (!grep_addpath(&grepped,argv[i])) fprintf(stderr,"%s: no such file or directory\n",argv[i]);
+		}
+	}
+	if (argc<3 || paths==0)
+	{
+		fprintf(stderr,"Please run with %s --grep [pattern] [-j threads] [--open] [files or directories]\n",argv[0]);
+		exit(2);
+	}
+	n=grep_run(&grepped,argv[2],threads,open?NULL:stdout,&error);
+	if (n<0)
+	{
+		fprintf(stderr,"%s\n",error);
+		exit(2);
+	}
+	if (grepped.failed) fprintf(stderr,"%u files could not be opened\n",grepped.failed);
+	if (!open) exit(n?0:1);
+	uimain();
+	uistarted=1;
+	if (!greppanel(stdscr,&sel))
+	{
+		endwin();
+		exit(n?0:1);
+	}
+	// F5 goes on to the next match
+	free(regexstring);
+	regexstring=malloc(strlen(argv[2])+1);
+	memcpy(regexstring,argv[2],strlen(argv[2])+1);
+	searchregex=1;
+	searchkind=0;
+	*pos=grepped.hit[sel].pos;
+	return grepped.name[grepped.hit[sel].file];
+}
+// the record sizes of the selection (or of the bytes from the cursor on).
+// Enter makes the rows that wide and starts the view at the region
+int stridepanel(WINDOW* parent_window,file_position_t cp,file_position_t filesize,file_position_t* target)
+{
+	struct stride found[STRIDE_MAX];
+	unsigned char* buf;
+	file_position_t start;
+	file_position_t end;
+	unsigned int len;
+	unsigned int n;
+	unsigned int sel=0;
+	unsigned int y;
+	int ch;
+	if (marked) selection(cp,filesize,&start,&end);
+	else
+	{
+		start=cp;
+		end=(filesize-cp>STRIDE_NOMARK)?cp+STRIDE_NOMARK:filesize;
+	}
+	if (end-start>STRIDE_REGION) end=start+STRIDE_REGION;
+	len=end-start;
+	draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	headline(parent_window,1,0,"RECORD SIZE");
+	wattrset(parent_window,attrs[COLOR_TEXT]);
+	mvwprintw(parent_window,2,1,"Correlating %u bytes...",len);
+	wrefresh(parent_window);
+	buf=malloc(len+1);
+	len=readedited(start,buf,len);
+	n=stride_find(buf,len,STRIDE_MAXLAG,found,STRIDE_MAX);
+	free(buf);
+	for (;;)
+	{
+		if (sel>=n) sel=n?n-1:0;
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"RECORD SIZE");
 		wattrset(parent_window,attrs[COLOR_TEXT]);
-		mvwprintw(parent_window,wtop+1,wleft+1,"Goto where? (Enter +x or -x to");
-		mvwprintw(parent_window,wtop+2,wleft+1,"jump relative to your position)");
-		m=1;
-		while (m==1)
+		mvwprintw(parent_window,1,16," %llX..%llX, rows are %s ",(unsigned long long)start,(unsigned long long)(start+len),viewcols?"that wide":"as wide as fits");
+		for (y=0;y<n && (int)y<LINES-4;y++)
+		{
+			wattrset(parent_window,attrs[(y==sel)?COLOR_MENU_HI:COLOR_MENU]);
+			mvwprintw(parent_window,y+2,1,"%6u bytes  %5X hex  %3d%%",found[y].lag,found[y].lag,(int)(found[y].score*100));
+		}
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		if (n==0) mvwprintw(parent_window,2,1,"No record size stands out");
+		wattrset(parent_window,attrs[COLOR_BRACKETS]);
+		mvwprintw(parent_window,LINES-2,2,"[Enter: rows of that size  0: as wide as fits]");
+		wrefresh(parent_window);
+		ch=getch2();
+		if (ch==KEY_ESC || ch==KEY_CANCEL || ch==KEY_F(10)) break;
+		if (ch=='0')
+		{
+			viewcols=0;
+			break;
+		}
+		if ((ch==KEY_RETURN || ch==KEY_ENTER || ch==10) && n)
+		{
+			viewcols=found[sel].lag;
+			*target=start;
+			break;
+		}
+		if (ch==KEY_DOWN && sel+1<n) sel++;
+		if (ch==KEY_UP && sel>0) sel--;
+	}
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	return (ch==KEY_RETURN || ch==KEY_ENTER || ch==10) && n;
+}
+// zoom in (dir>0) or out around the cell at o of a range that is split in n
+void plotzoom(file_position_t* lo,file_position_t* hi,file_position_t size,unsigned int o,unsigned int n,int dir)
+{
+	file_position_t c;
+	file_position_t w;
+	w=*hi-*lo;
+	c=*lo+(w+n-1)/n*o;
+	if (dir>0) w=(w/2>n)?w/2:n;
+	else w=(w*2<size)?w*2:size;
+	if (w>size) w=size;
+	*lo=(c>w/2)?c-w/2:0;
+	if (*lo+w>size) *lo=size-w;
+	*hi=*lo+w;
+}
+int dotplotpanel(WINDOW* parent_window,file_position_t* target)
+{
+	struct bfile* other;
+	file_position_t* cell;
+	file_position_t ca;
+	file_position_t cb;
+	file_position_t d;
+	unsigned int height;
+	unsigned int width;
+	unsigned int y;
+	unsigned int x;
+	int ch=0;
+	other=inputfile2?inputfile2:inputfile;
+	height=LINES-4;
+	width=COLS-2;
+	if (plot.bfa==NULL)
+	{
+		if (!dotplot_start(&plot,inputfile,other,plotfixed?skipblocksize:0)) return 0;
+		plota0=0;
+		plota1=plot.sizea;
+		plotb0=0;
+		plotb1=plot.sizeb;
+	}
+	cell=malloc(height*width*sizeof(file_position_t));
+	for (;;)
+	{
+		if (plotrow>=height) plotrow=height-1;
+		if (plotcol>=width) plotcol=width-1;
+		ca=(plota1-plota0+height-1)/height;
+		cb=(plotb1-plotb0+width-1)/width;
+		d=(ca<cb)?ca:cb;
+		if (d==0) d=1;
+		dotplot_render(&plot,plota0,plota1,plotb0,plotb1,height,width,cell);
+		draw_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+		headline(parent_window,1,0,"DOTPLOT");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		if (plot.running) mvwprintw(parent_window,1,12," %u matches, %3u%% ",plot.num,(unsigned int)(plot.done*100/(plot.sizea+plot.sizeb?plot.sizea+plot.sizeb:1)));
+		else mvwprintw(parent_window,1,12," %u matches%s ",plot.num,plot.truncated?", not all":"");
+		for (y=0;y<height;y++)
+		{
+			wmove(parent_window,y+2,1);
+			for (x=0;x<width;x++)
+			{
+				wattrset(parent_window,attrs[(y==plotrow && x==plotcol)?COLOR_MENU_HI:COLOR_MENU]);
+				if (cell[y*width+x]>=d) waddch(parent_window,'#');
+				else if (cell[y*width+x]>=d/2) waddch(parent_window,'+');
+				else if (cell[y*width+x]>=d/8) waddch(parent_window,':');
+				else if (cell[y*width+x]>0) waddch(parent_window,'.');
+				else waddch(parent_window,' ');
+			}
+		}
+		wattrset(parent_window,attrs[COLOR_BRACKETS]);
+		mvwprintw(parent_window,LINES-2,2,"[                                                      ]");
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		mvwprintw(parent_window,LINES-2,3,"A %10llX B %10llX  %-26s",(unsigned long long)(plota0+plotrow*ca),(unsigned long long)(plotb0+plotcol*cb),plotfixed?"fixed blocks":"content defined");
+		wrefresh(parent_window);
+		timeout(plot.running?200:-1);
+		ch=getch();
+		timeout(-1);
+		if (ch==ERR) continue;
+		if (ch==KEY_ESC || ch==KEY_CANCEL || ch==KEY_F(10)) break;
+		if (ch==KEY_RETURN || ch==KEY_ENTER || ch==10)
+		{
+			*target=plota0+plotrow*ca;
+			if (*target>=plot.sizea) *target=plot.sizea?plot.sizea-1:0;
+			break;
+		}
+		if (ch==KEY_DOWN && plotrow+1<height) plotrow++;
+		if (ch==KEY_UP && plotrow>0) plotrow--;
+		if (ch==KEY_RIGHT && plotcol+1<width) plotcol++;
+		if (ch==KEY_LEFT && plotcol>0) plotcol--;
+		if (ch=='+' || ch=='=' || ch=='-')
+		{
+			plotzoom(&plota0,&plota1,plot.sizea,plotrow,height,(ch=='-')?-1:1);
+			plotzoom(&plotb0,&plotb1,plot.sizeb,plotcol,width,(ch=='-')?-1:1);
+			plotrow=height/2;
+			plotcol=width/2;
+		}
+		if (ch==KEY_HOME)
+		{
+			plota0=0;
+			plota1=plot.sizea;
+			plotb0=0;
+			plotb1=plot.sizeb;
+		}
+		if (ch=='f' || ch=='F')
+		{
+			// the view stays, only the matches are computed again
+			plotfixed=!plotfixed;
+			dotplot_start(&plot,inputfile,other,plotfixed?skipblocksize:0);
+		}
+	}
+	free(cell);
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,1,0,LINES-2,COLS-1,' ');
+	return ch!=KEY_ESC && ch!=KEY_CANCEL && ch!=KEY_F(10);
+}
+void checksums(WINDOW* parent_window,file_position_t start,file_position_t end)
+{
+	struct digestjob job;
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int ch=0;
+	int i;
+	wtop=LINES/2-5;
+	wbot=wtop+9;
+	wleft=COLS/2-39;
+	wright=wleft+77;
+	if (LINES<=12 || COLS<=78) return;
+	if (!digest_start(&job,inputfile,start,end)) return;
+	draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+	headline(parent_window,wtop,wleft,"CHECKSUMS");
+	wattrset(parent_window,attrs[COLOR_TEXT]);
+	mvwprintw(parent_window,wtop+2,wleft+2,"Range    %10llX - %10llX (%llu bytes)",(unsigned long long)start,(unsigned long long)(end?end-1:0),(unsigned long long)(end-start));
+	while (job.running && ch!=KEY_ESC && ch!=KEY_F(10))
+	{
+		wattrset(parent_window,attrs[COLOR_TEXT]);
+		mvwprintw(parent_window,wtop+4,wleft+2,"%3u%%",(unsigned int)((job.done-start)*100/(end>start?end-start:1)));
+		wrefresh(parent_window);
+		timeout(100);
+		ch=getch();
+		timeout(-1);
+	}
+	digest_stop(&job);
+	wattrset(parent_window,attrs[COLOR_TEXT]);
+	if (job.done==end)
+	{
+		mvwprintw(parent_window,wtop+4,wleft+2,"CRC32    %08X",job.d.crc32);
+		mvwprintw(parent_window,wtop+5,wleft+2,"CRC32C   %08X",job.d.crc32c);
+		mvwprintw(parent_window,wtop+6,wleft+2,"SHA-1    ");
+		for (i=0;i<20;i++) wprintw(parent_window,"%02x",job.sha1[i]);
+		mvwprintw(parent_window,wtop+7,wleft+2,"SHA-256  ");
+		for (i=0;i<32;i++) wprintw(parent_window,"%02x",job.sha256[i]);
+		wattrset(parent_window,attrs[COLOR_MENU_HI]);
+		mvwprintw(parent_window,wtop+8,wleft+1,"OK");
+		wrefresh(parent_window);
+		getch2();
+	}
+	wattrset(parent_window,attrs[COLOR_HEXFIELD]);
+	erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
+}
+// FILL takes hex digits, anything else in between is ignored
+void setfillpattern(const char* s)
+{
+	unsigned char pat[16];
+	unsigned int n=0;
+	int hi=-1;
+	int v;
+	for (;*s && n<sizeof(pat);s++)
+	{
+		if (*s>='0' && *s<='9') v=*s-'0';
+		else if (*s>='a' && *s<='f') v=*s-'a'+10;
+		else if (*s>='A' && *s<='F') v=*s-'A'+10;
+		else continue;
+		if (hi<0) hi=v;
+		else
+		{
+			pat[n++]=(hi<<4)|v;
+			hi=-1;
+		}
+	}
+	if (n==0) return;
+	memcpy(fillpattern,pat,n);
+	fillpatternlen=n;
+	for (v=0;v<(int)n;v++) sprintf(fillpatternhex+2*v,"%02X",pat[v]);
+}
+int special(WINDOW* parent_window)
+{
+	int wtop;
+	int wbot;
+	int wleft;
+	int wright;
+	int m=0;
+	int action=0;
+	char* s;
+	wtop=LINES/2-7;
+	wbot=wtop+15;
+	wleft=COLS/2-27;
+	wright=wleft+54;
+	new_menu(1);
+	menu_item(0,wtop+1,wleft+1,"Skip %Blocksize",'b','B',0);
+	menu_item(1,wtop+3,wleft+5,"%Dim erased blocks",'d','D',0);
+	menu_item(2,wtop+5,wleft+1,"%Strings",'s','S',0);
+	menu_item(3,wtop+6,wleft+1,"Strings min. %length",'l','L',0);
+	menu_item(4,wtop+7,wleft+1,"C%hecksums",'h','H',0);
+	menu_item(5,wtop+1,wleft+30,"%Fill selection",'f','F',0);
+	menu_item(6,wtop+2,wleft+30,"Fill p%attern",'a','A',0);
+	menu_item(7,wtop+4,wleft+30,"C%opy selection",'o','O',0);
+	menu_item(8,wtop+5,wleft+30,"%Paste",'p','P',0);
+	menu_item(9,wtop+6,wleft+30,"%Insert bytes",'i','I',0);
+	menu_item(10,wtop+7,wleft+30,"D%elete selection",'e','E',0);
+	menu_item(11,wtop+8,wleft+1,"%Value search",'v','V',0);
+	menu_item(12,wtop+8,wleft+30,"%Narrow down",'n','N',0);
+	menu_item(13,wtop+9,wleft+30,"Diff s%ummary",'u','U',0);
+	menu_item(14,wtop+10,wleft+1,"Diff %mask",'m','M',0);
+	menu_item(15,wtop+10,wleft+30,"Dotplo%t",'t','T',0);
+	menu_item(16,wtop+14,wleft+30,"%Where is file 2",'w','W',0);
+	menu_item(17,wtop+9,wleft+1,"Record si%ze",'z','Z',0);
+	menu_item(18,wtop+12,wleft+1,"Bit patte%rn",'r','R',0);
+	menu_item(19,wtop+12,wleft+30,"%XOR/ADD/ROL search",'x','X',0);
+	menu_item(20,wtop+13,wleft+30,"Patch (ma%ke/apply)",'k','K',0);
+	menu_item(21,wtop+13,wleft+1,"%Jump to a hit",'j','J',0);
+	menu_item(22,wtop+14,wleft+1,"%%Cancel",'c','C',0);
+	if (LINES>17 && COLS>54)
+	{
+		draw_frame(parent_window,wtop,wleft,wbot,wright,' ');
+		headline(parent_window,wtop,wleft,"SPECIAL");
+		while (m!=22 && action==0)
 		{
 			wattrset(parent_window,attrs[COLOR_BRACKETS]);
-			mvwprintw(parent_window,wtop+4,wleft+5,"[           ]");	
+			mvwprintw(parent_window,wtop+2,wleft+1,"[          ]"); 
+			mvwprintw(parent_window,wtop+3,wleft+1,"( )");
+			mvwprintw(parent_window,wtop+6,wleft+22,"[   ]");
+			mvwprintw(parent_window,wtop+3,wleft+30,"[                  ]");
+			mvwprintw(parent_window,wtop+6,wleft+43,"[          ]");
+			mvwprintw(parent_window,wtop+11,wleft+1,"[                                                  ]");
 			wattrset(parent_window,attrs[COLOR_TEXT]);
-			mvwprintw(parent_window,wtop+4,wleft+6,"%11X",ap);	
-			m=menu_show(parent_window);	
-		
-			if (m==1)
+			mvwprintw(parent_window,wtop+11,wleft+2,"%-50.50s",masktext);
+			mvwprintw(parent_window,wtop+2,wleft+2,"%10u",skipblocksize);
+			mvwprintw(parent_window,wtop+6,wleft+23,"%3u",stringsminlen);
+			mvwprintw(parent_window,wtop+3,wleft+31,"%-18.18s",fillpatternhex);
+			mvwprintw(parent_window,wtop+6,wleft+44,"%10llu",(unsigned long long)insertcount);
+			if (dimerased==1) mvwprintw(parent_window,wtop+3,wleft+2,"X"); 
+			m=menu_show(parent_window);
+			if (m==0)
 			{
-//				s=input2(parent_window,wtop+4,wleft+6,11,tohex2(ap2,10),11,0,0);// TODO: er zeigt mir hier mist an. warum??
-				s=input2(parent_window,wtop+4,wleft+6,11,"\0",11,0,0);// TODO: er zeigt mir hier mist an. warum??
-				plus=0;
-				minus=0;
-				value=(int)stohex(s);
-				for (i=0;i<strlen(s);i++)
+				s=input2(parent_window,wtop+2,wleft+2,10,"",10,0,0);
+				if (stoint(s)>0) skipblocksize=stoint(s);
+				free(s);
+			}
+			if (m==1) dimerased=1-dimerased;
+			if (m==2) action=SPECIAL_STRINGS;
+			if (m==3)
+			{
+				s=input2(parent_window,wtop+6,wleft+23,3,"",3,0,0);
+				if (stoint(s)>0) stringsminlen=stoint(s);
+				free(s);
+			}
+			if (m==4) action=SPECIAL_CHECKSUMS;
+			if (m==5) action=SPECIAL_FILL;
+			if (m==6)
+			{
+				s=input2(parent_window,wtop+3,wleft+31,18,"",32,0,0);
+				setfillpattern(s);
+				free(s);
+			}
+			if (m==7) action=SPECIAL_COPY;
+			if (m==8) action=SPECIAL_PASTE;
+			if (m==9)
+			{
+				s=input2(parent_window,wtop+6,wleft+44,10,"",10,0,0);
+				if (strncmp(s,"0x",2)==0) insertcount=stohex(s+2); else insertcount=stoint(s);
+				if (insertcount>0) action=SPECIAL_INSERT; else insertcount=1;
+				free(s);
+			}
+			if (m==10) action=SPECIAL_DELETE;
+			if (m==11) action=SPECIAL_VALUE;
+			if (m==12) action=SPECIAL_NARROW;
+			if (m==13) action=SPECIAL_DIFFSUMMARY;
+			if (m==15) action=SPECIAL_DOTPLOT;
+			if (m==16) action=SPECIAL_LOCATE;
+			if (m==17) action=SPECIAL_STRIDE;
+			if (m==18) action=SPECIAL_BITS;
+			if (m==19) action=SPECIAL_XFORM;
+			if (m==20) action=SPECIAL_PATCH;
+			if (m==21) action=SPECIAL_RESULTS;
+			if (m==14)
+			{
+				s=input2(parent_window,wtop+11,wleft+2,50,"",63,0,0);
+				if (mask_parse(&diffmask,s)) strncpy(masktext,s,sizeof(masktext)-1);
+				else
 				{
-					if (s[i]=='-' || s[i]=='m') {value=ap2-value;i=20;}
-					if (s[i]=='+' || s[i]=='p') {value=ap2+value;i=20;}
+					wattrset(parent_window,attrs[COLOR_TEXT]);
+					mvwprintw(parent_window,wtop+11,wleft+2,"%-50.50s","that is not a mask");
+					wrefresh(parent_window);
+					getch2();
 				}
-				if (value<=filesize) ap=value;
 				free(s);
-			} else if (m==0) ap=ap2;
+			}
 		}
+		wattrset(parent_window,attrs[COLOR_HEXFIELD]);
 		erase_frame(parent_window,wtop,wleft,wbot,wright,' ');
 	}
-	return ap;	
+	return action;
 }
 //#ifndef fpos_t
 //#define fpos_t file_position_t
@@ -950,7 +3221,7 @@ int gotowhere( WINDOW* parent_window,
 int main(int argc,char *argv[])
 {
 	int hexnotasc=1;
-	int ch;
+	int ch=0;
 	int ch2=0;
 	file_position_t p=0;
 
@@ -960,65 +3231,165 @@ int main(int argc,char *argv[])
 	file_position_t filesize2 = 0;
 	file_position_t rfilesize2;
 	file_position_t ap2;
-    	fpos_t help;
-	unsigned char c1,c2;
-	file_position_t tmpp;
+	file_position_t src;
+	file_position_t selstart;
+	file_position_t selend;
+	unsigned char byte;
+	char* filename1=NULL;
+	char* filename2=NULL;
+	const char* error;
+	const char* region;
+	char regionname[256];
+	char shiftedwhat[32];
+	char* patchfile=NULL;
+	struct patchstats pst;
+	int pid=0;
+	int grepopen=0;
+	file_position_t drawnp=0;	// where the last frame started
+	unsigned int skipped=0;		// frames left out for keys that were waiting
+	int dir;
+	uint64_t framestart;
 
 	unsigned int i;
 	int j;
 	
 	searchstring=malloc(1);
+	regexstring=malloc(1);
 	writesearchfilename=malloc(1);
 	readsearchfilename=malloc(1);
 	searchstring[0]=0;
+	regexstring[0]=0;
 	writesearchfilename[0]=0;
 	readsearchfilename[0]=0;
-	if (argc<2)
+	if (argc>=2 && ((strcmp(argv[1],"-gpl")==0)||(strcmp(argv[1],"-GPL")==0))) {
+		print_gpl();	
+		exit(0);
+	}
+	if (argc>=3 && strcmp(argv[1],"--mkdb")==0) mkdbmain(argc,argv);
+	if (argc>=2 && strcmp(argv[1],"--mkpatch")==0) mkpatchmain(argc,argv);
+	if (argc>=2 && strcmp(argv[1],"--grep")==0)
+	{
+		// like after a search, the cursor is one behind where the match begins
+		filename1=grepmain(argc,argv,&p);
+		cp=p+1;
+		argc=1;
+		grepopen=1;
+	}
+	for (i=1;(int)i<argc;i++)
+	{
+		if (strcmp(argv[i],"-b")==0 && (int)i+1<argc)
+		{
+			i++;
+			if (strncmp(argv[i],"0x",2)==0) skipblocksize=stohex(argv[i]+2); else skipblocksize=stoint(argv[i]);
+			if (skipblocksize==0) skipblocksize=512;
+		}
+		else if (strcmp(argv[i],"-dim")==0) dimerased=1;
+		else if (strcmp(argv[i],"-mask")==0 && (int)i+1<argc)
+		{
+			i++;
+			if (!mask_parse(&diffmask,argv[i]))
+			{
+				fprintf(stderr,"Not a mask [%s]\n",argv[i]);
+				exit(1);
+			}
+			strncpy(masktext,argv[i],sizeof(masktext)-1);
+		}
+		else if (strcmp(argv[i],"--db")==0 && (int)i+1<argc)
+		{
+			i++;
+			if (!hashdb_open(&knowndb,argv[i]))
+			{
+				fprintf(stderr,"Not a block database [%s]\n",argv[i]);
+				exit(1);
+			}
+		}
+		else if (strcmp(argv[i],"--patch")==0 && (int)i+1<argc) patchfile=argv[++i];
+		else if (strcmp(argv[i],"--direct")==0) bfile_scanmode(SCANIO_DIRECT);
+		else if (strcmp(argv[i],"--stats")==0) statsshown=1;
+		else if (strncmp(argv[i],"--stats=",8)==0 && argv[i][8]!=0)
+		{
+			statsfile=argv[i]+8;
+			statsshown=1;
+		}
+		else if ((strcmp(argv[i],"--pid")==0 || strcmp(argv[i],"-pid")==0) && (int)i+1<argc)
+		{
+			i++;
+			pid=stoint(argv[i]);
+		}
+		else if (filename1==NULL) filename1=argv[i];
+		else if (filename2==NULL) filename2=argv[i];
+	}
+	if ((filename1==NULL && pid<=0) || (pid>0 && filename1!=NULL))
 	{
 		fprintf(stderr,"Please run with %s [inputfile] or %s [inputfile] [diffile]\n",argv[0],argv[0]);
+		fprintf(stderr,"or with %s --pid [pid] to look at a running process\n",argv[0]);
+		fprintf(stderr,"or with %s --grep [pattern] [-j threads] [--open] [files or directories]\n",argv[0]);
+		fprintf(stderr,"Options: -b [blocksize]  granularity of NextBlk/PrevBlk (default 512)\n");
+		fprintf(stderr,"         -dim            dim blocks that are all 00 or all FF\n");
+		fprintf(stderr,"         -mask [mask]    bytes the diff ignores, e.g. 2048..2111/2112\n");
+		fprintf(stderr,"         --db [database] colour the blocks that are in it (make one with\n");
+		fprintf(stderr,"                         %s --mkdb [database] [-b blocksize] [files])\n",argv[0]);
+		fprintf(stderr,"         --patch [patch] open with the patch applied as unsaved changes\n");
+		fprintf(stderr,"                         (make one with %s --mkpatch [old] [new] [patch])\n",argv[0]);
+		fprintf(stderr,"         --direct        searches and checksums read past the page cache\n");
+		fprintf(stderr,"         --stats         timings and i/o counters in the status line (^T)\n");
+		fprintf(stderr,"         --stats=[file]  the same, and the totals written to the file at the exit\n");
 		exit(1);
 	}
-	if ((strcmp(argv[1],"-gpl")==0)||(strcmp(argv[1],"-GPL")==0)) {
-		print_gpl();	
-		exit(0);
+	if (statsfile!=NULL)
+	{
+		if (samefile(statsfile,filename1) || samefile(statsfile,filename2))
+		{
+			fprintf(stderr,"Not writing the stats over [%s]\n",statsfile);
+			exit(1);
+		}
+		atexit(statsexit);
 	}
-	inputfile=fopen(argv[1],"r");
+	if (pid>0)
+	{
+		inputfile=bfile_openpid(pid);
+		if (inputfile==NULL)
+		{
+			fprintf(stderr,"Error opening process [%d]\n",pid);
+			exit(1);
+		}
+		filename1=inputfile->filename;
+	} else inputfile=bfile_open(filename1);
 	if (inputfile==NULL) 
 	{
-		fprintf(stderr,"Error opening inputfile [%s]\n",argv[1]);
+		fprintf(stderr,"Error opening inputfile [%s]\n",filename1);
 		exit(1);
 	}
-	fseek(inputfile,0,SEEK_END);
-	fgetpos(inputfile, &help);
-#ifdef LINUX
-	filesize = *((file_position_t*) &help);
-#else
-	filesize=(file_position_t)help;
-#endif
+	filesize=bfile_size(inputfile);
+	if (filesize>0xFFFFFFFFFFULL) poscols=12;
+	edit_open(inputfile);
+	if (patchfile!=NULL)
+	{
+		if (!patch_apply(patchfile,readedited,filesize,&pst,&error))
+		{
+			fprintf(stderr,"Cannot apply [%s]: %s\n",patchfile,error);
+			exit(1);
+		}
+		filesize=edit_size();
+	}
 //	filesize=100;
-	rfilesize=filesize;
-	fseek(inputfile,0,SEEK_SET);
-	if (argc>=3)
+	rfilesize=bfile_size(inputfile);
+	if (filename2!=NULL)
 	{
-		inputfile2=fopen(argv[2],"r");
+		inputfile2=bfile_open(filename2);
 		if (inputfile2==NULL) 
 		{
-			fprintf(stderr,"Error opening diffile [%s]\n",argv[2]);
+			fprintf(stderr,"Error opening diffile [%s]\n",filename2);
 			exit(1);
 		}
-		fseek(inputfile2,0,SEEK_END);
-		fgetpos(inputfile2,&help);
-#ifdef LINUX
-		filesize2= *((file_position_t*) &help);
-#else
-		filesize2= (file_position_t) help;
-#endif
+		filesize2=bfile_size(inputfile2);
 		rfilesize2=filesize2;
-		fseek(inputfile2,0,SEEK_SET);
 		diffnotedit=1;
 	}
+	sessionload(grepopen?NULL:&p,&cp);
+	if (knowndb.map!=NULL && inputfile->type!=BFILE_PROCESS) hashdb_start(&knownscan,&knowndb,inputfile);
 //	while (!feof(inputfile)) fgets(NULL,1000,inputfile);
-	uimain();
+	if (!uistarted) uimain();
 	//init();
 	wclear(stdscr);
 	wrefresh(stdscr);
@@ -1033,22 +3404,91 @@ int main(int argc,char *argv[])
 	
 	for (;;)
 	{	
-		draw_mainheadline(stdscr,0,argv[1]);
-		wattrset(stdscr,attrs[COLOR_HEXFIELD]);
-		if (diffnotedit==0) {
-		  print_hex(stdscr,p,cp,filesize,rfilesize,hexnotasc,ch2); 
-		} else {
-		  print_hex_diff(stdscr,p,p,filesize,filesize2,argv[2]);
+		// keys that only move pile up while a frame is drawn, a held
+		// PageDown would lag far behind. they are all taken before the
+		// next frame, but a frame every COALESCE_KEYS keys shows the way
+		if ((ch==KEY_UP || ch==KEY_DOWN || ch==KEY_LEFT || ch==KEY_RIGHT || ch==KEY_NPAGE || ch==KEY_PPAGE) && skipped<COALESCE_KEYS && keywaiting()) skipped++;
+		else
+		{
+			skipped=0;
+			framestart=stats_now();
+			draw_mainheadline(stdscr,0,filename1);
+			wattrset(stdscr,attrs[COLOR_HEXFIELD]);
+			if (diffnotedit==0) {
+			  showhits(p,rows*cols);
+			  print_hex(stdscr,p,cp,filesize,hexnotasc,ch2); 
+			  region=bfile_regionname(inputfile,cp);
+			  if (knownscan.bf!=NULL && edit_source(cp,&src)) region=knownblock(src);
+			  if (viewbits)
+			  {
+				  snprintf(shiftedwhat,sizeof(shiftedwhat),"SHIFTED %u BITS",viewbits);
+				  region=shiftedwhat;
+			  }
+			  if (foundwhat!=NULL) region=foundwhat;
+			  if (region!=NULL)
+			  {
+				  // keep clear of the filename on the right
+				  j=COLS-(int)strlen(filename1)-2*poscols-14;
+				  if (j>(int)sizeof(regionname)-1) j=sizeof(regionname)-1;
+				  if (j>0)
+				  {
+					  snprintf(regionname,j+1,"%s",region);
+					  headline(stdscr,0,2*poscols+6,regionname);
+				  }
+			  }
+			  foundwhat=NULL;
+			} else {
+			  print_hex_diff(stdscr,p,p,filesize,filesize2,filename2);
+			}
+			draw_menu(stdscr);
+			wrefresh(stdscr);
+			stats_frame(framestart);
+			if (statsshown) draw_stats(stdscr);
+			if (p!=drawnp)
+			{
+				// scrolling: have what comes next read in the meantime
+				dir=(p>drawnp)?1:-1;
+				bfile_prefetch(inputfile,(dir>0)?p+rows*cols:p,dir);
+				if (inputfile2!=NULL && (int64_t)p>=diffshift) bfile_prefetch(inputfile2,(dir>0)?p-diffshift+rows*cols:p-diffshift,dir);
+				drawnp=p;
+			}
+			sessionp=p;
+			sessioncp=cp;
 		}
-		draw_menu(stdscr);
+		if (inputfile->type==BFILE_PROCESS) timeout(LIVE_INTERVAL);
+		else if (knownscan.running) timeout(200);
+		else if (sessiondirty) timeout(SESSION_IDLE);
 		ch=getch2();
+		timeout(-1);
+		if (ch==ERR && inputfile->type!=BFILE_PROCESS)
+		{
+			// a pause: keep the session, in case the terminal goes away,
+			// if the keys changed anything it keeps
+			if (sessiondirty && !knownscan.running)
+			{
+				if (sessionchanged()) sessionsave(1,1);
+				sessiondirty=0;
+			}
+			continue;
+		}
+		sessiondirty=1;
+		if (ch==ERR)
+		{
+			// nothing pressed: sample the process again
+			bfile_refresh(inputfile);
+			livesample=1;
+			continue;
+		}
 		if (hexnotasc==1)
 		{
 			if (ch=='!') ch=KEY_F(1);
 			if (ch=='@') ch=KEY_F(2);
 			if (ch=='#') ch=KEY_F(3);
+			if (ch=='$') ch=KEY_F(4);
 			if (ch=='%') ch=KEY_F(5);
 			if (ch=='^') ch=KEY_F(6);
+			if (ch=='&') ch=KEY_F(7);
+			if (ch=='*') ch=KEY_F(8);
 			if (ch=='(') ch=KEY_F(9);
 			if (ch==')') ch=KEY_F(10);
 			if (ch=='h') ch=KEY_LEFT;
@@ -1056,8 +3496,15 @@ int main(int argc,char *argv[])
 			if (ch=='k') ch=KEY_UP;
 			if (ch=='l') ch=KEY_RIGHT;
 			if (ch==' ') ch=KEY_NPAGE;
+			if (ch=='m') ch=KEY_F(12);
+		}
+		if (diffnotedit==1 && ch!=KEY_RETURN && ch!=9 && ch!=KEY_BTAB && ch!=KEY_LEFT && ch!=KEY_RIGHT && ch!=KEY_UP && ch!=KEY_DOWN && ch!=KEY_NPAGE && ch!=KEY_PPAGE && ch!=KEY_F(2) && ch!=KEY_F(3) && ch!=KEY_F(4) && ch!=KEY_F(7) && ch!=KEY_F(8) && ch!=KEY_F(10) && ch!=KEY_STATS) ch=0;
+		if (viewbits && diffnotedit==0 && ((hexnotasc==1 && (((ch>='0') && (ch<='9')) || ((ch>='a') && (ch<='f')) || ((ch>='A') && (ch<='F')))) || (hexnotasc==0 && ch>=32 && ch<=127)))
+		{
+			// what is typed would not land where it shows
+			foundwhat="SHIFTED VIEW, NO TYPING";
+			ch=0;
 		}
-		if (diffnotedit==1 && ch!=KEY_RETURN && ch!=9 && ch!=KEY_BTAB && ch!=KEY_LEFT && ch!=KEY_RIGHT && ch!=KEY_UP && ch!=KEY_DOWN && ch!=KEY_NPAGE && ch!=KEY_PPAGE && ch!=KEY_F(2) && ch!=KEY_F(3) &&  ch!=KEY_F(10)) ch=0;
 		if ((hexnotasc==1) && (((ch>='0') && (ch<='9')) || ((ch>='a') && (ch<='f')) || ((ch>='A') && (ch<='F')))) 
 		{
 			mvwprintw(stdscr,1,1,"h");
@@ -1066,27 +3513,32 @@ int main(int argc,char *argv[])
 				
 				ch2=ch;
 			} else {
-				if (ch2<='9') change[chnum]=(ch2-48)<<4;
-				else if (ch2<='F') change[chnum]=(ch2-55)<<4;
-				else if (ch2<='f') change[chnum]=(ch2-87)<<4;
-				if (ch<='9') change[chnum]=change[chnum]+(ch-48);
-				else if (ch<='F') change[chnum]=change[chnum]+(ch-55);
-				else if (ch<='f') change[chnum]=change[chnum]+(ch-87);
-				chpos[chnum]=cp;
-				chnum++;
+				if (ch2<='9') byte=(ch2-48)<<4;
+				else if (ch2<='F') byte=(ch2-55)<<4;
+				else if (ch2<='f') byte=(ch2-87)<<4;
+				if (ch<='9') byte=byte+(ch-48);
+				else if (ch<='F') byte=byte+(ch-55);
+				else if (ch<='f') byte=byte+(ch-87);
+				edit_overwrite(cp,&byte,1);
+				filesize=edit_size();
 				ch2=0;
 				ch=KEY_RIGHT;
-				if (cp==filesize) filesize++;
 			}
 		} else ch2=0;
 		if ((hexnotasc==0) && (ch>=32) && (ch<=127)) 
 		{
-			chpos[chnum]=cp;
-			change[chnum]=ch;
-			chnum++;
+			byte=ch;
+			edit_overwrite(cp,&byte,1);
+			filesize=edit_size();
 			ch=KEY_RIGHT;
 		}
 		if (diffnotedit==0 && (ch==KEY_BTAB || ch==9)) hexnotasc=1-hexnotasc;
+		if (ch==KEY_STATS)
+		{
+			statsshown=!statsshown;
+			wattrset(stdscr,attrs[COLOR_MENU]);
+			mvwprintw(stdscr,LINES-1,0,"%*s",COLS,"");
+		}
 		if (ch==12 || ch==KEY_F(11) || ch==KEY_REFRESH) {
 			wattrset(stdscr,attrs[COLOR_HEXFIELD]);
 			wclear(stdscr);
@@ -1133,23 +3585,15 @@ int main(int argc,char *argv[])
 			if (ch==KEY_RIGHT && ((p<filesize) || (p<filesize2))) p++;
 			if (ch==KEY_BTAB || ch==9 || ch==KEY_RETURN) 
 			{
-				tmpp=p+1;
-			        fseek(inputfile,tmpp,SEEK_SET);
-       				fseek(inputfile2,tmpp,SEEK_SET);
-				c1=0;
-				c2=0;
-				while (!feof(inputfile)&&!feof(inputfile2) && (c1==c2))
-				{
-					fread(&c1,sizeof(char),1,inputfile);
-					fread(&c2,sizeof(char),1,inputfile2);
-					if (!feof(inputfile)&&!feof(inputfile2)) if (c1==c2) tmpp++;
-				}
-				if (c1!=c2) p=tmpp;
+				stats_begin("diff");
+				p=nextdifference(p+1,filesize,filesize2,p);
+				stats_end();
 			}
 		}
 		if (ch==KEY_F(1))
 		{
 			ch=searchfor(stdscr,hexnotasc);
+			if (ch!=0) searchkind=0;
 		}
 		if (ch==KEY_F(2))
 		{
@@ -1168,6 +3612,140 @@ int main(int argc,char *argv[])
 //			wclear(stdscr);
 //			wrefresh(stdscr);
 		}
+		if (ch==KEY_F(4))
+		{
+			i=special(stdscr);
+			if (i==SPECIAL_CHECKSUMS)
+			{
+				selection(cp,filesize,&selstart,&selend);
+				checksums(stdscr,selstart,selend);
+			}
+			if (i==SPECIAL_STRINGS)
+			{
+				selection(cp,rfilesize,&selstart,&selend);
+				if (strs.bf==NULL || strs.start!=selstart || strs.end!=selend || strs.minlen!=stringsminlen)
+				{
+					stringsreset();
+					extract_start(&strs,inputfile,selstart,selend,stringsminlen);
+				}
+				if (strs.bf!=NULL && stringspanel(stdscr,&ap2))
+				{
+					if (diffnotedit==0) cp=ap2;
+					p=ap2;
+				}
+			}
+			if (i>=SPECIAL_FILL && i<=SPECIAL_DELETE && diffnotedit==0)
+			{
+				// without a mark these work on the byte under the cursor
+				if (marked) selection(cp,filesize,&selstart,&selend);
+				else
+				{
+					selstart=cp;
+					selend=(cp<filesize)?cp+1:cp;
+				}
+				if (i==SPECIAL_FILL) edit_fill(selstart,selend-selstart,fillpattern,fillpatternlen);
+				if (i==SPECIAL_COPY) edit_copy(selstart,selend-selstart);
+				if (i==SPECIAL_PASTE)
+				{
+					edit_paste(cp);
+					// where the hits moved to is not known
+					if (edit_size()!=filesize) hits_clear(&searchhits);
+				}
+				if (i==SPECIAL_INSERT)
+				{
+					edit_insert(cp,insertcount,fillpattern,fillpatternlen);
+					hits_shift(&searchhits,cp,insertcount);
+				}
+				if (i==SPECIAL_DELETE)
+				{
+					edit_delete(selstart,selend-selstart);
+					hits_shift(&searchhits,selstart,-(int64_t)(selend-selstart));
+					cp=selstart;
+				}
+				marked=0;
+				filesize=edit_size();
+				if (cp>filesize) cp=filesize;
+				if (p>cp) p=cp-cp%cols;
+			}
+			ch=0;
+			if (i==SPECIAL_VALUE && valuefor(stdscr)==KEY_F(5))
+			{
+				searchkind=1;
+				ch=KEY_F(5);
+			}
+			if (i==SPECIAL_BITS && diffnotedit==0 && bitsfor(stdscr)==KEY_F(5))
+			{
+				searchkind=3;
+				ch=KEY_F(5);
+			}
+			if (i==SPECIAL_XFORM && xformfor(stdscr)==KEY_F(5))
+			{
+				searchkind=4;
+				ch=KEY_F(5);
+			}
+			if (i==SPECIAL_PATCH && patchfor(stdscr,filesize,filesize2))
+			{
+				if (edit_size()!=filesize) hits_clear(&searchhits);
+				filesize=edit_size();
+				if (cp>filesize) cp=filesize;
+				if (p>cp) p=cp-cp%cols;
+			}
+			if (i==SPECIAL_DIFFSUMMARY && diffnotedit==1) diffsummary(stdscr,filesize,filesize2);
+			if (i==SPECIAL_STRIDE && stridepanel(stdscr,(diffnotedit==0)?cp:p,filesize,&ap2))
+			{
+				p=ap2;
+				if (diffnotedit==0) cp=ap2;
+			}
+			if (i==SPECIAL_RESULTS && resultspanel(stdscr,&ap2))
+			{
+				if (diffnotedit==0) cp=ap2;
+				p=ap2;
+			}
+			if (i==SPECIAL_LOCATE && diffnotedit==1 && locatepanel(stdscr,filesize2,&ap2)) p=ap2;
+			if (i==SPECIAL_DOTPLOT && dotplotpanel(stdscr,&ap2))
+			{
+				if (diffnotedit==0) cp=ap2;
+				p=ap2;
+			}
+			if (i==SPECIAL_NARROW && inputfile->type!=BFILE_PROCESS && narrowdown(stdscr)==KEY_F(5))
+			{
+				searchkind=2;
+				ch=KEY_F(5);
+			}
+		}
+		if (diffnotedit==0 && ch==KEY_F(12))
+		{
+			marked=!marked;
+			markpos=cp;
+		}
+		if (ch==KEY_F(7) || ch==KEY_F(8))
+		{
+			if (inputfile->type==BFILE_PROCESS)
+			{
+				// from mapping to mapping
+				cp=bfile_nextregion(inputfile,cp,(ch==KEY_F(7))?1:-1,cp);
+				p=cp;
+			}
+			else if (knownscan.bf!=NULL && diffnotedit==0)
+			{
+				// from novel block to novel block
+				ap2=knownnext(cp,(ch==KEY_F(7))?1:-1,cp);
+				if (ap2!=cp)
+				{
+					cp=ap2;
+					p=ap2;
+				}
+			}
+			else if (diffnotedit==0)
+			{
+				ap2=nextblock(cp,filesize,(ch==KEY_F(7))?1:-1);
+				if (ap2!=cp)
+				{
+					cp=ap2;
+					p=ap2;
+				}
+			} else p=nextblock(p,filesize,(ch==KEY_F(7))?1:-1);
+		}
 		if (ch==KEY_F(5))
 		{
 			if (hexnotasc==0) 
@@ -1184,18 +3762,42 @@ int main(int argc,char *argv[])
 				}
 
 			}
-			if (readsearch==0) {
+			stats_begin("search");
+			if (writesearch==0 && (readsearch==0 || searchkind!=0))
+			{
+				hits_clear(&searchhits);
+				hitsfile[0]=0;
+			}
+			showsearch(searchkind==0 && readsearch==0 && writesearch==0);
+			if (searchkind==0 && searchregex==1) searchre=bregex_compile(regexstring,&error);
+			if (searchkind==1) {
+			  cp=searchforwardvalue(cp,filesize);
+			} else if (searchkind==2) {
+			  cp=searchforwardnarrow(cp);
+			} else if (searchkind==3) {
+			  cp=searchforwardbits(cp,filesize);
+			} else if (searchkind==4) {
+			  cp=searchforwardxform(cp,filesize);
+			} else if ((searchregex==1 && searchre==NULL) || (searchregex==0 && searchmismatches>=searchstring2len && searchmismatches>0)) {
+			  // nothing to search for
+			} else if (readsearch==0) {
+			  if (searchre!=NULL) cp=searchforwardregex(cp,filesize); else
+			  if (searchmismatches>0) cp=searchforwardapprox(cp,filesize); else
 			  cp=searchforwardhex(cp,filesize); 
 			} else { 
 			  cp=searchforwardhex2(cp);
 			}
+			bregex_free(searchre);
+			searchre=NULL;
+			stats_end();
 			p=cp;
 			if (writesearch==1)
 			{
 				p=0;
 				cp=0;
 			}
-			ch=KEY_RIGHT;	
+			// the cursor goes past a byte hit, a bit hit is shown where it is
+			ch=(searchkind==3)?0:KEY_RIGHT;	
 		}
 		if (ch==KEY_F(6))
 		{
@@ -1209,7 +3811,9 @@ int main(int argc,char *argv[])
 				for (i=0;i<searchstring3len;i++) searchstring2[i]=searchstring3[i];
 
 			}
+			stats_begin("search");
 			if (readsearch==0) cp=searchbackwardhex(cp,filesize,hexnotasc); else cp=searchbackwardhex2(cp,filesize);
+			stats_end();
 			p=cp;
 			if (writesearch==1)
 			{
@@ -1223,27 +3827,21 @@ int main(int argc,char *argv[])
 		if (diffnotedit==0 && ch==KEY_LEFT && cp!=0) {cp--;if (cp<p) p--;}
 		if (ch==KEY_F(9))
 		{
-			if (chnum!=0) 
+			if (edit_undo(&ap2)) 
 			{
-				if (chpos[chnum-1]>rfilesize) 
-				{
-					filesize=rfilesize;
-					for (i=0; (int) i < chnum-1; i++) {
-					  if (filesize<chpos[i]) {
-						filesize=chpos[i]; 
-					  }
-					}
-				}
-				if (p>chpos[chnum-1] || p+cols*rows<chpos[chnum-1]) p=chpos[chnum-1];
-				if (cp>chpos[chnum-1] || cp+cols*rows<chpos[chnum-1]) cp=chpos[chnum-1];
+				// where the hits moved to is not known
+				if (edit_size()!=filesize) hits_clear(&searchhits);
+				filesize=edit_size();
+				if (p>ap2 || p+cols*rows<ap2) p=ap2;
+				if (cp>ap2 || cp+cols*rows<ap2) cp=ap2;
 				if (p>filesize) p=filesize;
 				if (cp>filesize) cp=filesize;
-				chnum--;
 			}
 		}
 		if (ch==KEY_F(10)) 
 		{
-			if (chnum!=0) exit_yesno(stdscr,argv[1]); else finish(0);
+			sessionsave(1,1);
+			if (edit_changed()) exit_yesno(stdscr,filename1); else finish(0);
 //			wclear(stdscr);
 			wrefresh(stdscr);
 		}
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "mask.h"
+
+// comparing two files while ignoring parts of them, like the OOB/ECC
+// bytes of a NAND dump. every chunk gets a keep[] mask, 0xff where the
+// bytes count, and the files are compared as (a^b)&keep.
+
+#define MASK_CHUNK 65536
+
+static int mask_number(const char **s,file_position_t *x)
+{
+	const char *p=*s;
+	char *e;
+	if (p[0]=='0' && (p[1]=='x' || p[1]=='X')) *x=strtoull(p+2,&e,16);
+	else *x=strtoull(p,&e,10);
+	if (e==p || (p[0]=='0' && (p[1]=='x' || p[1]=='X') && e==p+2)) return 0;
+	*s=e;
+	return 1;
+}
+
+// 1 if the whole text made sense. an empty text masks nothing
+int mask_parse(struct mask *m,const char *text)
+{
+	struct mask t;
+	const char *s=text;
+	memset(&t,0,sizeof(t));
+	for (;;)
+	{
+		while (*s==' ' || *s==',') s++;
+		if (*s==0) break;
+		if (t.n==MASK_MAX) return 0;
+		if (!mask_number(&s,&t.lo[t.n])) return 0;
+		t.hi[t.n]=t.lo[t.n];
+		if (s[0]=='.' && s[1]=='.')
+		{
+			s+=2;
+			if (!mask_number(&s,&t.hi[t.n])) return 0;
+		}
+		if (*s=='/')
+		{
+			s++;
+			if (!mask_number(&s,&t.period[t.n]) || t.period[t.n]==0 || t.hi[t.n]>=t.period[t.n]) return 0;
+		}
+		if (t.hi[t.n]<t.lo[t.n]) return 0;
+		if (*s!=0 && *s!=' ' && *s!=',') return 0;
+		t.n++;
+	}
+	*m=t;
+	return 1;
+}
+
+int mask_ignored(struct mask *m,file_position_t pos)
+{
+	unsigned int i;
+	file_position_t o;
+	for (i=0;i<m->n;i++)
+	{
+		o=m->period[i]?pos%m->period[i]:pos;
+		if (o>=m->lo[i] && o<=m->hi[i]) return 1;
+	}
+	return 0;
+}
+
+static void mask_clear(unsigned char *keep,file_position_t pos,unsigned int len,file_position_t lo,file_position_t hi)
+{
+	if (hi<pos || lo>=pos+len) return;
+	if (lo<pos) lo=pos;
+	if (hi>=pos+len) hi=pos+len-1;
+	memset(keep+(lo-pos),0,hi-lo+1);
+}
+
+// keep[i] is 0xff when pos+i is compared, 0 when it is masked
+void mask_build(struct mask *m,file_position_t pos,unsigned char *keep,unsigned int len)
+{
+	unsigned int i;
+	file_position_t base;
+	memset(keep,0xff,len);
+	for (i=0;i<m->n;i++)
+	{
+		if (m->period[i]==0)
+		{
+			mask_clear(keep,pos,len,m->lo[i],m->hi[i]);
+			continue;
+		}
+		for (base=pos-pos%m->period[i];base<pos+len;base+=m->period[i])
+			mask_clear(keep,pos,len,base+m->lo[i],base+m->hi[i]);
+	}
+}
+
+// bit i set where a[i] and b[i] differ in a byte that is kept, for 16 bytes
+static unsigned int mask_bits(const unsigned char *a,const unsigned char *b,const unsigned char *keep)
+{
+#ifdef __SSE2__
+	__m128i x;
+	x=_mm_and_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)a),_mm_loadu_si128((const __m128i *)b)),
+	                _mm_loadu_si128((const __m128i *)keep));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(x,_mm_setzero_si128()))^0xffff;
+#else
+	unsigned int bits=0;
+	unsigned int i;
+	for (i=0;i<16;i++) if ((a[i]^b[i])&keep[i]) bits|=1<<i;
+	return bits;
+#endif
+}
+
+// reads both files in chunks of up to MASK_CHUNK, pads the tail to 16
+static unsigned int mask_chunk(mask_readfn read1,mask_readfn read2,file_position_t pos,file_position_t end,unsigned char *a,unsigned char *b)
+{
+	unsigned int n;
+	unsigned int n2;
+	n=(end-pos<MASK_CHUNK)?end-pos:MASK_CHUNK;
+	n2=read2(pos,b,n);
+	n=read1(pos,a,n);
+	if (n2<n) n=n2;
+	memset(a+n,0,16);
+	memset(b+n,0,16);
+	return n;
+}
+
+file_position_t mask_nextdiff(struct mask *m,mask_readfn read1,mask_readfn read2,file_position_t pos,file_position_t end,file_position_t notfound)
+{
+	unsigned char *a;
+	unsigned char *b;
+	unsigned char *keep;
+	unsigned int n;
+	unsigned int i;
+	unsigned int bits;
+	a=malloc(MASK_CHUNK+16);
+	b=malloc(MASK_CHUNK+16);
+	keep=malloc(MASK_CHUNK+16);
+	while (pos<end)
+	{
+		n=mask_chunk(read1,read2,pos,end,a,b);
+		if (n==0) break;
+		mask_build(m,pos,keep,n);
+		memset(keep+n,0,16);
+		for (i=0;i<n;i+=16)
+		{
+			bits=mask_bits(a+i,b+i,keep+i);
+			if (bits)
+			{
+				pos+=i+__builtin_ctz(bits);
+				free(a);
+				free(b);
+				free(keep);
+				return pos;
+			}
+		}
+		pos+=n;
+	}
+	free(a);
+	free(b);
+	free(keep);
+	return notfound;
+}
+
+// how many kept bytes differ, in how many stretches of neighbours, and
+// how many were not looked at
+void mask_summary(struct mask *m,mask_readfn read1,mask_readfn read2,file_position_t pos,file_position_t end,file_position_t *diff,file_position_t *runs,file_position_t *ignored)
+{
+	unsigned char *a;
+	unsigned char *b;
+	unsigned char *keep;
+	unsigned int n;
+	unsigned int i;
+	unsigned int bits;
+	unsigned int last=0;	// the byte before differed
+#ifndef __SSE2__
+	unsigned int j;
+#endif
+	*diff=0;
+	*runs=0;
+	*ignored=0;
+	a=malloc(MASK_CHUNK+16);
+	b=malloc(MASK_CHUNK+16);
+	keep=malloc(MASK_CHUNK+16);
+	while (pos<end)
+	{
+		n=mask_chunk(read1,read2,pos,end,a,b);
+		if (n==0) break;
+		mask_build(m,pos,keep,n);
+		memset(keep+n,0xff,16);		// the padding is equal, so it counts as kept
+		for (i=0;i<n;i+=16)
+		{
+			bits=mask_bits(a+i,b+i,keep+i);
+			*diff+=__builtin_popcount(bits);
+			*runs+=__builtin_popcount(bits&~((bits<<1)|last));
+			last=(bits>>15)&1;
+			if (m->n==0) continue;
+#ifdef __SSE2__
+			*ignored+=16-__builtin_popcount(_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(keep+i))));
+#else
+			for (j=0;j<16;j++) if (keep[i+j]==0) (*ignored)++;
+#endif
+		}
+		pos+=n;
+	}
+	free(a);
+	free(b);
+	free(keep);
+}
@@ -0,0 +1,29 @@
+#ifndef MASK_H
+#define MASK_H
+#include "data.h"
+
+// bytes the diff does not look at:
+//   2048..2111        a range, numbers are decimal or 0x..
+//   2048..2111/2112   the same bytes of every 2112 byte page
+//   3/4               one byte lane of every 32 bit word
+// separated by blanks or commas
+
+#define MASK_MAX 32
+
+typedef unsigned int (*mask_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+
+struct mask
+{
+	unsigned int n;
+	file_position_t lo[MASK_MAX];
+	file_position_t hi[MASK_MAX];		// inclusive
+	file_position_t period[MASK_MAX];	// 0: only once
+};
+
+int mask_parse(struct mask *m,const char *text);
+int mask_ignored(struct mask *m,file_position_t pos);
+void mask_build(struct mask *m,file_position_t pos,unsigned char *keep,unsigned int len);
+file_position_t mask_nextdiff(struct mask *m,mask_readfn read1,mask_readfn read2,file_position_t pos,file_position_t end,file_position_t notfound);
+void mask_summary(struct mask *m,mask_readfn read1,mask_readfn read2,file_position_t pos,file_position_t end,file_position_t *diff,file_position_t *runs,file_position_t *ignored);
+
+#endif
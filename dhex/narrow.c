@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "narrow.h"
+
+// narrowing down where a value lives by comparing snapshots, the way memory
+// scanners do. candidates are kept per 65536 values: all of them, none, a
+// sorted list when there are few, or a bitmap. each step compares the old
+// snapshot with the new one, 16 bytes at a time, and only reads the parts
+// that still have candidates.
+
+#define NARROW_MAXARRAY 4096
+#define NARROW_SPAN 65536
+
+static uint64_t value(const unsigned char *p,unsigned int width)
+{
+	uint64_t v=0;
+	unsigned int i;
+	for (i=width;i>0;i--) v=(v<<8)|p[i-1];
+	return v;
+}
+
+static int test(uint64_t o,uint64_t n,int pred,uint64_t x)
+{
+	switch (pred)
+	{
+		case NARROW_CHANGED: return n!=o;
+		case NARROW_UNCHANGED: return n==o;
+		case NARROW_INCREASED: return n>o;
+		case NARROW_DECREASED: return n<o;
+		case NARROW_EQUALS: return n==x;
+	}
+	return 0;
+}
+
+#ifdef __SSE2__
+// one bit per lane of the compare result
+static unsigned int lanes(__m128i r,unsigned int width)
+{
+	if (width==1) return _mm_movemask_epi8(r);
+	if (width==2) return _mm_movemask_epi8(_mm_packs_epi16(r,_mm_setzero_si128()))&255;
+	return _mm_movemask_ps(_mm_castsi128_ps(r));
+}
+
+static __m128i cmpeq(__m128i a,__m128i b,unsigned int width)
+{
+	if (width==1) return _mm_cmpeq_epi8(a,b);
+	if (width==2) return _mm_cmpeq_epi16(a,b);
+	return _mm_cmpeq_epi32(a,b);
+}
+
+// a>b, unsigned
+static __m128i cmpgt(__m128i a,__m128i b,unsigned int width)
+{
+	__m128i bias;
+	if (width==1)
+	{
+		bias=_mm_set1_epi8((char)0x80);
+		return _mm_cmpgt_epi8(_mm_xor_si128(a,bias),_mm_xor_si128(b,bias));
+	}
+	if (width==2)
+	{
+		bias=_mm_set1_epi16((short)0x8000);
+		return _mm_cmpgt_epi16(_mm_xor_si128(a,bias),_mm_xor_si128(b,bias));
+	}
+	bias=_mm_set1_epi32(0x80000000U);
+	return _mm_cmpgt_epi32(_mm_xor_si128(a,bias),_mm_xor_si128(b,bias));
+}
+#endif
+
+// mask gets a bit for each of the n values where pred holds
+static void predmask(const unsigned char *o,const unsigned char *nw,unsigned int n,unsigned int width,int pred,uint64_t x,uint64_t *mask)
+{
+	unsigned int i=0;
+#ifdef __SSE2__
+	unsigned int per;
+	unsigned int bits;
+	__m128i a;
+	__m128i b;
+	__m128i r;
+	__m128i xv;
+	__m128i ones=_mm_set1_epi8((char)0xff);
+	if (width==1) xv=_mm_set1_epi8((char)x);
+	else if (width==2) xv=_mm_set1_epi16((short)x);
+	else xv=_mm_set1_epi32((int)x);
+#endif
+	memset(mask,0,(n+63)/64*8);
+#ifdef __SSE2__
+	if (width<=4)
+	{
+		per=16/width;
+		for (i=0;i+per<=n;i+=per)
+		{
+			a=_mm_loadu_si128((const __m128i *)(o+i*width));
+			b=_mm_loadu_si128((const __m128i *)(nw+i*width));
+			switch (pred)
+			{
+				case NARROW_CHANGED: r=_mm_xor_si128(cmpeq(a,b,width),ones); break;
+				case NARROW_UNCHANGED: r=cmpeq(a,b,width); break;
+				case NARROW_INCREASED: r=cmpgt(b,a,width); break;
+				case NARROW_DECREASED: r=cmpgt(a,b,width); break;
+				default: r=cmpeq(b,xv,width); break;
+			}
+			bits=lanes(r,width);
+			// per divides 64, so a group never straddles two words
+			mask[i/64]|=(uint64_t)bits<<(i%64);
+		}
+	}
+#endif
+	for (;i<n;i++) if (test(value(o+i*width,width),value(nw+i*width,width),pred,x)) mask[i/64]|=1ULL<<(i%64);
+}
+
+static void setcontainer(struct ncontainer *c,const uint64_t *bits,unsigned int count)
+{
+	unsigned int i;
+	unsigned int n=0;
+	free(c->array);
+	c->array=NULL;
+	if (count==0)
+	{
+		free(c->bits);
+		c->bits=NULL;
+		c->type=NARROW_EMPTY;
+	} else if (count<=NARROW_MAXARRAY) {
+		c->array=malloc(count*sizeof(uint16_t));
+		for (i=0;i<NARROW_SPAN;i++) if ((bits[i/64]>>(i%64))&1) c->array[n++]=i;
+		free(c->bits);
+		c->bits=NULL;
+		c->type=NARROW_ARRAY;
+	} else {
+		if (c->bits==NULL) c->bits=malloc(NARROW_SPAN/8);
+		if (c->bits!=bits) memcpy(c->bits,bits,NARROW_SPAN/8);
+		c->type=NARROW_BITMAP;
+	}
+	c->n=count;
+}
+
+static unsigned int popcount(const uint64_t *bits,unsigned int words)
+{
+	unsigned int i;
+	unsigned int n=0;
+	for (i=0;i<words;i++) n+=__builtin_popcountll(bits[i]);
+	return n;
+}
+
+// every aligned value of size bytes is a candidate
+void narrow_start(struct narrow *nr,file_position_t size,unsigned int width)
+{
+	unsigned int i;
+	narrow_free(nr);
+	nr->width=width;
+	nr->size=size;
+	nr->count=size/width;
+	nr->ncont=(nr->count+NARROW_SPAN-1)/NARROW_SPAN;
+	nr->c=calloc(nr->ncont?nr->ncont:1,sizeof(struct ncontainer));
+	for (i=0;i<nr->ncont;i++) nr->c[i].type=NARROW_FULL;
+}
+
+void narrow_free(struct narrow *nr)
+{
+	unsigned int i;
+	for (i=0;i<nr->ncont;i++)
+	{
+		free(nr->c[i].array);
+		free(nr->c[i].bits);
+	}
+	free(nr->c);
+	memset(nr,0,sizeof(struct narrow));
+}
+
+// keeps the candidates where pred holds between the old and the new snapshot
+uint64_t narrow_apply(struct narrow *nr,narrow_readfn oldfn,narrow_readfn newfn,file_position_t newsize,int pred,uint64_t x)
+{
+	unsigned char *o;
+	unsigned char *nw;
+	uint64_t *mask;
+	struct ncontainer *c;
+	unsigned int w=nr->width;
+	unsigned int k;
+	unsigned int i;
+	unsigned int n;
+	unsigned int first;
+	unsigned int last;
+	unsigned int kept;
+	file_position_t base;
+	file_position_t values;
+	if (w<8) x&=(1ULL<<(8*w))-1;
+	o=malloc(NARROW_SPAN*w);
+	nw=malloc(NARROW_SPAN*w);
+	mask=malloc(NARROW_SPAN/8);
+	values=(newsize<nr->size?newsize:nr->size)/w;
+	nr->count=0;
+	for (k=0;k<nr->ncont;k++)
+	{
+		c=&nr->c[k];
+		if (c->type==NARROW_EMPTY) continue;
+		base=(file_position_t)k*NARROW_SPAN;
+		n=(values>base)?((values-base<NARROW_SPAN)?values-base:NARROW_SPAN):0;
+		if (c->type==NARROW_ARRAY)
+		{
+			// only the stretch between the first and the last candidate
+			while (c->n>0 && c->array[c->n-1]>=n) c->n--;
+			if (c->n==0)
+			{
+				setcontainer(c,mask,0);
+				continue;
+			}
+			first=c->array[0];
+			last=c->array[c->n-1]+1;
+			memset(o,0,(last-first)*w);
+			memset(nw,0,(last-first)*w);
+			oldfn((base+first)*w,o,(last-first)*w);
+			newfn((base+first)*w,nw,(last-first)*w);
+			kept=0;
+			for (i=0;i<c->n;i++)
+			{
+				if (test(value(o+(c->array[i]-first)*w,w),value(nw+(c->array[i]-first)*w,w),pred,x)) c->array[kept++]=c->array[i];
+			}
+			c->n=kept;
+			if (kept==0) setcontainer(c,mask,0);
+			nr->count+=kept;
+			continue;
+		}
+		memset(mask,0,NARROW_SPAN/8);
+		if (n>0)
+		{
+			memset(o,0,n*w);
+			memset(nw,0,n*w);
+			oldfn(base*w,o,n*w);
+			newfn(base*w,nw,n*w);
+			predmask(o,nw,n,w,pred,x,mask);
+		}
+		if (c->type==NARROW_BITMAP) for (i=0;i<NARROW_SPAN/64;i++) mask[i]&=c->bits[i];
+		kept=popcount(mask,NARROW_SPAN/64);
+		setcontainer(c,mask,kept);
+		nr->count+=kept;
+	}
+	if (newsize<nr->size) nr->size=newsize;
+	free(o);
+	free(nw);
+	free(mask);
+	return nr->count;
+}
+
+// the offset of the first candidate at or after pos
+file_position_t narrow_next(struct narrow *nr,file_position_t pos,file_position_t notfound)
+{
+	file_position_t idx;
+	unsigned int k;
+	unsigned int i;
+	unsigned int lo;
+	unsigned int hi;
+	struct ncontainer *c;
+	if (nr->width==0) return notfound;
+	idx=(pos+nr->width-1)/nr->width;
+	for (k=idx/NARROW_SPAN;k<nr->ncont;k++)
+	{
+		c=&nr->c[k];
+		i=(idx>(file_position_t)k*NARROW_SPAN)?idx-(file_position_t)k*NARROW_SPAN:0;
+		if (c->type==NARROW_FULL && (file_position_t)k*NARROW_SPAN+i<nr->size/nr->width) return ((file_position_t)k*NARROW_SPAN+i)*nr->width;
+		if (c->type==NARROW_ARRAY)
+		{
+			lo=0;
+			hi=c->n;
+			while (lo<hi)
+			{
+				if (c->array[(lo+hi)/2]<i) lo=(lo+hi)/2+1; else hi=(lo+hi)/2;
+			}
+			if (lo<c->n) return ((file_position_t)k*NARROW_SPAN+c->array[lo])*nr->width;
+		}
+		if (c->type==NARROW_BITMAP)
+		{
+			for (;i<NARROW_SPAN;i++)
+			{
+				if ((i%64)==0 && c->bits[i/64]==0)
+				{
+					i+=63;
+					continue;
+				}
+				if ((c->bits[i/64]>>(i%64))&1) return ((file_position_t)k*NARROW_SPAN+i)*nr->width;
+			}
+		}
+	}
+	return notfound;
+}
@@ -0,0 +1,42 @@
+#ifndef NARROW_H
+#define NARROW_H
+#include "data.h"
+
+#define NARROW_CHANGED 0
+#define NARROW_UNCHANGED 1
+#define NARROW_INCREASED 2
+#define NARROW_DECREASED 3
+#define NARROW_EQUALS 4
+
+#define NARROW_EMPTY 0
+#define NARROW_FULL 1
+#define NARROW_ARRAY 2
+#define NARROW_BITMAP 3
+
+// the candidates of 65536 consecutive values, like a roaring bitmap
+struct ncontainer
+{
+	int type;
+	unsigned int n;
+	uint16_t *array;		// sorted, up to NARROW_MAXARRAY
+	uint64_t *bits;			// 1024 words
+};
+
+// which values (little endian, width bytes, aligned) are still candidates
+struct narrow
+{
+	unsigned int width;
+	file_position_t size;
+	unsigned int ncont;
+	struct ncontainer *c;
+	uint64_t count;
+};
+
+typedef unsigned int (*narrow_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+
+void narrow_start(struct narrow *nr,file_position_t size,unsigned int width);
+void narrow_free(struct narrow *nr);
+uint64_t narrow_apply(struct narrow *nr,narrow_readfn oldfn,narrow_readfn newfn,file_position_t newsize,int pred,uint64_t x);
+file_position_t narrow_next(struct narrow *nr,file_position_t pos,file_position_t notfound);
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "edit.h"
+#include "patch.h"
+
+// both ways stream: making a patch reads the two files a chunk at a time
+// and holds one range at the most, applying it reads the patch twice, once
+// to see that every range fits the file and once to hand it to the edit
+// layer. the whole patch is then one step to undo.
+
+#define PATCH_CHUNK 1048576
+
+static int writerange(FILE *f,file_position_t pos,const unsigned char *buf,unsigned int len,patch_readfn reada,file_position_t asize,struct patchstats *st)
+{
+	unsigned char *old;
+	unsigned int n=0;
+	uint64_t off=pos;
+	uint32_t lc[2];
+	if (pos<asize)
+	{
+		n=(asize-pos<len)?asize-pos:len;
+		old=malloc(n);
+		n=reada(pos,old,n);
+		lc[1]=crc32(0,old,n);
+		free(old);
+	} else lc[1]=crc32(0,NULL,0);
+	lc[0]=len;
+	st->ranges++;
+	st->bytes+=len;
+	return fwrite(&off,sizeof(off),1,f)==1 && fwrite(lc,sizeof(lc),1,f)==1 && fwrite(buf,len,1,f)==1;
+}
+
+int patch_make(const char *filename,patch_readfn reada,file_position_t asize,patch_readfn readb,file_position_t bsize,struct patchstats *st)
+{
+	FILE *f;
+	unsigned char *a;
+	unsigned char *b;
+	unsigned char *run;
+	unsigned int runlen=0;		// 0: no range open
+	unsigned int lastdiff=0;	// the range ends after this many bytes
+	file_position_t runpos=0;
+	file_position_t pos;
+	uint64_t hdr[2];
+	uint32_t lc[2]={0,0};
+	unsigned int n;
+	unsigned int na;
+	unsigned int i;
+	int ok=1;
+	int differs;
+	memset(st,0,sizeof(*st));
+	f=fopen(filename,"wb");
+	if (f==NULL) return 0;
+	hdr[0]=asize;
+	hdr[1]=bsize;
+	fwrite(PATCH_MAGIC,8,1,f);
+	fwrite(hdr,sizeof(hdr),1,f);
+	a=malloc(PATCH_CHUNK);
+	b=malloc(PATCH_CHUNK);
+	run=malloc(PATCH_MAXRUN);
+	for (pos=0;ok && pos<bsize;pos+=n)
+	{
+		n=(bsize-pos<PATCH_CHUNK)?bsize-pos:PATCH_CHUNK;
+		if (readb(pos,b,n)!=n)
+		{
+			ok=0;
+			break;
+		}
+		na=0;
+		if (pos<asize) na=reada(pos,a,(asize-pos<n)?asize-pos:n);
+		for (i=0;ok && i<n;i++)
+		{
+			// nothing open and nothing different, skip ahead
+			if (runlen==0 && i+64<=na && memcmp(a+i,b+i,64)==0)
+			{
+				i+=63;
+				continue;
+			}
+			differs=(i>=na || a[i]!=b[i]);
+			if (runlen==0 && !differs) continue;
+			if (runlen==0) runpos=pos+i;
+			run[runlen++]=b[i];
+			if (differs) lastdiff=runlen;
+			if (runlen-lastdiff>PATCH_GAP || runlen==PATCH_MAXRUN)
+			{
+				ok=writerange(f,runpos,run,lastdiff,reada,asize,st);
+				runlen=0;
+			}
+		}
+	}
+	if (ok && runlen>0) ok=writerange(f,runpos,run,lastdiff,reada,asize,st);
+	hdr[0]=bsize;
+	if (ok) ok=fwrite(hdr,sizeof(uint64_t),1,f)==1 && fwrite(lc,sizeof(lc),1,f)==1;
+	free(a);
+	free(b);
+	free(run);
+	if (fclose(f)!=0) ok=0;
+	if (!ok) remove(filename);
+	return ok;
+}
+
+static int readhead(FILE *f,uint64_t *hdr)
+{
+	char magic[8];
+	return fread(magic,8,1,f)==1 && memcmp(magic,PATCH_MAGIC,8)==0 && fread(hdr,sizeof(uint64_t)*2,1,f)==1;
+}
+
+// the next range, 0 at the end, -1 when it does not add up
+static int readrange(FILE *f,uint64_t *hdr,uint64_t *off,uint32_t *lc,uint64_t *prevend)
+{
+	if (fread(off,sizeof(uint64_t),1,f)!=1 || fread(lc,sizeof(uint32_t)*2,1,f)!=1) return -1;
+	if (lc[0]==0) return (*off==hdr[1])?0:-1;
+	// in order, inside the new file, and no gap behind the end of the old one
+	if (lc[0]>PATCH_MAXRUN || *off<*prevend || *off+lc[0]>hdr[1] || (*off>hdr[0] && *off!=*prevend)) return -1;
+	*prevend=*off+lc[0];
+	return 1;
+}
+
+// the first time through only checks the old bytes, the second changes them
+static int walk(FILE *f,uint64_t *hdr,int apply,patch_readfn read,file_position_t size,unsigned char *buf,struct patchstats *st,const char **error)
+{
+	uint64_t off;
+	uint64_t prevend=0;
+	uint32_t lc[2];
+	unsigned int n;
+	int r;
+	fseek(f,8+2*sizeof(uint64_t),SEEK_SET);
+	while ((r=readrange(f,hdr,&off,lc,&prevend))==1)
+	{
+		if (fread(buf,lc[0],1,f)!=1)
+		{
+			r=-1;
+			break;
+		}
+		if (apply)
+		{
+			edit_overwrite(off,buf,lc[0]);
+			st->ranges++;
+			st->bytes+=lc[0];
+			continue;
+		}
+		n=0;
+		if (off<size) n=read(off,buf,(size-off<lc[0])?size-off:lc[0]);
+		if (crc32(0,buf,n)!=lc[1])
+		{
+			*error="the file differs from what the patch was made for";
+			return 0;
+		}
+	}
+	if (r==-1)
+	{
+		*error="the patch is cut short or broken";
+		return 0;
+	}
+	return 1;
+}
+
+// size is what the file is now. nothing is changed unless all of the patch
+// fits: the file has the old size and the old bytes where the ranges go
+int patch_apply(const char *filename,patch_readfn read,file_position_t size,struct patchstats *st,const char **error)
+{
+	FILE *f;
+	unsigned char *buf;
+	uint64_t hdr[2];
+	int since;
+	int ok=0;
+	memset(st,0,sizeof(*st));
+	f=fopen(filename,"rb");
+	if (f==NULL)
+	{
+		*error="cannot open the patch";
+		return 0;
+	}
+	if (!readhead(f,hdr)) *error="not a patch";
+	else if (hdr[0]!=size) *error="made for a file of another size";
+	else
+	{
+		buf=malloc(PATCH_MAXRUN);
+		if (walk(f,hdr,0,read,size,buf,st,error))
+		{
+			since=edit_changed();
+			ok=walk(f,hdr,1,read,size,buf,st,error);
+			if (ok && hdr[1]<size) edit_delete(hdr[1],size-hdr[1]);
+			edit_squash(since);
+		}
+		free(buf);
+	}
+	fclose(f);
+	return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef PATCH_H
+#define PATCH_H
+#include "data.h"
+
+// a patch turns one file into another, of the same size or not. it is the
+// ranges that differ with their new bytes:
+//   "DHEXPTC1", u64 old size, u64 new size
+//   per range: u64 offset, u32 length, u32 crc32 of the old bytes there
+//              (as far as the old file goes), the new bytes
+//   a range of length 0 at the new size ends it
+// ranges less than PATCH_GAP bytes apart are one range.
+
+#define PATCH_MAGIC "DHEXPTC1"
+#define PATCH_GAP 16
+#define PATCH_MAXRUN 1048576		// longer ranges are split
+
+typedef unsigned int (*patch_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+
+struct patchstats
+{
+	uint64_t ranges;
+	uint64_t bytes;
+};
+
+int patch_make(const char *filename,patch_readfn reada,file_position_t asize,patch_readfn readb,file_position_t bsize,struct patchstats *st);
+int patch_apply(const char *filename,patch_readfn read,file_position_t size,struct patchstats *st,const char **error);
+
+#endif
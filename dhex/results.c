@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "results.h"
+
+// search hits that are collected before they are written out, so that they
+// can be put in a different order than they were found in
+
+void results_clear(struct results *res)
+{
+	free(res->r);
+	res->r=NULL;
+	res->num=0;
+	res->max=0;
+}
+
+void results_add(struct results *res,file_position_t offset,file_position_t len,unsigned int tag)
+{
+	if (res->num==res->max)
+	{
+		res->max=res->max?res->max*2:1024;
+		res->r=realloc(res->r,res->max*sizeof(struct result));
+	}
+	res->r[res->num].offset=offset;
+	res->r[res->num].len=len;
+	res->r[res->num].tag=tag;
+	res->num++;
+}
+
+static int cmprank(const void *a,const void *b)
+{
+	const struct result *x=a;
+	const struct result *y=b;
+	if (x->tag!=y->tag) return (x->tag<y->tag)?-1:1;
+	if (x->offset!=y->offset) return (x->offset<y->offset)?-1:1;
+	return 0;
+}
+
+// lowest tag first, then by offset
+void results_rank(struct results *res)
+{
+	qsort(res->r,res->num,sizeof(struct result),cmprank);
+}
+
+// a search file back, every hit len bytes long. the comments are skipped
+int results_read(struct results *res,const char *filename,file_position_t len)
+{
+	FILE *f;
+	char line[64];
+	char *end;
+	file_position_t t;
+	f=fopen(filename,"r");
+	if (f==NULL) return 0;
+	if (fgets(line,sizeof(line),f)==NULL || strncmp(line,"#DHEXSEARCHFILE",15)!=0)
+	{
+		fclose(f);
+		return 0;
+	}
+	while (fgets(line,sizeof(line),f)!=NULL)
+	{
+		if (line[0]=='#') continue;
+		t=strtoull(line,&end,16);
+		if (end!=line) results_add(res,t,len,0);
+	}
+	fclose(f);
+	return 1;
+}
+
+// a search file as searchforwardhex() writes it. with tagname, every run of
+// equal tags is preceded by a comment, e.g. "#DISTANCE 2"
+int results_write(struct results *res,const char *filename,const char *(*tagname)(unsigned int tag))
+{
+	FILE *f;
+	file_position_t t;
+	unsigned int i;
+	f=fopen(filename,"w");
+	if (f==NULL) return 0;
+	fprintf(f,"#DHEXSEARCHFILE\n#VERSION 0\n");
+	for (i=0;i<res->num;i++)
+	{
+		if (tagname!=NULL && (i==0 || res->r[i].tag!=res->r[i-1].tag)) fprintf(f,"#%s\n",tagname(res->r[i].tag));
+		t=res->r[i].offset;
+		fprintf(f,"%04X%04X%04X%04X\n",((int)((t>>48)&65535)),((int)((t>>32)&65535)),((int)((t>>16)&65535)),((int)(t&65535)));
+	}
+	fclose(f);
+	return 1;
+}
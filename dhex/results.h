@@ -0,0 +1,25 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+#include "data.h"
+
+struct result
+{
+	file_position_t offset;
+	file_position_t len;
+	unsigned int tag;		// what the search says about the hit, e.g. its distance
+};
+
+struct results
+{
+	struct result *r;
+	unsigned int num;
+	unsigned int max;
+};
+
+void results_clear(struct results *res);
+void results_add(struct results *res,file_position_t offset,file_position_t len,unsigned int tag);
+void results_rank(struct results *res);
+int results_read(struct results *res,const char *filename,file_position_t len);
+int results_write(struct results *res,const char *filename,const char *(*tagname)(unsigned int tag));
+
+#endif
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "runs.h"
+
+// finding the next block that is not all 0xff (erased flash) or all 0x00.
+// holes in sparse files are skipped without reading them.
+
+#define RUNS_CHUNK 1048576
+
+int runs_uniform(const unsigned char *buf,unsigned int len)
+{
+	unsigned int i=0;
+#ifdef __SSE2__
+	__m128i v;
+	__m128i acc;
+	if (len>=64)
+	{
+		v=_mm_set1_epi8(buf[0]);
+		for (i=0;i+64<=len;i+=64)
+		{
+			acc=_mm_or_si128(_mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf+i)),v),
+			                 _mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf+i+16)),v));
+			acc=_mm_or_si128(acc,_mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf+i+32)),v));
+			acc=_mm_or_si128(acc,_mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf+i+48)),v));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc,_mm_setzero_si128()))!=0xffff) return 0;
+		}
+	}
+#else
+	uint64_t v;
+	uint64_t w;
+	if (len>=8)
+	{
+		memset(&v,buf[0],sizeof(v));
+		for (i=0;i+8<=len;i+=8)
+		{
+			memcpy(&w,buf+i,sizeof(w));
+			if (w!=v) return 0;
+		}
+	}
+#endif
+	for (;i<len;i++) if (buf[i]!=buf[0]) return 0;
+	return 1;
+}
+
+file_position_t runs_next(runs_readfn readfn,runs_holefn holefn,file_position_t pos,file_position_t size,unsigned int blocksize,int dir,file_position_t notfound)
+{
+	unsigned char *buf;
+	unsigned int chunk;
+	unsigned int n;
+	unsigned int o;
+	unsigned int l;
+	file_position_t blk;
+	file_position_t start;
+	file_position_t hs,he;
+	if (blocksize==0) return notfound;
+	chunk=(RUNS_CHUNK/blocksize)*blocksize;
+	if (chunk==0) chunk=blocksize;
+	buf=malloc(chunk);
+	if (dir>0)
+	{
+		blk=(pos/blocksize+1)*blocksize;
+		while (blk<size)
+		{
+			if (holefn(blk,&hs,&he) && (he/blocksize)*blocksize>blk)
+			{
+				blk=(he/blocksize)*blocksize;
+				continue;
+			}
+			n=readfn(blk,buf,(size-blk<chunk)?size-blk:chunk);
+			if (n==0) break;
+			for (o=0;o<n;o+=blocksize)
+			{
+				l=(n-o<blocksize)?n-o:blocksize;
+				if (!runs_uniform(buf+o,l))
+				{
+					free(buf);
+					return blk+o;
+				}
+			}
+			blk+=n;
+		}
+	} else {
+		if (pos<blocksize) 
+		{
+			free(buf);
+			return notfound;
+		}
+		blk=(pos/blocksize-1)*blocksize;
+		for (;;)
+		{
+			if (holefn(blk,&hs,&he) && blk+blocksize<=he)
+			{
+				start=(hs/blocksize)*blocksize;
+				if (start==hs)
+				{
+					if (hs==0) break;
+					start=hs-blocksize;
+				}
+				if (start<blk)
+				{
+					blk=start;
+					continue;
+				}
+			}
+			start=(blk+blocksize>chunk)?blk+blocksize-chunk:0;
+			n=readfn(start,buf,blk+blocksize-start);
+			for (o=(blk-start)/blocksize+1;o>0;o--)
+			{
+				if ((o-1)*blocksize>=n) continue;
+				l=(n-(o-1)*blocksize<blocksize)?n-(o-1)*blocksize:blocksize;
+				if (!runs_uniform(buf+(o-1)*blocksize,l))
+				{
+					free(buf);
+					return start+(o-1)*blocksize;
+				}
+			}
+			if (start==0) break;
+			blk=start-blocksize;
+		}
+	}
+	free(buf);
+	return notfound;
+}
@@ -0,0 +1,11 @@
+#ifndef RUNS_H
+#define RUNS_H
+#include "data.h"
+
+typedef unsigned int (*runs_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+typedef int (*runs_holefn)(file_position_t pos,file_position_t *start,file_position_t *end);
+
+int runs_uniform(const unsigned char *buf,unsigned int len);
+file_position_t runs_next(runs_readfn readfn,runs_holefn holefn,file_position_t pos,file_position_t size,unsigned int blocksize,int dir,file_position_t notfound);
+
+#endif
@@ -0,0 +1,368 @@
+#define _GNU_SOURCE		// O_DIRECT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#endif
+#include "scanio.h"
+#include "stats.h"
+
+// slot i always holds chunk base+k with k=(i-base)%SCANIO_SLOTS, i.e.
+// chunk c is in slot c%SCANIO_SLOTS. when the reader is past the oldest
+// chunk, its slot gets the chunk after the newest. io_uring is spoken to
+// with the bare system calls: one submission per chunk, the slot buffers
+// registered so the kernel does not map them again for every read.
+
+static unsigned int rawread(int fd,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	unsigned int got=0;
+	ssize_t n;
+	while (got<len)
+	{
+		n=pread(fd,buf+got,len-got,pos+got);
+		STATS_ADD(syscalls,1);
+		if (n<=0) break;
+		got+=n;
+	}
+	return got;
+}
+
+#ifdef __NR_io_uring_setup
+struct scanring
+{
+	int fd;
+	void *sq;
+	void *cq;
+	size_t sqsize;
+	size_t cqsize;
+	struct io_uring_sqe *sqes;
+	size_t sqesize;
+	unsigned int *sqtail;
+	unsigned int *sqmask;
+	unsigned int *sqarray;
+	unsigned int *cqhead;
+	unsigned int *cqtail;
+	unsigned int *cqmask;
+	struct io_uring_cqe *cqes;
+	int fixed;			// the slot buffers are registered
+	struct iovec iov[SCANIO_SLOTS];
+	unsigned int inflight;
+};
+
+static void ringfree(struct scanring *r)
+{
+	if (r->sqes!=NULL && r->sqes!=MAP_FAILED) munmap(r->sqes,r->sqesize);
+	if (r->cq!=NULL && r->cq!=MAP_FAILED && r->cq!=r->sq) munmap(r->cq,r->cqsize);
+	if (r->sq!=NULL && r->sq!=MAP_FAILED) munmap(r->sq,r->sqsize);
+	close(r->fd);
+	free(r);
+}
+
+static struct scanring *ringopen(struct scanio *s)
+{
+	struct io_uring_params p;
+	struct scanring *r;
+	unsigned int i;
+	memset(&p,0,sizeof(p));
+	r=calloc(1,sizeof(struct scanring));
+	r->fd=syscall(__NR_io_uring_setup,SCANIO_SLOTS,&p);
+	if (r->fd<0)
+	{
+		// an old kernel, or one that does not let us
+		free(r);
+		return NULL;
+	}
+	r->sqsize=p.sq_off.array+p.sq_entries*sizeof(unsigned int);
+	r->cqsize=p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+	if (p.features&IORING_FEAT_SINGLE_MMAP)
+	{
+		if (r->cqsize>r->sqsize) r->sqsize=r->cqsize;
+		r->cqsize=r->sqsize;
+	}
+	r->sq=mmap(NULL,r->sqsize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQ_RING);
+	if (r->sq==MAP_FAILED)
+	{
+		ringfree(r);
+		return NULL;
+	}
+	if (p.features&IORING_FEAT_SINGLE_MMAP) r->cq=r->sq;
+	else r->cq=mmap(NULL,r->cqsize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_CQ_RING);
+	r->sqesize=p.sq_entries*sizeof(struct io_uring_sqe);
+	r->sqes=mmap(NULL,r->sqesize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQES);
+	if (r->cq==MAP_FAILED || r->sqes==MAP_FAILED)
+	{
+		ringfree(r);
+		return NULL;
+	}
+	r->sqtail=(unsigned int *)((char *)r->sq+p.sq_off.tail);
+	r->sqmask=(unsigned int *)((char *)r->sq+p.sq_off.ring_mask);
+	r->sqarray=(unsigned int *)((char *)r->sq+p.sq_off.array);
+	r->cqhead=(unsigned int *)((char *)r->cq+p.cq_off.head);
+	r->cqtail=(unsigned int *)((char *)r->cq+p.cq_off.tail);
+	r->cqmask=(unsigned int *)((char *)r->cq+p.cq_off.ring_mask);
+	r->cqes=(struct io_uring_cqe *)((char *)r->cq+p.cq_off.cqes);
+	for (i=0;i<SCANIO_SLOTS;i++)
+	{
+		r->iov[i].iov_base=s->slot[i].buf;
+		r->iov[i].iov_len=SCANIO_CHUNK;
+	}
+	r->fixed=(syscall(__NR_io_uring_register,r->fd,IORING_REGISTER_BUFFERS,r->iov,SCANIO_SLOTS)==0);
+	return r;
+}
+
+static void ringsubmit(struct scanio *s,unsigned int i)
+{
+	struct scanring *r=s->ring;
+	unsigned int tail=*r->sqtail;
+	unsigned int idx=tail&*r->sqmask;
+	struct io_uring_sqe *sqe=&r->sqes[idx];
+	memset(sqe,0,sizeof(*sqe));
+	sqe->fd=s->fd;
+	sqe->off=s->slot[i].pos;
+	if (r->fixed)
+	{
+		sqe->opcode=IORING_OP_READ_FIXED;
+		sqe->addr=(unsigned long)s->slot[i].buf;
+		sqe->len=SCANIO_CHUNK;
+		sqe->buf_index=i;
+	} else {
+		sqe->opcode=IORING_OP_READV;
+		sqe->addr=(unsigned long)&r->iov[i];
+		sqe->len=1;
+	}
+	sqe->user_data=i;
+	r->sqarray[idx]=idx;
+	__atomic_store_n(r->sqtail,tail+1,__ATOMIC_RELEASE);
+	r->inflight++;
+	STATS_ADD(syscalls,1);
+	if (syscall(__NR_io_uring_enter,r->fd,1,0,0,NULL,0)!=1)
+	{
+		// not taken after all, read it here
+		__atomic_store_n(r->sqtail,tail,__ATOMIC_RELEASE);
+		r->inflight--;
+		s->slot[i].len=rawread(s->fd,s->slot[i].pos,s->slot[i].buf,SCANIO_CHUNK);
+		s->slot[i].state=SCANIO_DONE;
+	}
+}
+
+// waits for one completion at least and takes all there are
+static void ringreap(struct scanio *s)
+{
+	struct scanring *r=s->ring;
+	struct scanslot *sl;
+	struct io_uring_cqe *cqe;
+	unsigned int head;
+	if (*r->cqhead==__atomic_load_n(r->cqtail,__ATOMIC_ACQUIRE))
+	{
+		syscall(__NR_io_uring_enter,r->fd,0,1,IORING_ENTER_GETEVENTS,NULL,0);
+		STATS_ADD(syscalls,1);
+	}
+	head=*r->cqhead;
+	while (head!=__atomic_load_n(r->cqtail,__ATOMIC_ACQUIRE))
+	{
+		cqe=&r->cqes[head&*r->cqmask];
+		sl=&s->slot[cqe->user_data];
+		if (cqe->res<0) sl->len=rawread(s->fd,sl->pos,sl->buf,SCANIO_CHUNK);
+		else
+		{
+			// a short read before the end, the rest the slow way
+			sl->len=cqe->res;
+			if (sl->len<SCANIO_CHUNK && sl->pos+sl->len<s->size) sl->len+=rawread(s->fd,sl->pos+sl->len,sl->buf+sl->len,SCANIO_CHUNK-sl->len);
+		}
+		sl->state=SCANIO_DONE;
+		r->inflight--;
+		head++;
+	}
+	__atomic_store_n(r->cqhead,head,__ATOMIC_RELEASE);
+}
+#else
+struct scanring
+{
+	int fd;
+};
+static struct scanring *ringopen(struct scanio *s)
+{
+	return NULL;
+}
+static void ringsubmit(struct scanio *s,unsigned int i)
+{
+}
+static void ringreap(struct scanio *s)
+{
+}
+static void ringfree(struct scanring *r)
+{
+}
+#endif
+
+static void *worker(void *arg)
+{
+	struct scanio *s=arg;
+	struct scanslot *sl;
+	unsigned int n;
+	pthread_mutex_lock(&s->lock);
+	for (;;)
+	{
+		while (!s->quit && s->queued==0) pthread_cond_wait(&s->cond,&s->lock);
+		if (s->quit) break;
+		sl=&s->slot[s->queue[--s->queued]];
+		pthread_mutex_unlock(&s->lock);
+		n=rawread(s->fd,sl->pos,sl->buf,SCANIO_CHUNK);
+		pthread_mutex_lock(&s->lock);
+		sl->len=n;
+		sl->state=SCANIO_DONE;
+		pthread_cond_broadcast(&s->cond);
+	}
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+// slot i gets chunk c
+static void submit(struct scanio *s,unsigned int i,file_position_t c)
+{
+	struct scanslot *sl=&s->slot[i];
+	sl->pos=c*SCANIO_CHUNK;
+	sl->len=0;
+	if (sl->pos>=s->size)
+	{
+		sl->state=SCANIO_DONE;
+		return;
+	}
+	sl->state=SCANIO_BUSY;
+	if (s->ring!=NULL)
+	{
+		ringsubmit(s,i);
+		return;
+	}
+	pthread_mutex_lock(&s->lock);
+	// first in, first out: the oldest chunk is wanted first
+	memmove(s->queue+1,s->queue,s->queued*sizeof(unsigned int));
+	s->queue[0]=i;
+	s->queued++;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+}
+
+static void await(struct scanio *s,unsigned int i)
+{
+	if (s->ring!=NULL)
+	{
+		while (s->slot[i].state==SCANIO_BUSY) ringreap(s);
+		return;
+	}
+	pthread_mutex_lock(&s->lock);
+	while (s->slot[i].state==SCANIO_BUSY) pthread_cond_wait(&s->cond,&s->lock);
+	pthread_mutex_unlock(&s->lock);
+}
+
+// starts reading at pos. with SCANIO_DIRECT the file is opened once more
+// with O_DIRECT, where the filesystem cannot do that it is read as usual
+struct scanio *scanio_open(int fd,const char *filename,file_position_t size,file_position_t pos,int flags)
+{
+	struct scanio *s;
+	unsigned int i;
+	s=calloc(1,sizeof(struct scanio));
+	s->fd=fd;
+	s->size=size;
+	if ((flags&SCANIO_DIRECT) && filename!=NULL)
+	{
+		s->fd=open(filename,O_RDONLY|O_DIRECT);
+		if (s->fd>=0) s->ownfd=1; else s->fd=fd;
+	}
+	for (i=0;i<SCANIO_SLOTS;i++)
+	{
+		if (posix_memalign((void **)&s->slot[i].buf,SCANIO_ALIGN,SCANIO_CHUNK)!=0)
+		{
+			scanio_close(s);
+			return NULL;
+		}
+	}
+	if (!(flags&SCANIO_NOURING)) s->ring=ringopen(s);
+	if (s->ring==NULL)
+	{
+		pthread_mutex_init(&s->lock,NULL);
+		pthread_cond_init(&s->cond,NULL);
+		for (s->threads=0;s->threads<SCANIO_THREADS;s->threads++)
+			if (pthread_create(&s->thread[s->threads],NULL,worker,s)!=0) break;
+		if (s->threads==0)
+		{
+			scanio_close(s);
+			return NULL;
+		}
+	}
+	s->base=pos/SCANIO_CHUNK;
+	for (i=0;i<SCANIO_SLOTS;i++) submit(s,(s->base+i)%SCANIO_SLOTS,s->base+i);
+	return s;
+}
+
+// [pos,pos+len) if it is ahead of what was read before and not too far,
+// otherwise 0 and the caller reads it itself
+unsigned int scanio_read(struct scanio *s,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	file_position_t c=pos/SCANIO_CHUNK;
+	file_position_t last;
+	unsigned int got=0;
+	unsigned int i;
+	unsigned int o;
+	unsigned int n;
+	if (pos>=s->size) return 0;
+	if (len>s->size-pos) len=s->size-pos;
+	last=(pos+len-1)/SCANIO_CHUNK;
+	if (c<s->base || last>=c+SCANIO_SLOTS || c>=s->base+SCANIO_SLOTS) return 0;
+	// done with everything before c: those slots go on reading further on
+	while (s->base<c)
+	{
+		i=s->base%SCANIO_SLOTS;
+		await(s,i);
+		submit(s,i,s->base+SCANIO_SLOTS);
+		s->base++;
+	}
+	while (got<len)
+	{
+		i=((pos+got)/SCANIO_CHUNK)%SCANIO_SLOTS;
+		await(s,i);
+		o=(pos+got)-s->slot[i].pos;
+		if (o>=s->slot[i].len) break;
+		n=s->slot[i].len-o;
+		if (n>len-got) n=len-got;
+		memcpy(buf+got,s->slot[i].buf+o,n);
+		got+=n;
+	}
+	return got;
+}
+
+void scanio_close(struct scanio *s)
+{
+	unsigned int i;
+	if (s==NULL) return;
+	if (s->ring!=NULL)
+	{
+		// the kernel writes into the buffers until the reads are done
+		for (i=0;i<SCANIO_SLOTS;i++) await(s,i);
+		ringfree(s->ring);
+	}
+	else if (s->threads>0)
+	{
+		pthread_mutex_lock(&s->lock);
+		s->quit=1;
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+		for (i=0;i<s->threads;i++) pthread_join(s->thread[i],NULL);
+	}
+	for (i=0;i<SCANIO_SLOTS;i++) free(s->slot[i].buf);
+	if (s->ownfd) close(s->fd);
+	free(s);
+}
+
+const char *scanio_kind(struct scanio *s)
+{
+	if (s->ring==NULL) return s->ownfd?"pread threads, O_DIRECT":"pread threads";
+	if (s->ownfd) return "io_uring, O_DIRECT";
+	return "io_uring";
+}
@@ -0,0 +1,54 @@
+#ifndef SCANIO_H
+#define SCANIO_H
+#include <pthread.h>
+#include "data.h"
+
+// reads a file from front to back ahead of whoever scans it: SCANIO_SLOTS
+// chunks are in flight at a time, through io_uring where the kernel has it,
+// otherwise through a few threads doing pread().
+
+#define SCANIO_CHUNK 1048576
+#define SCANIO_SLOTS 8
+#define SCANIO_THREADS 4
+#define SCANIO_ALIGN 4096		// O_DIRECT wants buffers and offsets aligned
+
+#define SCANIO_DIRECT 1			// bypass the page cache
+#define SCANIO_NOURING 2		// threads even where io_uring works
+
+#define SCANIO_FREE 0
+#define SCANIO_BUSY 1
+#define SCANIO_DONE 2
+
+struct scanslot
+{
+	file_position_t pos;
+	unsigned int len;
+	volatile int state;
+	unsigned char *buf;
+};
+
+struct scanring;
+
+struct scanio
+{
+	int fd;
+	int ownfd;			// 1: opened with O_DIRECT here
+	file_position_t size;
+	file_position_t base;		// chunk number of the oldest slot
+	struct scanslot slot[SCANIO_SLOTS];
+	struct scanring *ring;		// NULL: the threads
+	pthread_t thread[SCANIO_THREADS];
+	unsigned int threads;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int queue[SCANIO_SLOTS];
+	unsigned int queued;
+	int quit;
+};
+
+struct scanio *scanio_open(int fd,const char *filename,file_position_t size,file_position_t pos,int flags);
+unsigned int scanio_read(struct scanio *s,file_position_t pos,unsigned char *buf,unsigned int len);
+void scanio_close(struct scanio *s);
+const char *scanio_kind(struct scanio *s);
+
+#endif
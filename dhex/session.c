@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bfile.h"
+#include "session.h"
+
+#define SESSION_MAGIC "DHEXSESS"
+#define SESSION_VERSION 1
+
+// size, mtime, inode, and a hash of samples spread over the file, so a
+// file that was rewritten with the same size and time still shows up
+int session_identity(struct bfile *bf,uint64_t *id)
+{
+	struct stat st;
+	unsigned char buf[SESSION_SAMPLESIZE];
+	file_position_t size;
+	file_position_t pos;
+	uint64_t h=14695981039346656037ULL;
+	unsigned int n;
+	unsigned int i;
+	unsigned int j;
+	if (bf->type==BFILE_PROCESS || stat(bf->filename,&st)!=0) return 0;
+	size=bfile_size(bf);
+	for (i=0;i<SESSION_SAMPLES;i++)
+	{
+		pos=(size>SESSION_SAMPLESIZE)?(size-SESSION_SAMPLESIZE)/(SESSION_SAMPLES-1)*i:0;
+		n=bfile_read(bf,pos,buf,SESSION_SAMPLESIZE);
+		for (j=0;j<n;j++) h=(h^buf[j])*1099511628211ULL;
+		if (size<=SESSION_SAMPLESIZE) break;
+	}
+	id[0]=size;
+	id[1]=(uint64_t)st.st_mtim.tv_sec*1000000000ULL+st.st_mtim.tv_nsec;
+	id[2]=st.st_ino;
+	id[3]=h;
+	return 1;
+}
+
+int session_create(struct session *s,struct bfile *bf,const uint64_t *id)
+{
+	uint64_t hdr[1+SESSION_ID];
+	memset(s,0,sizeof(struct session));
+	memcpy(hdr+1,id,SESSION_ID*sizeof(uint64_t));
+	s->name=bfile_sidecar(bf->filename,".dhexsession");
+	if (s->name==NULL) return 0;
+	s->tmp=malloc(strlen(s->name)+5);
+	sprintf(s->tmp,"%s.tmp",s->name);
+	s->f=fopen(s->tmp,"wb");
+	if (s->f==NULL)
+	{
+		session_close(s);
+		return 0;
+	}
+	hdr[0]=SESSION_VERSION;
+	fwrite(SESSION_MAGIC,8,1,s->f);
+	fwrite(hdr,sizeof(hdr),1,s->f);
+	return 1;
+}
+
+void session_begin(struct session *s,const char *tag)
+{
+	uint64_t len=0;
+	fwrite(tag,4,1,s->f);
+	s->section=ftell(s->f);
+	fwrite(&len,sizeof(len),1,s->f);
+}
+
+void session_end(struct session *s)
+{
+	uint64_t len;
+	long here;
+	here=ftell(s->f);
+	len=here-s->section-sizeof(len);
+	fseek(s->f,s->section,SEEK_SET);
+	fwrite(&len,sizeof(len),1,s->f);
+	fseek(s->f,here,SEEK_SET);
+}
+
+// the old session is only replaced by a complete new one
+int session_commit(struct session *s)
+{
+	int ok=1;
+	if (ferror(s->f)) ok=0;
+	if (fclose(s->f)!=0) ok=0;
+	s->f=NULL;
+	if (ok && rename(s->tmp,s->name)!=0) ok=0;
+	if (!ok) unlink(s->tmp);
+	session_close(s);
+	return ok;
+}
+
+int session_open(struct session *s,struct bfile *bf,const uint64_t *id)
+{
+	char magic[8];
+	uint64_t hdr[1+SESSION_ID];
+	memset(s,0,sizeof(struct session));
+	s->name=bfile_sidecar(bf->filename,".dhexsession");
+	if (s->name==NULL) return 0;
+	s->f=fopen(s->name,"rb");
+	if (s->f==NULL || fread(magic,8,1,s->f)!=1 || memcmp(magic,SESSION_MAGIC,8)!=0
+		|| fread(hdr,sizeof(hdr),1,s->f)!=1 || hdr[0]!=SESSION_VERSION)
+	{
+		session_close(s);
+		return 0;
+	}
+	s->same=(memcmp(hdr+1,id,SESSION_ID*sizeof(uint64_t))==0);
+	return 1;
+}
+
+// leaves the file at the beginning of the section
+int session_find(struct session *s,const char *tag,uint64_t *len)
+{
+	char t[4];
+	fseek(s->f,8+(1+SESSION_ID)*sizeof(uint64_t),SEEK_SET);
+	while (fread(t,4,1,s->f)==1 && fread(len,sizeof(uint64_t),1,s->f)==1)
+	{
+		if (memcmp(t,tag,4)==0) return 1;
+		if (fseek(s->f,*len,SEEK_CUR)!=0) return 0;
+	}
+	return 0;
+}
+
+void session_close(struct session *s)
+{
+	if (s->f!=NULL) fclose(s->f);
+	free(s->name);
+	free(s->tmp);
+	memset(s,0,sizeof(struct session));
+}
@@ -0,0 +1,39 @@
+#ifndef SESSION_H
+#define SESSION_H
+#include <stdio.h>
+#include "data.h"
+
+// what dhex remembers about a file from one run to the next, in a sidecar
+// file ([file].dhexsession, or in ~/.dhexcache). it is a list of sections,
+// each a tag and a length, so a reader skips what it does not know. the
+// header says which file it was written for: size, mtime, inode and a hash
+// of a few samples of the content. that is worked out once, when the file
+// is opened, not for every save.
+
+#define SESSION_IDLE 2000		// ms without a key, then the session is written
+#define SESSION_SAMPLES 16
+#define SESSION_SAMPLESIZE 4096
+#define SESSION_ID 4			// size, mtime, inode, hash
+
+struct bfile;
+
+struct session
+{
+	FILE *f;
+	char *name;
+	char *tmp;			// written here first, then renamed
+	int same;			// read: the file did not change since
+	long section;			// write: where the length of the open section goes
+};
+
+int session_identity(struct bfile *bf,uint64_t *id);
+int session_create(struct session *s,struct bfile *bf,const uint64_t *id);
+void session_begin(struct session *s,const char *tag);
+void session_end(struct session *s);
+int session_commit(struct session *s);
+
+int session_open(struct session *s,struct bfile *bf,const uint64_t *id);
+int session_find(struct session *s,const char *tag,uint64_t *len);
+void session_close(struct session *s);
+
+#endif
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+struct stats stats;
+
+static uint64_t opstart;
+static uint64_t opbytes;
+
+uint64_t stats_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+void stats_frame(uint64_t start)
+{
+	uint64_t t=stats_now()-start;
+	stats.frames++;
+	stats.frametime+=t;
+	stats.lastframe=t;
+	if (t>stats.maxframe) stats.maxframe=t;
+}
+
+// what is read between begin and end is what the operation read
+void stats_begin(const char *what)
+{
+	stats.lastop=what;
+	opbytes=stats.bytesread;
+	opstart=stats_now();
+}
+
+void stats_end(void)
+{
+	stats.lastoptime=stats_now()-opstart;
+	stats.lastopbytes=stats.bytesread-opbytes;
+	stats.ops++;
+	stats.optime+=stats.lastoptime;
+	stats.opbytes+=stats.lastopbytes;
+}
+
+// MB/s, bytes per ns are GB/s
+static double mbs(uint64_t bytes,uint64_t ns)
+{
+	return (ns==0)?0.0:(double)bytes*1000.0/(double)ns;
+}
+
+static unsigned int hitrate(void)
+{
+	uint64_t n=stats.cachehits+stats.cachemisses;
+	return (n==0)?100:(unsigned int)(stats.cachehits*100/n);
+}
+
+// for the status line
+void stats_line(char *s,unsigned int size)
+{
+	char op[64];
+	op[0]=0;
+	if (stats.lastop!=NULL) snprintf(op,sizeof(op),"  %s %.1fMB/s",stats.lastop,mbs(stats.lastopbytes,stats.lastoptime));
+	snprintf(s,size,"%.2fms/frame  %.1fMB read  %llu calls  cache %u%%%s",
+		stats.lastframe/1e6,stats.bytesread/1048576.0,(unsigned long long)stats.syscalls,hitrate(),op);
+}
+
+int stats_dump(const char *filename)
+{
+	FILE *f;
+	f=fopen(filename,"w");
+	if (f==NULL) return 0;
+	fprintf(f,"frames          %llu\n",(unsigned long long)stats.frames);
+	fprintf(f,"frame avg ms    %.3f\n",(stats.frames==0)?0.0:stats.frametime/1e6/stats.frames);
+	fprintf(f,"frame max ms    %.3f\n",stats.maxframe/1e6);
+	fprintf(f,"bytes read      %llu\n",(unsigned long long)stats.bytesread);
+	fprintf(f,"syscalls        %llu\n",(unsigned long long)stats.syscalls);
+	fprintf(f,"cache hits      %llu\n",(unsigned long long)stats.cachehits);
+	fprintf(f,"cache misses    %llu\n",(unsigned long long)stats.cachemisses);
+	fprintf(f,"cache hit rate  %u%%\n",hitrate());
+	fprintf(f,"operations      %llu\n",(unsigned long long)stats.ops);
+	fprintf(f,"operation bytes %llu\n",(unsigned long long)stats.opbytes);
+	fprintf(f,"operation secs  %.3f\n",stats.optime/1e9);
+	fprintf(f,"operation MB/s  %.1f\n",mbs(stats.opbytes,stats.optime));
+	return fclose(f)==0;
+}
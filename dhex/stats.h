@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+#include "data.h"
+
+// counters that stay compiled in: they are an add next to a syscall or a
+// block copy, which costs nothing against either. the scan threads and the
+// block database thread count too, hence the atomic adds.
+
+#define STATS_ADD(field,n) __atomic_fetch_add(&stats.field,(n),__ATOMIC_RELAXED)
+
+struct stats
+{
+	uint64_t syscalls;		// reads, seeks and hints on the input files
+	uint64_t bytesread;
+	uint64_t cachehits;		// small reads served from the block cache
+	uint64_t cachemisses;
+	uint64_t frames;
+	uint64_t frametime;		// ns, all frames together
+	uint64_t lastframe;
+	uint64_t maxframe;
+	uint64_t ops;			// searches and diff jumps
+	uint64_t opbytes;
+	uint64_t optime;
+	uint64_t lastopbytes;
+	uint64_t lastoptime;
+	const char *lastop;
+};
+
+extern struct stats stats;
+
+uint64_t stats_now(void);
+void stats_frame(uint64_t start);
+void stats_begin(const char *what);
+void stats_end(void);
+void stats_line(char *s,unsigned int size);
+int stats_dump(const char *filename);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stride.h"
+
+// in place, n a power of two. tw holds cos and sin of 2*pi*i/n for i<n/2,
+// sign -1 is forward and +1 backward (unscaled)
+static void stride_fft(double *re,double *im,unsigned int n,const double *tw,int sign)
+{
+	unsigned int i;
+	unsigned int j;
+	unsigned int k;
+	unsigned int len;
+	unsigned int step;
+	double wr;
+	double wi;
+	double tr;
+	double ti;
+	double t;
+	for (i=1,j=0;i<n;i++)
+	{
+		for (k=n>>1;j&k;k>>=1) j^=k;
+		j^=k;
+		if (i<j)
+		{
+			t=re[i];re[i]=re[j];re[j]=t;
+			t=im[i];im[i]=im[j];im[j]=t;
+		}
+	}
+	for (len=2;len<=n;len<<=1)
+	{
+		step=n/len;
+		for (j=0;j<len/2;j++)
+		{
+			wr=tw[2*j*step];
+			wi=sign*tw[2*j*step+1];
+			for (i=j;i<n;i+=len)
+			{
+				k=i+len/2;
+				tr=re[k]*wr-im[k]*wi;
+				ti=re[k]*wi+im[k]*wr;
+				re[k]=re[i]-tr;
+				im[k]=im[i]-ti;
+				re[i]+=tr;
+				im[i]+=ti;
+			}
+		}
+	}
+}
+
+// sum over i of x[i]*x[i+k], k<=maxlag, into r. the region is cut into
+// segments of seg bytes, zero padded to n=2*seg so that the circular
+// correlation is the linear one. two segments share one complex FFT, the
+// power spectra of both are (|Z(f)|^2+|Z(n-f)|^2)/2. of a big region only
+// STRIDE_SAMPLE bytes are taken, in segments spread over it.
+static void stride_spectral(const unsigned char *buf,double mean,unsigned int len,unsigned int maxlag,double *r,double *pairs)
+{
+	unsigned int seg;
+	unsigned int n;
+	unsigned int s;
+	unsigned int skip;
+	unsigned int i;
+	unsigned int l0;
+	unsigned int l1;
+	unsigned int k;
+	double *re;
+	double *im;
+	double *pw;
+	double *tw;
+	for (seg=1;seg<2*maxlag;seg<<=1);
+	n=2*seg;
+	tw=malloc(n*sizeof(double));
+	for (i=0;i<n/2;i++)
+	{
+		tw[2*i]=cos(2*M_PI*i/n);
+		tw[2*i+1]=sin(2*M_PI*i/n);
+	}
+	re=malloc(n*sizeof(double));
+	im=malloc(n*sizeof(double));
+	pw=calloc(n,sizeof(double));
+	skip=2*seg*((len+STRIDE_SAMPLE-1)/STRIDE_SAMPLE);
+	for (s=0;s<len;s+=skip)
+	{
+		l0=(len-s<seg)?len-s:seg;
+		l1=(len-s>seg)?((len-s-seg<seg)?len-s-seg:seg):0;
+		memset(re,0,n*sizeof(double));
+		memset(im,0,n*sizeof(double));
+		for (i=0;i<l0;i++) re[i]=buf[s+i]-mean;
+		for (i=0;i<l1;i++) im[i]=buf[s+seg+i]-mean;
+		stride_fft(re,im,n,tw,-1);
+		for (i=0;i<n;i++)
+		{
+			k=(n-i)&(n-1);
+			pw[i]+=(re[i]*re[i]+im[i]*im[i]+re[k]*re[k]+im[k]*im[k])/2;
+		}
+		for (k=0;k<=maxlag;k++)
+		{
+			if (l0>k) pairs[k]+=l0-k;
+			if (l1>k) pairs[k]+=l1-k;
+		}
+	}
+	memcpy(re,pw,n*sizeof(double));
+	memset(im,0,n*sizeof(double));
+	stride_fft(re,im,n,tw,1);
+	for (k=0;k<=maxlag;k++) r[k]=re[k]/n;
+	free(re);
+	free(im);
+	free(pw);
+	free(tw);
+}
+
+static int stride_cmp(const void *a,const void *b)
+{
+	const struct stride *x=a;
+	const struct stride *y=b;
+	if (x->score!=y->score) return (x->score>y->score)?-1:1;
+	return (x->lag<y->lag)?-1:(x->lag>y->lag);
+}
+
+// the best lags from 2 to maxlag, best first. a lag that is a multiple of
+// one that correlates nearly as well is left out: that is the same record
+// size seen twice. returns how many there are in out.
+int stride_find(const unsigned char *buf,unsigned int len,unsigned int maxlag,struct stride *out,unsigned int max)
+{
+	struct stride *c;
+	double *x;
+	double *r;
+	double *pairs;
+	double mean=0;
+	double var;
+	unsigned int i;
+	unsigned int k;
+	unsigned int n=0;
+	unsigned int m=0;
+	unsigned int j;
+	if (maxlag>STRIDE_MAXLAG) maxlag=STRIDE_MAXLAG;
+	if (maxlag>len/2) maxlag=len/2;
+	if (maxlag<3) return 0;
+	r=calloc(maxlag+2,sizeof(double));
+	pairs=calloc(maxlag+2,sizeof(double));
+	for (i=0;i<len;i++) mean+=buf[i];
+	mean/=len;
+	if ((uint64_t)len*maxlag<=STRIDE_DIRECT)
+	{
+		x=malloc(len*sizeof(double));
+		for (i=0;i<len;i++) x[i]=buf[i]-mean;
+		for (k=0;k<=maxlag;k++)
+		{
+			for (i=0;i+k<len;i++) r[k]+=x[i]*x[i+k];
+			pairs[k]=len-k;
+		}
+		free(x);
+	} else stride_spectral(buf,mean,len,maxlag,r,pairs);
+	var=(r[0]>0)?r[0]/pairs[0]:0;
+	c=malloc((maxlag+1)*sizeof(struct stride));
+	for (k=2;k<maxlag && var>0;k++)
+	{
+		if (r[k]/pairs[k]<r[k-1]/pairs[k-1] || r[k]/pairs[k]<r[k+1]/pairs[k+1] || r[k]<=0) continue;
+		c[n].lag=k;
+		c[n].score=r[k]/pairs[k]/var;
+		n++;
+	}
+	qsort(c,n,sizeof(struct stride),stride_cmp);
+	for (i=0;i<n && m<max;i++)
+	{
+		// a smaller record size that nearly explains this one wins
+		for (j=0;j<n;j++) if (c[j].lag<c[i].lag && c[i].lag%c[j].lag==0 && c[j].score>=0.8*c[i].score) break;
+		if (j<n) continue;
+		out[m++]=c[i];
+	}
+	free(c);
+	free(r);
+	free(pairs);
+	return m;
+}
@@ -0,0 +1,22 @@
+#ifndef STRIDE_H
+#define STRIDE_H
+#include "data.h"
+
+// the record size of a table: the lags at which the bytes of a region
+// correlate best with themselves. small regions are correlated directly,
+// big ones through the power spectrum of segments (an FFT per segment).
+
+#define STRIDE_MAXLAG 2048
+#define STRIDE_DIRECT 67108864		// len*maxlag up to this is done directly
+#define STRIDE_SAMPLE 4194304		// bytes of a bigger region that go into the spectrum
+#define STRIDE_MAX 16
+
+struct stride
+{
+	unsigned int lag;
+	double score;			// the correlation at that lag, 1 is perfect
+};
+
+int stride_find(const unsigned char *buf,unsigned int len,unsigned int maxlag,struct stride *out,unsigned int max);
+
+#endif
@@ -27,6 +27,17 @@ int printable(int ch)
 	if (ch>=32 && ch<=127) return 1;
 	return 0;
 }
+// is there a key that getch() would return right away?
+int keywaiting()
+{
+	int ch;
+	timeout(0);
+	ch=getch();
+	timeout(-1);
+	if (ch==ERR) return 0;
+	ungetch(ch);
+	return 1;
+}
 int getch2()
 {
 	int ch=getch();
@@ -161,6 +172,11 @@ void init_colors()
     attrs[COLOR_DIFF]=searchcolor(buffer,COLOR_YELLOW,COLOR_BLACK,COLOR_DIFF)+A_BOLD;
     attrs[COLOR_DIFF_CURSOR]=searchcolor(buffer,COLOR_YELLOW,COLOR_WHITE,COLOR_DIFF_CURSOR)+A_BOLD;
     attrs[COLOR_HEADLINE]=searchcolor(buffer,COLOR_BLACK,COLOR_CYAN,COLOR_HEADLINE);
+    attrs[COLOR_ERASED]=searchcolor(buffer,COLOR_BLUE,COLOR_BLACK,COLOR_ERASED);
+    attrs[COLOR_SELECTION]=searchcolor(buffer,COLOR_BLACK,COLOR_GREEN,COLOR_SELECTION);
+    attrs[COLOR_KNOWN]=searchcolor(buffer,COLOR_GREEN,COLOR_BLACK,COLOR_KNOWN);
+    attrs[COLOR_NOVEL]=searchcolor(buffer,COLOR_RED,COLOR_BLACK,COLOR_NOVEL)+A_BOLD;
+    attrs[COLOR_MATCH]=searchcolor(buffer,COLOR_BLACK,COLOR_YELLOW,COLOR_MATCH);
 	b2=getenv("HOME");
 	for (i=0;i<strlen(b2);i++) {
 	  b3[i]=b2[i];
@@ -197,6 +213,11 @@ void init_colors()
                         if (contains(buffer,"NORMAL_DIFF")==1) attrs[COLOR_DIFF]=searchcolor(buffer,COLOR_YELLOW,COLOR_BLACK,COLOR_DIFF)+searchattrs(buffer);
                         if (contains(buffer,"CURSOR_DIFF")==1) attrs[COLOR_DIFF_CURSOR]=searchcolor(buffer,COLOR_YELLOW,COLOR_WHITE,COLOR_DIFF_CURSOR)+searchattrs(buffer);
                         if (contains(buffer,"HEADLINE")==1) attrs[COLOR_HEADLINE]=searchcolor(buffer,COLOR_BLACK,COLOR_CYAN,COLOR_HEADLINE)+searchattrs(buffer);
+                        if (contains(buffer,"ERASED")==1) attrs[COLOR_ERASED]=searchcolor(buffer,COLOR_BLUE,COLOR_BLACK,COLOR_ERASED)+searchattrs(buffer);
+                        if (contains(buffer,"SELECTION")==1) attrs[COLOR_SELECTION]=searchcolor(buffer,COLOR_BLACK,COLOR_GREEN,COLOR_SELECTION)+searchattrs(buffer);
+                        if (contains(buffer,"KNOWN")==1) attrs[COLOR_KNOWN]=searchcolor(buffer,COLOR_GREEN,COLOR_BLACK,COLOR_KNOWN)+searchattrs(buffer);
+                        if (contains(buffer,"NOVEL")==1) attrs[COLOR_NOVEL]=searchcolor(buffer,COLOR_RED,COLOR_BLACK,COLOR_NOVEL)+searchattrs(buffer);
+                        if (contains(buffer,"MATCH")==1) attrs[COLOR_MATCH]=searchcolor(buffer,COLOR_BLACK,COLOR_YELLOW,COLOR_MATCH)+searchattrs(buffer);
 
                 }
 	}
@@ -219,6 +240,11 @@ void init_colors()
 			fprintf(f,"NORMAL_DIFF:    FG=YELLOW,BG=BLACK,BOLD\n");
 			fprintf(f,"CURSOR_DIFF:    FG=YELLOW,BG=WHITE,BOLD\n");
 			fprintf(f,"HEADLINE:       FG=BLACK,BG=CYAN\n");
+			fprintf(f,"ERASED:         FG=BLUE,BG=BLACK\n");
+			fprintf(f,"SELECTION:      FG=BLACK,BG=GREEN\n");
+			fprintf(f,"KNOWN:          FG=GREEN,BG=BLACK\n");
+			fprintf(f,"NOVEL:          FG=RED,BG=BLACK,BOLD\n");
+			fprintf(f,"MATCH:          FG=BLACK,BG=YELLOW\n");
 
 			fclose(f);
 		}
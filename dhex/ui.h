@@ -19,6 +19,11 @@
 #define COLOR_DIFF 11
 #define COLOR_DIFF_CURSOR 12
 #define COLOR_HEADLINE 13
+#define COLOR_ERASED 14
+#define COLOR_SELECTION 15
+#define COLOR_KNOWN 16
+#define COLOR_NOVEL 17
+#define COLOR_MATCH 18
 
 int lastkey;
 int attrs[255];
@@ -37,6 +42,7 @@ unsigned int MENU_updown_nleftright;
 
 int printable(int ch);
 int getch2(void);
+int keywaiting(void);
 void init_colors(void);
 char *input2(WINDOW *parent,int y,int x, unsigned int len,const char *text, unsigned int max,int special,int lastkey);
 char *input(WINDOW *parent,int y,int x, unsigned int len,const char *text, unsigned int max);
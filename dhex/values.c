@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "values.h"
+
+// searching for a number as 16, 32 and 64 bit integer and as float and
+// double, little and big endian, all in one pass: the encodings are the
+// patterns of one aho-corasick automaton. a range of 32 bit values is found
+// by comparing the words at 16 positions at once instead.
+
+#define VALUES_CHUNK 1048576
+
+static const char *names[VALUES_MAXPAT]={"U16LE","U16BE","U32LE","U32BE","U64LE","U64BE","FLOATLE","FLOATBE","DOUBLELE","DOUBLEBE"};
+
+static void addpattern(struct values *v,int name,uint64_t x,unsigned int len)
+{
+	unsigned int i;
+	unsigned int n=v->npat++;
+	for (i=0;i<len;i++)
+	{
+		v->pat[n][i]=(x>>(8*i))&255;
+		v->pat[n+1][len-1-i]=(x>>(8*i))&255;
+	}
+	v->patlen[n]=len;
+	v->patlen[n+1]=len;
+	v->name[n]=names[name];
+	v->name[n+1]=names[name+1];
+	v->npat++;
+}
+
+static void build(struct values *v)
+{
+	unsigned int max=1;
+	unsigned int p;
+	unsigned int i;
+	int s;
+	int c;
+	int *queue;
+	int *fail;
+	unsigned int qh=0;
+	unsigned int qt=0;
+	for (p=0;p<v->npat;p++) max+=v->patlen[p];
+	v->tab=malloc(max*sizeof(*v->tab));
+	v->out=calloc(max,sizeof(unsigned int));
+	fail=calloc(max,sizeof(int));
+	queue=malloc(max*sizeof(int));
+	memset(v->tab,0xff,max*sizeof(*v->tab));
+	v->nstates=1;
+	for (p=0;p<v->npat;p++)
+	{
+		s=0;
+		for (i=0;i<v->patlen[p];i++)
+		{
+			if (v->tab[s][v->pat[p][i]]<0) v->tab[s][v->pat[p][i]]=v->nstates++;
+			s=v->tab[s][v->pat[p][i]];
+		}
+		v->out[s]|=1U<<p;
+	}
+	// breadth first, every missing edge takes the one of the fail state
+	for (c=0;c<256;c++)
+	{
+		if (v->tab[0][c]<0) v->tab[0][c]=0;
+		else
+		{
+			fail[v->tab[0][c]]=0;
+			queue[qt++]=v->tab[0][c];
+		}
+	}
+	while (qh<qt)
+	{
+		s=queue[qh++];
+		v->out[s]|=v->out[fail[s]];
+		for (c=0;c<256;c++)
+		{
+			if (v->tab[s][c]<0) v->tab[s][c]=v->tab[fail[s]][c];
+			else
+			{
+				fail[v->tab[s][c]]=v->tab[fail[s]][c];
+				queue[qt++]=v->tab[s][c];
+			}
+		}
+	}
+	free(queue);
+	free(fail);
+}
+
+static int number(const char *s,char **end,int64_t *x)
+{
+	while (*s==' ') s++;
+	if (*s=='-') *x=strtoll(s,end,0); else *x=(int64_t)strtoull(s,end,0);
+	return *end!=s;
+}
+
+// "1234", "0x4D2", "-5", "3.14" or "100..200". 0 if that is not a number
+int values_parse(struct values *v,const char *text,int floats)
+{
+	int64_t x;
+	int64_t y;
+	char *end;
+	const char *dots;
+	float f;
+	double d;
+	uint32_t u;
+	uint64_t w;
+	int integer;
+	memset(v,0,sizeof(struct values));
+	dots=strstr(text,"..");
+	if (dots!=NULL)
+	{
+		if (!number(text,&end,&x) || end!=dots) return 0;
+		if (!number(dots+2,&end,&y)) return 0;
+		while (*end==' ') end++;
+		if (*end!=0) return 0;
+		v->range=1;
+		v->lo=(uint32_t)x;
+		v->hi=(uint32_t)y;
+		v->name[0]=names[2];
+		v->name[1]=names[3];
+		v->npat=2;
+		return 1;
+	}
+	integer=number(text,&end,&x);
+	while (integer && *end==' ') end++;
+	integer=integer && *end==0;
+	if (integer)
+	{
+		if (x>=-32768 && x<=65535) addpattern(v,0,(uint64_t)x,2);
+		if (x>=-2147483647LL-1 && x<=4294967295LL) addpattern(v,2,(uint64_t)x,4);
+		addpattern(v,4,(uint64_t)x,8);
+	}
+	if (floats || !integer)
+	{
+		d=strtod(text,&end);
+		while (*end==' ') end++;
+		if (end==text || *end!=0)
+		{
+			if (!integer) return 0;
+		} else {
+			f=(float)d;
+			memcpy(&u,&f,4);
+			addpattern(v,6,u,4);
+			memcpy(&w,&d,8);
+			addpattern(v,8,w,8);
+		}
+	}
+	build(v);
+	return 1;
+}
+
+void values_free(struct values *v)
+{
+	free(v->tab);
+	free(v->out);
+	v->tab=NULL;
+	v->out=NULL;
+}
+
+static uint32_t swap32(uint32_t x)
+{
+	return (x>>24)|((x>>8)&0xff00)|((x<<8)&0xff0000)|(x<<24);
+}
+
+static int inrange(struct values *v,uint32_t x)
+{
+	return x-v->lo<=v->hi-v->lo;
+}
+
+// positions [0,npos) of buf, buf has 3 more bytes
+static int rangeblock(struct values *v,const unsigned char *buf,unsigned int npos,file_position_t base,values_hitfn hitfn)
+{
+	unsigned int i=0;
+	unsigned int j;
+	uint32_t x;
+#ifdef __SSE2__
+	__m128i lo=_mm_set1_epi32(v->lo);
+	__m128i span=_mm_set1_epi32((v->hi-v->lo)^0x80000000U);
+	__m128i bias=_mm_set1_epi32(0x80000000U);
+	__m128i w;
+	__m128i b;
+	unsigned int le;
+	unsigned int be;
+	for (i=0;i+16<=npos;i+=16)
+	{
+		le=0;
+		be=0;
+		for (j=0;j<4;j++)
+		{
+			w=_mm_loadu_si128((const __m128i *)(buf+i+j));
+			// x in [lo,hi] is x-lo <= hi-lo, unsigned. sse2 only compares signed
+			b=_mm_xor_si128(_mm_sub_epi32(w,lo),bias);
+			le|=(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(b,span)))^15)<<(4*j);
+			w=_mm_shufflehi_epi16(_mm_shufflelo_epi16(w,0xb1),0xb1);
+			w=_mm_or_si128(_mm_slli_epi16(w,8),_mm_srli_epi16(w,8));
+			b=_mm_xor_si128(_mm_sub_epi32(w,lo),bias);
+			be|=(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(b,span)))^15)<<(4*j);
+		}
+		if ((le|be)==0) continue;
+		// bit 4*j+k is position 4*k+j
+		for (j=0;j<16;j++)
+		{
+			if (((le>>(4*(j&3)+j/4))&1) && hitfn(base+i+j,0)) return 1;
+			if (((be>>(4*(j&3)+j/4))&1) && hitfn(base+i+j,1)) return 1;
+		}
+	}
+#endif
+	for (;i<npos;i++)
+	{
+		x=buf[i]|(buf[i+1]<<8)|(buf[i+2]<<16)|((uint32_t)buf[i+3]<<24);
+		if (inrange(v,x) && hitfn(base+i,0)) return 1;
+		if (inrange(v,swap32(x)) && hitfn(base+i,1)) return 1;
+	}
+	return 0;
+}
+
+// hits come out of the automaton where they end, they are held back until
+// nothing that starts earlier can turn up anymore, then handed on sorted by
+// position and the longer encoding first
+struct pending
+{
+	file_position_t pos;
+	unsigned int which;
+};
+
+static int flush(struct values *v,struct pending *pend,unsigned int *npend,file_position_t upto,values_hitfn hitfn,file_position_t *oldest)
+{
+	unsigned int i;
+	unsigned int best;
+	while (*npend>0)
+	{
+		best=0;
+		for (i=1;i<*npend;i++)
+		{
+			if (pend[i].pos<pend[best].pos || (pend[i].pos==pend[best].pos && (v->patlen[pend[i].which]>v->patlen[pend[best].which] || (v->patlen[pend[i].which]==v->patlen[pend[best].which] && pend[i].which<pend[best].which)))) best=i;
+		}
+		*oldest=pend[best].pos;
+		if (pend[best].pos>=upto) return 0;
+		if (hitfn(pend[best].pos,pend[best].which)) return 1;
+		pend[best]=pend[--*npend];
+	}
+	return 0;
+}
+
+// calls hitfn for every place in [pos,end) where the value is, in order
+int values_search(struct values *v,values_readfn readfn,file_position_t pos,file_position_t end,values_hitfn hitfn)
+{
+	unsigned char *buf;
+	struct pending pend[VALUES_MAXPAT*8];
+	unsigned int npend=0;
+	unsigned int n;
+	unsigned int npos;
+	unsigned int i;
+	unsigned int p;
+	unsigned int o;
+	file_position_t oldest=0;
+	int s=0;
+	int r=0;
+	buf=malloc(VALUES_CHUNK+8);
+	while (r==0 && pos<end)
+	{
+		if (v->range)
+		{
+			n=readfn(pos,buf,(end-pos<VALUES_CHUNK+3)?end-pos:VALUES_CHUNK+3);
+			if (n<4) break;
+			npos=n-3;
+			if (npos>VALUES_CHUNK) npos=VALUES_CHUNK;
+			r=rangeblock(v,buf,npos,pos,hitfn);
+			pos+=npos;
+			continue;
+		}
+		n=readfn(pos,buf,(end-pos<VALUES_CHUNK)?end-pos:VALUES_CHUNK);
+		if (n==0) break;
+		for (i=0;i<n && r==0;i++)
+		{
+			s=v->tab[s][buf[i]];
+			o=v->out[s];
+			for (p=0;o!=0 && p<v->npat;p++)
+			{
+				if ((o>>p)&1)
+				{
+					pend[npend].pos=pos+i+1-v->patlen[p];
+					pend[npend].which=p;
+					if (npend==0 || pend[npend].pos<oldest) oldest=pend[npend].pos;
+					npend++;
+				}
+			}
+			// the longest pattern is 8 bytes, whatever ends later starts after pos+i-7
+			if (npend>0 && pos+i+1>=oldest+8) r=flush(v,pend,&npend,pos+i-6,hitfn,&oldest);
+		}
+		pos+=n;
+	}
+	if (r==0) r=flush(v,pend,&npend,(file_position_t)-1,hitfn,&oldest);
+	free(buf);
+	return r;
+}
@@ -0,0 +1,29 @@
+#ifndef VALUES_H
+#define VALUES_H
+#include "data.h"
+
+#define VALUES_MAXPAT 10
+
+// a number in every encoding it could have been stored in
+struct values
+{
+	int range;			// 1: 32 bit words between lo and hi
+	uint32_t lo;
+	uint32_t hi;
+	unsigned int npat;
+	unsigned char pat[VALUES_MAXPAT][8];
+	unsigned int patlen[VALUES_MAXPAT];
+	const char *name[VALUES_MAXPAT];
+	int (*tab)[256];		// aho-corasick automaton over all patterns
+	unsigned int *out;		// patterns that end in a state, one bit each
+	unsigned int nstates;
+};
+
+typedef unsigned int (*values_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+typedef int (*values_hitfn)(file_position_t pos,unsigned int which);	// nonzero stops
+
+int values_parse(struct values *v,const char *text,int floats);
+void values_free(struct values *v);
+int values_search(struct values *v,values_readfn readfn,file_position_t pos,file_position_t end,values_hitfn hitfn);
+
+#endif
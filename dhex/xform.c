@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "xform.h"
+
+// searching for a plaintext under all keys at once. what is compared is
+// not the bytes but something the key drops out of:
+//   xor, k byte key   b[i]^b[i+k] is p[i]^p[i+k]
+//   add, 1 byte key   b[i+1]-b[i] is p[i+1]-p[i]
+//   rotate by r bits  b[i] is p[i] rotated, there are only 7 of them
+// the first byte of each is compared for 16 positions at once.
+
+#define XFORM_CHUNK 1048576
+
+static unsigned char rol(unsigned char c,unsigned int r)
+{
+	return (c<<r)|(c>>(8-r));
+}
+
+static void add(struct xform *x,int kind,unsigned int arg)
+{
+	unsigned int t=x->n++;
+	unsigned int j;
+	x->kind[t]=kind;
+	x->arg[t]=arg;
+	if (kind==XFORM_XOR)
+	{
+		x->invlen[t]=x->len-arg;
+		for (j=0;j<x->invlen[t];j++) x->inv[t][j]=x->pat[j]^x->pat[j+arg];
+	}
+	if (kind==XFORM_ADD)
+	{
+		x->invlen[t]=x->len-1;
+		for (j=0;j<x->invlen[t];j++) x->inv[t][j]=x->pat[j+1]-x->pat[j];
+	}
+	if (kind==XFORM_ROL)
+	{
+		x->invlen[t]=x->len;
+		for (j=0;j<x->invlen[t];j++) x->inv[t][j]=rol(x->pat[j],arg);
+	}
+}
+
+// at a place where several fit, the first one is reported: a xor key that
+// repeats after fewer bytes is found as the shorter key
+int xform_prepare(struct xform *x,const unsigned char *pat,unsigned int len)
+{
+	unsigned int k;
+	if (len<XFORM_MINLEN || len>XFORM_MAXLEN) return 0;
+	memset(x,0,sizeof(*x));
+	memcpy(x->pat,pat,len);
+	x->len=len;
+	add(x,XFORM_XOR,1);
+	add(x,XFORM_ADD,1);
+	for (k=2;k<=XFORM_MAXPERIOD && len-k>=XFORM_CHECK;k++) add(x,XFORM_XOR,k);
+	for (k=1;k<8;k++) add(x,XFORM_ROL,k);
+	return 1;
+}
+
+static int matches(struct xform *x,unsigned int t,const unsigned char *b)
+{
+	unsigned int j;
+	unsigned int k=x->arg[t];
+	if (x->kind[t]==XFORM_XOR)
+	{
+		for (j=0;j<x->invlen[t];j++) if ((b[j]^b[j+k])!=x->inv[t][j]) return 0;
+	}
+	else if (x->kind[t]==XFORM_ADD)
+	{
+		for (j=0;j<x->invlen[t];j++) if (((b[j+1]-b[j])&255)!=x->inv[t][j]) return 0;
+	}
+	else for (j=0;j<x->invlen[t];j++) if (b[j]!=x->inv[t][j]) return 0;
+	return 1;
+}
+
+static int report(struct xform *x,unsigned int t,const unsigned char *b,file_position_t pos,xform_hitfn hitfn)
+{
+	unsigned char key[XFORM_MAXPERIOD];
+	unsigned int j;
+	memset(key,0,sizeof(key));
+	if (x->kind[t]==XFORM_XOR) for (j=0;j<x->arg[t];j++) key[j]=b[j]^x->pat[j];
+	if (x->kind[t]==XFORM_ADD) key[0]=b[0]-x->pat[0];
+	if (x->kind[t]==XFORM_ROL) key[0]=x->arg[t];
+	return hitfn(pos,t,key);
+}
+
+// positions [0,npos) of buf, buf has n bytes
+static int block(struct xform *x,const unsigned char *buf,unsigned int npos,unsigned int n,file_position_t base,xform_hitfn hitfn)
+{
+	unsigned int i=0;
+	unsigned int j;
+	unsigned int t;
+#ifdef __SSE2__
+	__m128i first[XFORM_MAX];
+	__m128i w;
+	__m128i d;
+	unsigned int hit[XFORM_MAX];
+	unsigned int any;
+	for (t=0;t<x->n;t++) first[t]=_mm_set1_epi8((char)x->inv[t][0]);
+	for (i=0;i+16<=npos && i+15+x->len<=n;i+=16)
+	{
+		w=_mm_loadu_si128((const __m128i *)(buf+i));
+		any=0;
+		for (t=0;t<x->n;t++)
+		{
+			if (x->kind[t]==XFORM_XOR) d=_mm_xor_si128(w,_mm_loadu_si128((const __m128i *)(buf+i+x->arg[t])));
+			else if (x->kind[t]==XFORM_ADD) d=_mm_sub_epi8(_mm_loadu_si128((const __m128i *)(buf+i+1)),w);
+			else d=w;
+			hit[t]=_mm_movemask_epi8(_mm_cmpeq_epi8(d,first[t]));
+			any|=hit[t];
+		}
+		if (any==0) continue;
+		for (j=0;j<16;j++)
+		{
+			if (((any>>j)&1)==0) continue;
+			for (t=0;t<x->n;t++)
+			{
+				if (((hit[t]>>j)&1)==0 || !matches(x,t,buf+i+j)) continue;
+				if (report(x,t,buf+i+j,base+i+j,hitfn)) return 1;
+				break;
+			}
+		}
+	}
+#endif
+	for (;i<npos && i+x->len<=n;i++)
+	{
+		for (t=0;t<x->n;t++)
+		{
+			if (!matches(x,t,buf+i)) continue;
+			if (report(x,t,buf+i,base+i,hitfn)) return 1;
+			break;
+		}
+	}
+	return 0;
+}
+
+int xform_search(struct xform *x,xform_readfn readfn,file_position_t pos,file_position_t end,xform_hitfn hitfn)
+{
+	unsigned char *buf;
+	unsigned int overlap=x->len-1;
+	unsigned int want;
+	unsigned int npos;
+	unsigned int n;
+	int r=0;
+	buf=malloc(XFORM_CHUNK+XFORM_MAXLEN);
+	while (r==0 && pos<end)
+	{
+		want=(end-pos<XFORM_CHUNK+overlap)?end-pos:XFORM_CHUNK+overlap;
+		n=readfn(pos,buf,want);
+		if (n==0) break;
+		npos=(n==want && pos+n<end)?n-overlap:n;
+		r=block(x,buf,npos,n,pos,hitfn);
+		if (n<want) break;
+		pos+=npos;
+	}
+	free(buf);
+	return r;
+}
+
+// e.g. "XOR 5A", "XOR 12 34 56", "ADD 03", "ROL 3". s has room for 32
+void xform_name(struct xform *x,unsigned int which,const unsigned char *key,char *s)
+{
+	unsigned int j;
+	if (x->kind[which]==XFORM_XOR)
+	{
+		s+=sprintf(s,"XOR");
+		for (j=0;j<x->arg[which];j++) s+=sprintf(s," %02X",key[j]);
+	}
+	if (x->kind[which]==XFORM_ADD) sprintf(s,"ADD %02X",key[0]);
+	if (x->kind[which]==XFORM_ROL) sprintf(s,"ROL %u",key[0]);
+}
@@ -0,0 +1,36 @@
+#ifndef XFORM_H
+#define XFORM_H
+#include "data.h"
+
+#define XFORM_MAXLEN 255
+#define XFORM_MINLEN 4			// shorter patterns turn up everywhere
+#define XFORM_MAXPERIOD 8		// longest repeating xor key
+#define XFORM_CHECK 3			// bytes the invariant has at least
+#define XFORM_MAX (2+(XFORM_MAXPERIOD-1)+7)
+
+#define XFORM_XOR 0
+#define XFORM_ADD 1
+#define XFORM_ROL 2
+
+// a plaintext under every key of a few simple encodings. each encoding has
+// something that does not depend on the key, e.g. b[i]^b[i+1] under a one
+// byte xor, and that is what is looked for
+struct xform
+{
+	unsigned char pat[XFORM_MAXLEN];
+	unsigned int len;
+	unsigned int n;
+	int kind[XFORM_MAX];
+	unsigned int arg[XFORM_MAX];		// key length of a xor, bits of a rotation
+	unsigned char inv[XFORM_MAX][XFORM_MAXLEN];
+	unsigned int invlen[XFORM_MAX];
+};
+
+typedef unsigned int (*xform_readfn)(file_position_t pos,unsigned char *buf,unsigned int len);
+typedef int (*xform_hitfn)(file_position_t pos,unsigned int which,const unsigned char *key);	// nonzero stops
+
+int xform_prepare(struct xform *x,const unsigned char *pat,unsigned int len);
+int xform_search(struct xform *x,xform_readfn readfn,file_position_t pos,file_position_t end,xform_hitfn hitfn);
+void xform_name(struct xform *x,unsigned int which,const unsigned char *key,char *s);
+
+#endif
@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "bfile.h"
+#include "zfile.h"
+#include "stats.h"
+
+// random access into compressed files.
+// gzip:  a checkpoint (compressed position, bit offset and the last 32k of
+//        output) is taken at a deflate block boundary every ZFILE_SPAN bytes,
+//        the same way zran.c from the zlib examples does it.
+// zstd:  every frame is a checkpoint of its own.
+// the index is written next to the file (see bfile_sidecar()), so the
+// full decompression pass only happens the first time a file is opened.
+
+#define ZFILE_SPAN (4*1048576)
+#define ZFILE_WINSIZE 32768
+#define ZFILE_CHUNK 65536
+#define ZFILE_MAGIC "DHEXZIDX"
+#define ZFILE_VERSION 1
+
+struct zpoint
+{
+	file_position_t out;
+	file_position_t in;
+	int bits;
+	unsigned int wlen;
+	unsigned char *window;		// deflated, to keep the index small
+};
+
+struct zindex
+{
+	int refs;
+	int type;
+	file_position_t size;
+	unsigned int num;
+	unsigned int max;
+	struct zpoint *points;		// gzip checkpoints or zstd frames (bits, window unused)
+};
+
+struct zfile
+{
+	int fd;
+	int type;
+	struct zindex *idx;
+	int live;
+	int raw;
+	file_position_t out;		// uncompressed position of the live stream
+	file_position_t in;		// next compressed byte to read from fd
+	z_stream strm;
+#ifdef HAVE_ZSTD
+	ZSTD_DStream *zs;
+	ZSTD_inBuffer zin;
+#endif
+	unsigned char input[ZFILE_CHUNK];
+	unsigned char output[ZFILE_CHUNK];
+};
+
+int zfile_detect(const unsigned char *magic,int len)
+{
+	if (len>=3 && magic[0]==0x1f && magic[1]==0x8b && magic[2]==8) return BFILE_GZIP;
+	if (len>=4 && magic[0]==0x28 && magic[1]==0xb5 && magic[2]==0x2f && magic[3]==0xfd) return BFILE_ZSTD;
+	return BFILE_PLAIN;
+}
+
+static struct zpoint *zfile_addpoint(struct zindex *idx)
+{
+	if (idx->num==idx->max)
+	{
+		idx->max=idx->max?idx->max*2:64;
+		idx->points=realloc(idx->points,idx->max*sizeof(struct zpoint));
+	}
+	memset(&idx->points[idx->num],0,sizeof(struct zpoint));
+	return &idx->points[idx->num++];
+}
+
+static void zfile_freeindex(struct zindex *idx)
+{
+	unsigned int i;
+	if (--idx->refs>0) return;
+	for (i=0;i<idx->num;i++) free(idx->points[i].window);
+	free(idx->points);
+	free(idx);
+}
+
+static unsigned int zfile_findpoint(struct zindex *idx,file_position_t pos)
+{
+	unsigned int lo=0;
+	unsigned int hi=idx->num;
+	unsigned int mid;
+	while (hi-lo>1)
+	{
+		mid=(lo+hi)/2;
+		if (idx->points[mid].out<=pos) lo=mid; else hi=mid;
+	}
+	return lo;
+}
+
+static int zfile_fill(struct zfile *zf,unsigned char **next,unsigned int *avail)
+{
+	ssize_t n;
+	n=pread(zf->fd,zf->input,sizeof(zf->input),zf->in);
+	STATS_ADD(syscalls,1);
+	if (n<=0) return 0;
+	zf->in+=n;
+	*next=zf->input;
+	*avail=n;
+	return 1;
+}
+
+static int zfile_saveindex(struct zindex *idx,const char *filename,struct stat *st)
+{
+	FILE *f;
+	char *name;
+	unsigned int i;
+	uint64_t hdr[6];
+	struct zpoint *pt;
+	name=bfile_sidecar(filename,".dhexidx");
+	if (name==NULL) return 0;
+	f=fopen(name,"wb");
+	free(name);
+	if (f==NULL) return 0;
+	hdr[0]=ZFILE_VERSION;
+	hdr[1]=idx->type;
+	hdr[2]=st->st_size;
+	hdr[3]=st->st_mtime;
+	hdr[4]=idx->size;
+	hdr[5]=idx->num;
+	fwrite(ZFILE_MAGIC,8,1,f);
+	fwrite(hdr,sizeof(hdr),1,f);
+	for (i=0;i<idx->num;i++)
+	{
+		pt=&idx->points[i];
+		hdr[0]=pt->out;
+		hdr[1]=pt->in;
+		hdr[2]=pt->bits;
+		hdr[3]=pt->wlen;
+		fwrite(hdr,sizeof(uint64_t),4,f);
+		if (pt->wlen) fwrite(pt->window,pt->wlen,1,f);
+	}
+	fclose(f);
+	return 1;
+}
+
+static struct zindex *zfile_loadindex(const char *filename,int type,struct stat *st)
+{
+	FILE *f;
+	char *name;
+	char magic[8];
+	unsigned int i;
+	uint64_t hdr[6];
+	struct zindex *idx;
+	struct zpoint *pt;
+	name=bfile_sidecar(filename,".dhexidx");
+	if (name==NULL) return NULL;
+	f=fopen(name,"rb");
+	free(name);
+	if (f==NULL) return NULL;
+	if (fread(magic,8,1,f)!=1 || memcmp(magic,ZFILE_MAGIC,8)!=0 || fread(hdr,sizeof(hdr),1,f)!=1
+		|| hdr[0]!=ZFILE_VERSION || hdr[1]!=(uint64_t)type || hdr[2]!=(uint64_t)st->st_size || hdr[3]!=(uint64_t)st->st_mtime)
+	{
+		fclose(f);
+		return NULL;
+	}
+	idx=calloc(1,sizeof(struct zindex));
+	idx->refs=1;
+	idx->type=type;
+	idx->size=hdr[4];
+	for (i=0;i<hdr[5];i++)
+	{
+		pt=zfile_addpoint(idx);
+		if (fread(hdr,sizeof(uint64_t),4,f)!=4 || hdr[3]>2*ZFILE_WINSIZE) break;
+		pt->out=hdr[0];
+		pt->in=hdr[1];
+		pt->bits=hdr[2];
+		pt->wlen=hdr[3];
+		if (pt->wlen)
+		{
+			pt->window=malloc(pt->wlen);
+			if (fread(pt->window,pt->wlen,1,f)!=1) break;
+		}
+	}
+	fclose(f);
+	if (i!=idx->num || idx->num==0)
+	{
+		zfile_freeindex(idx);
+		return NULL;
+	}
+	return idx;
+}
+
+static void gz_addpoint(struct zindex *idx,int bits,file_position_t in,file_position_t out,unsigned int left,unsigned char *window)
+{
+	unsigned char linear[ZFILE_WINSIZE];
+	uLongf wlen;
+	struct zpoint *pt;
+	pt=zfile_addpoint(idx);
+	pt->bits=bits;
+	pt->in=in;
+	pt->out=out;
+	if (left) memcpy(linear,window+ZFILE_WINSIZE-left,left);
+	if (left<ZFILE_WINSIZE) memcpy(linear+left,window,ZFILE_WINSIZE-left);
+	wlen=compressBound(ZFILE_WINSIZE);
+	pt->window=malloc(wlen);
+	if (compress2(pt->window,&wlen,linear,ZFILE_WINSIZE,1)!=Z_OK) wlen=0;
+	pt->wlen=wlen;
+}
+
+static struct zindex *gz_buildindex(struct zfile *zf)
+{
+	struct zindex *idx;
+	z_stream strm;
+	unsigned char window[ZFILE_WINSIZE];
+	file_position_t totin=0;
+	file_position_t totout=0;
+	file_position_t last=0;
+	int ret;
+	int ended=0;
+	memset(&strm,0,sizeof(strm));
+	if (inflateInit2(&strm,47)!=Z_OK) return NULL;
+	idx=calloc(1,sizeof(struct zindex));
+	idx->refs=1;
+	idx->type=BFILE_GZIP;
+	zf->in=0;
+	for (;;)
+	{
+		if (strm.avail_in==0 && !zfile_fill(zf,&strm.next_in,&strm.avail_in)) break;
+		if (strm.avail_out==0)
+		{
+			strm.avail_out=ZFILE_WINSIZE;
+			strm.next_out=window;
+		}
+		totin+=strm.avail_in;
+		totout+=strm.avail_out;
+		ret=inflate(&strm,Z_BLOCK);
+		totin-=strm.avail_in;
+		totout-=strm.avail_out;
+		if (ret==Z_STREAM_END)
+		{
+			// concatenated gzip members are one stream for us
+			ended=1;
+			inflateReset(&strm);
+			continue;
+		}
+		if (ret!=Z_OK && ret!=Z_BUF_ERROR)
+		{
+			if (ended) break;	// trailing garbage after the last member
+			inflateEnd(&strm);
+			zfile_freeindex(idx);
+			return NULL;
+		}
+		if ((strm.data_type & 128) && !(strm.data_type & 64) && (totout==0 || totout-last>ZFILE_SPAN))
+		{
+			gz_addpoint(idx,strm.data_type & 7,totin,totout,strm.avail_out,window);
+			last=totout;
+		}
+	}
+	inflateEnd(&strm);
+	idx->size=totout;
+	if (idx->num==0)
+	{
+		zfile_freeindex(idx);
+		return NULL;
+	}
+	return idx;
+}
+
+static int gz_start(struct zfile *zf,struct zpoint *pt)
+{
+	unsigned char window[ZFILE_WINSIZE];
+	unsigned char c;
+	uLongf wlen=ZFILE_WINSIZE;
+	if (zf->live) inflateEnd(&zf->strm);
+	zf->live=0;
+	memset(&zf->strm,0,sizeof(zf->strm));
+	if (inflateInit2(&zf->strm,-15)!=Z_OK) return 0;
+	zf->live=1;
+	zf->in=pt->in;
+	if (pt->bits)
+	{
+		if (pread(zf->fd,&c,1,pt->in-1)!=1) return 0;
+		inflatePrime(&zf->strm,pt->bits,c>>(8-pt->bits));
+	}
+	if (pt->wlen && uncompress(window,&wlen,pt->window,pt->wlen)==Z_OK && wlen==ZFILE_WINSIZE)
+		inflateSetDictionary(&zf->strm,window,ZFILE_WINSIZE);
+	zf->out=pt->out;
+	zf->raw=1;
+	return 1;
+}
+
+static int gz_skip(struct zfile *zf,unsigned int n)
+{
+	while (n)
+	{
+		if (zf->strm.avail_in==0 && !zfile_fill(zf,&zf->strm.next_in,&zf->strm.avail_in)) return 0;
+		if (zf->strm.avail_in>=n)
+		{
+			zf->strm.next_in+=n;
+			zf->strm.avail_in-=n;
+			n=0;
+		} else {
+			n-=zf->strm.avail_in;
+			zf->strm.avail_in=0;
+		}
+	}
+	return 1;
+}
+
+static unsigned int gz_read(struct zfile *zf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	unsigned int got=0;
+	unsigned int before;
+	int ret;
+	if (!zf->live || pos<zf->out || pos-zf->out>ZFILE_SPAN)
+	{
+		if (!gz_start(zf,&zf->idx->points[zfile_findpoint(zf->idx,pos)])) return 0;
+	}
+	while (got<len)
+	{
+		if (zf->strm.avail_in==0 && !zfile_fill(zf,&zf->strm.next_in,&zf->strm.avail_in)) break;
+		if (zf->out<pos)
+		{
+			zf->strm.next_out=zf->output;
+			zf->strm.avail_out=(pos-zf->out<ZFILE_CHUNK)?(pos-zf->out):ZFILE_CHUNK;
+		} else {
+			zf->strm.next_out=buf+got;
+			zf->strm.avail_out=len-got;
+		}
+		before=zf->strm.avail_out;
+		ret=inflate(&zf->strm,Z_NO_FLUSH);
+		zf->out+=before-zf->strm.avail_out;
+		if (zf->out>pos) got=zf->out-pos;
+		if (ret==Z_STREAM_END)
+		{
+			if (zf->raw)
+			{
+				// skip the crc32/isize trailer, the next member has a header again
+				if (!gz_skip(zf,8)) break;
+				inflateReset2(&zf->strm,47);
+				zf->raw=0;
+			} else inflateReset(&zf->strm);
+		} else if (ret!=Z_OK && ret!=Z_BUF_ERROR) {
+			inflateEnd(&zf->strm);
+			zf->live=0;
+			break;
+		}
+	}
+	return got;
+}
+
+#ifdef HAVE_ZSTD
+static file_position_t zs_framelen(struct zfile *zf,file_position_t pos,file_position_t *content)
+{
+	unsigned char hdr[18];
+	unsigned char bh[3];
+	unsigned long long fcs;
+	static const int didsize[4]={0,1,2,4};
+	static const int fcssize[4]={0,2,4,8};
+	size_t hsize;
+	ssize_t n;
+	file_position_t p;
+	unsigned int block;
+	int last;
+	n=pread(zf->fd,hdr,sizeof(hdr),pos);
+	if (n<8) return 0;
+	if ((hdr[0]&0xf0)==0x50 && hdr[1]==0x2a && hdr[2]==0x4d && hdr[3]==0x18)
+	{
+		*content=0;
+		return 8+(hdr[4]|(hdr[5]<<8)|(hdr[6]<<16)|((file_position_t)hdr[7]<<24));
+	}
+	// magic, descriptor, window descriptor unless single segment, dictionary id, content size
+	hsize=5+((hdr[4]&32)?0:1)+didsize[hdr[4]&3]+fcssize[hdr[4]>>6];
+	if ((hdr[4]&32) && (hdr[4]>>6)==0) hsize++;
+	fcs=ZSTD_getFrameContentSize(hdr,n);
+	if (fcs==ZSTD_CONTENTSIZE_ERROR) return 0;
+	p=pos+hsize;
+	do
+	{
+		if (pread(zf->fd,bh,3,p)!=3) return 0;
+		block=bh[0]|(bh[1]<<8)|(bh[2]<<16);
+		last=block&1;
+		p+=3+(((block>>1)&3)==1?1:(block>>3));
+	} while (!last);
+	if (hdr[4]&4) p+=4;
+	if (fcs==ZSTD_CONTENTSIZE_UNKNOWN) fcs=(unsigned long long)-1;
+	*content=fcs;
+	return p-pos;
+}
+
+static int zs_fill(struct zfile *zf)
+{
+	unsigned char *next;
+	unsigned int avail;
+	if (!zfile_fill(zf,&next,&avail)) return 0;
+	zf->zin.src=next;
+	zf->zin.size=avail;
+	zf->zin.pos=0;
+	return 1;
+}
+
+static struct zindex *zs_buildindex(struct zfile *zf,file_position_t csize)
+{
+	struct zindex *idx;
+	struct zpoint *pt;
+	file_position_t pos=0;
+	file_position_t out=0;
+	file_position_t len;
+	file_position_t content;
+	ZSTD_outBuffer zout;
+	size_t ret;
+	idx=calloc(1,sizeof(struct zindex));
+	idx->refs=1;
+	idx->type=BFILE_ZSTD;
+	while (pos<csize)
+	{
+		len=zs_framelen(zf,pos,&content);
+		if (len==0) break;
+		if (content==(file_position_t)-1)
+		{
+			// no content size in the header: count it once
+			content=0;
+			ZSTD_DCtx_reset(zf->zs,ZSTD_reset_session_only);
+			zf->in=pos;
+			zf->zin.size=zf->zin.pos=0;
+			do
+			{
+				if (zf->zin.pos==zf->zin.size)
+				{
+					if (zf->in>=pos+len || !zs_fill(zf)) break;
+				}
+				zout.dst=zf->output;
+				zout.size=sizeof(zf->output);
+				zout.pos=0;
+				ret=ZSTD_decompressStream(zf->zs,&zout,&zf->zin);
+				if (ZSTD_isError(ret)) break;
+				content+=zout.pos;
+			} while (ret!=0);
+		}
+		if (content)
+		{
+			pt=zfile_addpoint(idx);
+			pt->in=pos;
+			pt->out=out;
+		}
+		out+=content;
+		pos+=len;
+	}
+	idx->size=out;
+	if (idx->num==0)
+	{
+		zfile_freeindex(idx);
+		return NULL;
+	}
+	return idx;
+}
+
+static unsigned int zs_read(struct zfile *zf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	ZSTD_outBuffer zout;
+	struct zpoint *pt;
+	unsigned int got=0;
+	size_t ret;
+	pt=&zf->idx->points[zfile_findpoint(zf->idx,pos)];
+	if (!zf->live || pos<zf->out || pt->out>zf->out)
+	{
+		ZSTD_DCtx_reset(zf->zs,ZSTD_reset_session_only);
+		zf->in=pt->in;
+		zf->out=pt->out;
+		zf->zin.size=zf->zin.pos=0;
+		zf->live=1;
+	}
+	while (got<len)
+	{
+		if (zf->zin.pos==zf->zin.size)
+		{
+			if (!zs_fill(zf)) break;
+		}
+		if (zf->out<pos)
+		{
+			zout.dst=zf->output;
+			zout.size=(pos-zf->out<ZFILE_CHUNK)?(pos-zf->out):ZFILE_CHUNK;
+		} else {
+			zout.dst=buf+got;
+			zout.size=len-got;
+		}
+		zout.pos=0;
+		ret=ZSTD_decompressStream(zf->zs,&zout,&zf->zin);
+		if (ZSTD_isError(ret))
+		{
+			zf->live=0;
+			break;
+		}
+		zf->out+=zout.pos;
+		if (zf->out>pos) got=zf->out-pos;
+	}
+	return got;
+}
+#endif
+
+struct zfile *zfile_open(int fd,const char *filename,int type,file_position_t *size)
+{
+	struct zfile *zf;
+	struct stat st;
+	if (fstat(fd,&st)!=0) return NULL;
+#ifndef HAVE_ZSTD
+	if (type==BFILE_ZSTD) return NULL;
+#endif
+	zf=calloc(1,sizeof(struct zfile));
+	zf->fd=fd;
+	zf->type=type;
+#ifdef HAVE_ZSTD
+	if (type==BFILE_ZSTD)
+	{
+		zf->zs=ZSTD_createDStream();
+		ZSTD_initDStream(zf->zs);
+	}
+#endif
+	zf->idx=zfile_loadindex(filename,type,&st);
+	if (zf->idx==NULL)
+	{
+		fprintf(stderr,"Indexing %s...\n",filename);
+		if (type==BFILE_GZIP) zf->idx=gz_buildindex(zf);
+#ifdef HAVE_ZSTD
+		if (type==BFILE_ZSTD) zf->idx=zs_buildindex(zf,st.st_size);
+#endif
+		if (zf->idx==NULL)
+		{
+			zfile_close(zf);
+			return NULL;
+		}
+		zfile_saveindex(zf->idx,filename,&st);
+	}
+	*size=zf->idx->size;
+	return zf;
+}
+
+struct zfile *zfile_dup(struct zfile *zf,int fd)
+{
+	struct zfile *dup;
+	dup=calloc(1,sizeof(struct zfile));
+	dup->fd=fd;
+	dup->type=zf->type;
+	dup->idx=zf->idx;
+	dup->idx->refs++;
+#ifdef HAVE_ZSTD
+	if (dup->type==BFILE_ZSTD)
+	{
+		dup->zs=ZSTD_createDStream();
+		ZSTD_initDStream(dup->zs);
+	}
+#endif
+	return dup;
+}
+
+unsigned int zfile_read(struct zfile *zf,file_position_t pos,unsigned char *buf,unsigned int len)
+{
+	if (pos>=zf->idx->size) return 0;
+	if (len>zf->idx->size-pos) len=zf->idx->size-pos;
+#ifdef HAVE_ZSTD
+	if (zf->type==BFILE_ZSTD) return zs_read(zf,pos,buf,len);
+#endif
+	return gz_read(zf,pos,buf,len);
+}
+
+void zfile_close(struct zfile *zf)
+{
+	if (zf->type==BFILE_GZIP && zf->live) inflateEnd(&zf->strm);
+#ifdef HAVE_ZSTD
+	if (zf->zs) ZSTD_freeDStream(zf->zs);
+#endif
+	if (zf->idx) zfile_freeindex(zf->idx);
+	free(zf);
+}
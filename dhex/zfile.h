@@ -0,0 +1,11 @@
+#ifndef ZFILE_H
+#define ZFILE_H
+#include "data.h"
+
+int zfile_detect(const unsigned char *magic,int len);
+struct zfile *zfile_open(int fd,const char *filename,int type,file_position_t *size);
+struct zfile *zfile_dup(struct zfile *zf,int fd);
+unsigned int zfile_read(struct zfile *zf,file_position_t pos,unsigned char *buf,unsigned int len);
+void zfile_close(struct zfile *zf);
+
+#endif